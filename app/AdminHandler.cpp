@@ -0,0 +1,69 @@
+#include "AdminHandler.h"
+#include "Metrics.h"
+
+AdminHandler::AdminHandler(DBHandler &dbHandler, MaintenanceScheduler &maintenanceScheduler) : db(dbHandler), maintenance(maintenanceScheduler) {}
+
+void AdminHandler::get_metrics(const httplib::Request &req, httplib::Response &res)
+{
+    res.status = 200;
+    res.set_content(Metrics::instance().render(), "text/plain; version=0.0.4");
+}
+
+void AdminHandler::get_query_stats(const httplib::Request &req, httplib::Response &res)
+{
+    QueryProfiler &profiler = db.get_profiler();
+    json response;
+    response["slow_query_threshold_ms"] = profiler.get_threshold_ms();
+
+    response["statements"] = json::array();
+    for (const auto &stats : profiler.get_statement_stats())
+    {
+        json stmt_info = {
+            {"sql", stats.sql},
+            {"calls", stats.calls},
+            {"slow_calls", stats.slow_calls},
+            {"total_ms", stats.total_ns / 1e6},
+            {"avg_ms", stats.calls ? stats.total_ns / 1e6 / stats.calls : 0.0},
+            {"max_ms", stats.max_ns / 1e6},
+            {"fullscan_steps", stats.fullscan_steps},
+            {"sorts", stats.sorts},
+            {"autoindexes", stats.autoindexes},
+            {"vm_steps", stats.vm_steps}};
+        response["statements"].push_back(stmt_info);
+    }
+
+    response["slow_queries"] = json::array();
+    for (const auto &query : profiler.get_slow_queries())
+    {
+        json query_info = {
+            {"sql", query.sql},
+            {"duration_ms", query.duration_ns / 1e6},
+            {"fullscan_steps", query.fullscan_steps},
+            {"sorts", query.sorts},
+            {"autoindexes", query.autoindexes},
+            {"vm_steps", query.vm_steps},
+            {"query_plan", query.plan}};
+        response["slow_queries"].push_back(query_info);
+    }
+
+    res.status = 200;
+    res.set_content(response.dump(), "application/json");
+}
+
+void AdminHandler::get_maintenance(const httplib::Request &req, httplib::Response &res)
+{
+    res.status = 200;
+    res.set_content(maintenance.get_status().dump(), "application/json");
+}
+
+void AdminHandler::handle_requests(Router &router)
+{
+    router.Get("/metrics", [&](const httplib::Request &req, httplib::Response &res, const Router::Params &)
+               { get_metrics(req, res); });
+
+    router.Get("/admin/queries", [&](const httplib::Request &req, httplib::Response &res, const Router::Params &)
+               { get_query_stats(req, res); });
+
+    router.Get("/admin/maintenance", [&](const httplib::Request &req, httplib::Response &res, const Router::Params &)
+               { get_maintenance(req, res); });
+}
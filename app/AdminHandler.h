@@ -0,0 +1,20 @@
+#pragma once
+#include "DBHandler.h"
+#include "MaintenanceScheduler.h"
+#include "Router.h"
+
+class AdminHandler
+{
+public:
+    AdminHandler(DBHandler &dbHandler, MaintenanceScheduler &maintenanceScheduler);
+
+    void handle_requests(Router &router);
+
+private:
+    DBHandler &db;
+    MaintenanceScheduler &maintenance;
+
+    void get_metrics(const httplib::Request &req, httplib::Response &res);
+    void get_query_stats(const httplib::Request &req, httplib::Response &res);
+    void get_maintenance(const httplib::Request &req, httplib::Response &res);
+};
@@ -0,0 +1,189 @@
+#include "AdmissionController.h"
+#include "Metrics.h"
+#include "RequestLocal.h"
+#include "json.hpp"
+using json = nlohmann::json;
+
+namespace
+{
+    // Carried from pre- to post-routing with the request, which may change threads in between (coroutine handlers).
+    struct RequestState
+    {
+        bool admitted;
+        std::chrono::steady_clock::time_point start;
+        int64_t queue_wait_ns; // wait of the connection's first request, consumed once
+    };
+    RequestLocal<RequestState> request_state;
+
+    const double PRIORITY_SHARE[] = {0.5, 0.8, 1.0};
+}
+
+AdmissionController::AdmissionController(const AdmissionSettings &settings)
+    : settings(settings), limit(settings.max_limit), in_flight(0), queued(0), queue_wait_ewma_ns(0), window_latency_ns(0),
+      window_samples(0)
+{
+    Metrics::instance().set_admission_limit(settings.max_limit);
+}
+
+void AdmissionController::install(httplib::Server &svr, httplib::Server::HandlerWithResponse next)
+{
+    this->next = std::move(next);
+    svr.new_task_queue = [this]
+    { return new QueueingThreadPool(*this, CPPHTTPLIB_THREAD_POOL_COUNT); };
+
+    svr.set_pre_routing_handler([this](const httplib::Request &req, httplib::Response &res)
+                                {
+                                    if (admit(req, res) == httplib::Server::HandlerResponse::Handled)
+                                    {
+                                        return httplib::Server::HandlerResponse::Handled;
+                                    }
+                                    return this->next ? this->next(req, res) : httplib::Server::HandlerResponse::Unhandled; });
+
+    svr.set_post_routing_handler([this](const httplib::Request &req, httplib::Response &res)
+                                 { release(); });
+}
+
+// Both front ends share the limit. On the event loop the queue wait is the time a parsed request waits for a worker.
+void AdmissionController::install(EventLoopServer &server)
+{
+    server.new_task_queue = [this]
+    { return new QueueingThreadPool(*this, CPPHTTPLIB_THREAD_POOL_COUNT); };
+
+    server.set_pre_routing_handler([this](const httplib::Request &req, httplib::Response &res)
+                                   { return admit(req, res); });
+
+    server.set_post_routing_handler([this](const httplib::Request &req, httplib::Response &res)
+                                    { release(); });
+}
+
+int AdmissionController::get_limit() const
+{
+    return limit.load(std::memory_order_relaxed);
+}
+
+// private methods
+AdmissionController::Priority AdmissionController::classify(const httplib::Request &req)
+{
+    if (req.path == "/metrics" || req.path.compare(0, 7, "/admin/") == 0 || req.path.compare(0, 13, "/replication/") == 0)
+    {
+        return EXEMPT;
+    }
+    if (req.method != "GET" && req.method != "HEAD" && !(req.method == "POST" && req.path == "/devices/lookup"))
+    {
+        return MUTATION;
+    }
+    if (req.path == "/devices")
+    {
+        return FULL_READ;
+    }
+    return READ;
+}
+
+httplib::Server::HandlerResponse AdmissionController::admit(const httplib::Request &req, httplib::Response &res)
+{
+    request_state.get().admitted = false;
+    Priority priority = classify(req);
+    if (priority == EXEMPT)
+    {
+        return httplib::Server::HandlerResponse::Unhandled;
+    }
+    if (priority == MUTATION && settings.read_only)
+    {
+        json response;
+        res.status = 403;
+        response["status"] = "forbidden";
+        response["message"] = "This registry is a read-only replication follower";
+        res.set_content(response.dump(), "application/json");
+        return httplib::Server::HandlerResponse::Handled;
+    }
+
+    // Queued connections count against the limit: they are requests the workers have not reached yet.
+    int load = in_flight.load(std::memory_order_relaxed) + queued.load(std::memory_order_relaxed);
+    if (load >= limit.load(std::memory_order_relaxed) * PRIORITY_SHARE[priority])
+    {
+        Metrics::instance().admission_rejected(priority == MUTATION ? "mutation" : priority == READ ? "read" : "full_read");
+        int64_t retry_after_s = std::max<int64_t>(1, (queue_wait_ewma_ns.load(std::memory_order_relaxed) + 999999999) / 1000000000);
+        json response;
+        res.status = 503;
+        response["status"] = "unavailable";
+        response["message"] = "Server is overloaded, retry later";
+        res.set_header("Retry-After", std::to_string(retry_after_s));
+        res.set_header("Connection", "close"); // hand the worker to a queued connection
+        res.set_content(response.dump(), "application/json");
+        request_state.get().queue_wait_ns = 0;
+        return httplib::Server::HandlerResponse::Handled;
+    }
+
+    in_flight.fetch_add(1, std::memory_order_relaxed);
+    request_state.get().admitted = true;
+    request_state.get().start = std::chrono::steady_clock::now();
+    return httplib::Server::HandlerResponse::Unhandled;
+}
+
+void AdmissionController::release()
+{
+    if (!request_state.get().admitted)
+    {
+        return;
+    }
+    request_state.get().admitted = false;
+    in_flight.fetch_sub(1, std::memory_order_relaxed);
+
+    auto handled = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - request_state.get().start);
+    observe_latency(request_state.get().queue_wait_ns + handled.count());
+    request_state.get().queue_wait_ns = 0;
+}
+
+void AdmissionController::observe_queue_wait(int64_t wait_ns)
+{
+    request_state.get().queue_wait_ns = wait_ns;
+    Metrics::instance().observe_queue_wait(wait_ns);
+
+    // EWMA with weight 1/8, good enough for a Retry-After hint.
+    int64_t ewma = queue_wait_ewma_ns.load(std::memory_order_relaxed);
+    queue_wait_ewma_ns.store(ewma + (wait_ns - ewma) / 8, std::memory_order_relaxed);
+}
+
+void AdmissionController::observe_latency(int64_t latency_ns)
+{
+    if (settings.target_latency_ms <= 0)
+    {
+        return;
+    }
+    window_latency_ns.fetch_add(latency_ns, std::memory_order_relaxed);
+    if (window_samples.fetch_add(1, std::memory_order_relaxed) + 1 != WINDOW_SAMPLES)
+    {
+        return;
+    }
+
+    // Exactly one thread closes each window and adjusts the limit.
+    uint64_t total_ns = window_latency_ns.exchange(0, std::memory_order_relaxed);
+    window_samples.store(0, std::memory_order_relaxed);
+    double average_ms = total_ns / 1e6 / WINDOW_SAMPLES;
+    int current = limit.load(std::memory_order_relaxed);
+    int next = average_ms > settings.target_latency_ms ? static_cast<int>(current * 0.9) : current + 1;
+    next = std::max(settings.min_limit, std::min(settings.max_limit, next));
+    limit.store(next, std::memory_order_relaxed);
+    Metrics::instance().set_admission_limit(next);
+}
+
+// QueueingThreadPool
+AdmissionController::QueueingThreadPool::QueueingThreadPool(AdmissionController &controller, size_t threads)
+    : controller(controller), pool(threads) {}
+
+void AdmissionController::QueueingThreadPool::enqueue(std::function<void()> fn)
+{
+    controller.queued.fetch_add(1, std::memory_order_relaxed);
+    auto enqueued = std::chrono::steady_clock::now();
+    pool.enqueue([this, enqueued, fn]()
+                 {
+                     controller.queued.fetch_sub(1, std::memory_order_relaxed);
+                     auto wait = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - enqueued);
+                     controller.observe_queue_wait(wait.count());
+                     fn(); });
+}
+
+void AdmissionController::QueueingThreadPool::shutdown()
+{
+    pool.shutdown();
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include "EventLoopServer.h"
+#include "httplib.h"
+#include <atomic>
+#include <chrono>
+
+struct AdmissionSettings
+{
+    int max_limit = 256;         // admitted plus queued requests allowed before shedding
+    int min_limit = 8;           // floor for the adaptive limit
+    double target_latency_ms = 0; // queueing + handling latency SLO; 0 keeps the limit fixed at max_limit
+    bool read_only = false;       // replication followers refuse mutations with 403
+};
+
+// Sheds load early with 503 + Retry-After instead of letting every request slow down together.
+// Requests are prioritised: mutations may use the whole limit, point reads 80% of it and full-table reads half.
+// With a latency target the limit adapts (AIMD): it shrinks by 10% when a window's average latency
+// exceeds the target and grows by one otherwise.
+class AdmissionController
+{
+public:
+    explicit AdmissionController(const AdmissionSettings &settings);
+
+    // `next` runs in httplib's pre-routing hook once a request is admitted, e.g. Router::dispatch.
+    void install(httplib::Server &svr, httplib::Server::HandlerWithResponse next = nullptr);
+    void install(EventLoopServer &server);
+
+    int get_limit() const;
+
+private:
+    enum Priority
+    {
+        FULL_READ,
+        READ,
+        MUTATION,
+        EXEMPT
+    };
+
+    // Wraps httplib's thread pool to measure how long accepted connections wait for a worker.
+    class QueueingThreadPool : public httplib::TaskQueue
+    {
+    public:
+        QueueingThreadPool(AdmissionController &controller, size_t threads);
+        void enqueue(std::function<void()> fn) override;
+        void shutdown() override;
+
+    private:
+        AdmissionController &controller;
+        httplib::ThreadPool pool;
+    };
+
+    static const int WINDOW_SAMPLES = 64;
+
+    AdmissionSettings settings;
+    httplib::Server::HandlerWithResponse next;
+    std::atomic<int> limit;
+    std::atomic<int> in_flight;
+    std::atomic<int> queued;
+    std::atomic<int64_t> queue_wait_ewma_ns;
+    std::atomic<uint64_t> window_latency_ns;
+    std::atomic<int> window_samples;
+
+    static Priority classify(const httplib::Request &req);
+    httplib::Server::HandlerResponse admit(const httplib::Request &req, httplib::Response &res);
+    void release();
+    void observe_queue_wait(int64_t wait_ns);
+    void observe_latency(int64_t latency_ns);
+};
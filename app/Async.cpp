@@ -0,0 +1,111 @@
+#include "Async.h"
+
+#ifdef REGISTRY_COROUTINES
+
+namespace
+{
+    struct Detached
+    {
+        struct promise_type
+        {
+            Detached get_return_object() { return {}; }
+            std::suspend_never initial_suspend() noexcept { return {}; }
+            std::suspend_never final_suspend() noexcept { return {}; }
+            void return_void() {}
+            void unhandled_exception() { std::terminate(); }
+        };
+    };
+
+    Detached run_detached(Task<> task)
+    {
+        co_await task;
+    }
+}
+
+bool &task_detail::inline_calls()
+{
+    thread_local bool calls = false;
+    return calls;
+}
+
+void spawn(Task<> task)
+{
+    run_detached(std::move(task));
+}
+
+DbExecutor &DbExecutor::instance()
+{
+    static DbExecutor executor;
+    return executor;
+}
+
+void DbExecutor::start(size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        threads.emplace_back([this]
+                             { work(); });
+    }
+    started = count > 0;
+}
+
+void DbExecutor::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    ready.notify_all();
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+    threads.clear();
+    started = false;
+}
+
+void DbExecutor::submit(Job *job)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (tail != nullptr)
+        {
+            tail->next = job;
+        }
+        else
+        {
+            head = job;
+        }
+        tail = job;
+    }
+    ready.notify_one();
+}
+
+// private methods
+void DbExecutor::work()
+{
+    task_detail::inline_calls() = true;
+    while (true)
+    {
+        Job *job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            ready.wait(lock, [this]
+                       { return head != nullptr || stopping; });
+            if (head == nullptr)
+            {
+                return;
+            }
+            job = head;
+            head = job->next;
+            if (head == nullptr)
+            {
+                tail = nullptr;
+            }
+        }
+        job->next = nullptr;
+        job->run();
+    }
+}
+
+#endif
@@ -0,0 +1,295 @@
+#pragma once
+#include "RequestLocal.h"
+#include <type_traits>
+#include <utility>
+
+// Device and location handlers are written once and compiled either as C++20 coroutines or as plain functions.
+// A handler returns Task<>, prefixes each database call with CO_AWAIT db_call(...) and returns with CO_RETURN.
+//
+// Built as C++20 (the Dockerfile default), handlers are coroutines: db_call suspends the handler and runs the
+// call on a DbExecutor thread, so the thread that parsed the request is free for the next one while SQLite
+// works. On the event-loop front end a request in flight then costs a coroutine frame rather than a thread.
+// Built as C++17 or with -DREGISTRY_SYNC_HANDLERS, Task<T> is T, CO_AWAIT expands to nothing and every call runs
+// on the calling thread, as before.
+#if defined(__cpp_impl_coroutine) && !defined(REGISTRY_SYNC_HANDLERS)
+#define REGISTRY_COROUTINES 1
+#endif
+
+#ifdef REGISTRY_COROUTINES
+#include <atomic>
+#include <condition_variable>
+#include <coroutine>
+#include <cstdlib>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#define CO_AWAIT co_await
+#define CO_RETURN co_return
+
+template <typename T = void>
+class Task;
+
+namespace task_detail
+{
+    // Symmetric transfer back to the awaiting coroutine, so chains of tasks do not grow the stack.
+    struct FinalAwaiter
+    {
+        bool await_ready() noexcept { return false; }
+        template <typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept
+        {
+            return handle.promise().continuation;
+        }
+        void await_resume() noexcept {}
+    };
+
+    class PromiseBase
+    {
+    public:
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        FinalAwaiter final_suspend() noexcept { return {}; }
+
+        void unhandled_exception() { exception = std::current_exception(); }
+
+        std::coroutine_handle<> continuation = std::noop_coroutine();
+        std::exception_ptr exception;
+    };
+
+    template <typename T>
+    class Promise : public PromiseBase
+    {
+    public:
+        Task<T> get_return_object();
+        template <typename U>
+        void return_value(U &&result) { value.emplace(std::forward<U>(result)); }
+
+        T result()
+        {
+            if (exception)
+            {
+                std::rethrow_exception(exception);
+            }
+            return std::move(*value);
+        }
+
+    private:
+        std::optional<T> value;
+    };
+
+    template <>
+    class Promise<void> : public PromiseBase
+    {
+    public:
+        Task<void> get_return_object();
+        void return_void() {}
+
+        void result()
+        {
+            if (exception)
+            {
+                std::rethrow_exception(exception);
+            }
+        }
+    };
+
+    // Whether db_call runs on the calling thread: true on DbExecutor threads and inside run_inline.
+    bool &inline_calls();
+}
+
+// A lazily started coroutine returning T. It runs when awaited and resumes the awaiting coroutine when it
+// finishes; exceptions propagate to the awaiter.
+template <typename T>
+class Task
+{
+public:
+    using promise_type = task_detail::Promise<T>;
+
+    explicit Task(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+    Task(Task &&other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+    Task(const Task &) = delete;
+    Task &operator=(const Task &) = delete;
+    ~Task()
+    {
+        if (handle)
+        {
+            handle.destroy();
+        }
+    }
+
+    auto operator co_await() noexcept
+    {
+        struct Awaiter
+        {
+            std::coroutine_handle<promise_type> handle;
+
+            bool await_ready() noexcept { return false; }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> caller) noexcept
+            {
+                handle.promise().continuation = caller;
+                return handle;
+            }
+            T await_resume() { return handle.promise().result(); }
+        };
+        return Awaiter{handle};
+    }
+
+    // Runs the task to completion on the calling thread, making its database calls inline. For callers that
+    // have to block anyway, such as httplib's worker threads.
+    T run_inline()
+    {
+        bool &calls = task_detail::inline_calls();
+        bool was_inline = std::exchange(calls, true);
+        handle.resume();
+        calls = was_inline;
+        if (!handle.done())
+        {
+            std::abort(); // only db_call suspends a handler, and it does not when inline
+        }
+        return handle.promise().result();
+    }
+
+private:
+    std::coroutine_handle<promise_type> handle;
+};
+
+template <typename T>
+Task<T> task_detail::Promise<T>::get_return_object()
+{
+    return Task<T>(std::coroutine_handle<Promise<T>>::from_promise(*this));
+}
+
+inline Task<void> task_detail::Promise<void>::get_return_object()
+{
+    return Task<void>(std::coroutine_handle<Promise<void>>::from_promise(*this));
+}
+
+// Starts a task nobody awaits. Its frame is freed when it finishes; it must not throw.
+void spawn(Task<> task);
+
+// Threads that run the database calls of coroutine handlers. A handler resumes on the database thread when its
+// call returns and keeps running there, making any further calls inline, until it finishes or suspends on
+// something else; one request therefore changes threads once, however many queries it runs. The pool only runs
+// calls once started; until then, and under run_inline (the httplib front end), calls run on the calling thread.
+class DbExecutor
+{
+public:
+    class Job
+    {
+    public:
+        virtual void run() = 0;
+
+    protected:
+        ~Job() = default;
+
+    private:
+        friend class DbExecutor;
+        Job *next = nullptr;
+    };
+
+    static DbExecutor &instance();
+
+    void start(size_t threads);
+    void stop(); // runs the calls already queued first
+    bool running() const { return started.load(std::memory_order_relaxed); }
+    void submit(Job *job);
+
+private:
+    std::atomic<bool> started{false};
+    std::mutex mutex;
+    std::condition_variable ready;
+    Job *head = nullptr;
+    Job *tail = nullptr;
+    bool stopping = false;
+    std::vector<std::thread> threads;
+
+    void work();
+};
+
+template <typename F>
+class DbCall : private DbExecutor::Job
+{
+public:
+    using Result = std::invoke_result_t<F &>;
+
+    explicit DbCall(F fn) : fn(std::move(fn)) {}
+
+    bool await_ready() const { return task_detail::inline_calls() || !DbExecutor::instance().running(); }
+
+    void await_suspend(std::coroutine_handle<> caller)
+    {
+        continuation = caller;
+        locals = RequestLocals::detach();
+        DbExecutor::instance().submit(this);
+    }
+
+    Result await_resume()
+    {
+        if (!continuation)
+        {
+            return fn();
+        }
+        if (exception)
+        {
+            std::rethrow_exception(exception);
+        }
+        if constexpr (!std::is_void_v<Result>)
+        {
+            return std::move(*result);
+        }
+    }
+
+private:
+    using Stored = std::conditional_t<std::is_void_v<Result>, bool, Result>;
+
+    F fn;
+    std::coroutine_handle<> continuation;
+    RequestLocals::Saved locals;
+    std::optional<Stored> result;
+    std::exception_ptr exception;
+
+    void run() override
+    {
+        RequestLocals::attach(locals);
+        try
+        {
+            if constexpr (std::is_void_v<Result>)
+            {
+                fn();
+            }
+            else
+            {
+                result.emplace(fn());
+            }
+        }
+        catch (...)
+        {
+            exception = std::current_exception();
+        }
+        continuation.resume();
+    }
+};
+
+template <typename F>
+DbCall<F> db_call(F fn)
+{
+    return DbCall<F>(std::move(fn));
+}
+
+#else
+
+#define CO_AWAIT
+#define CO_RETURN return
+
+template <typename T = void>
+using Task = T;
+
+template <typename F>
+auto db_call(F fn)
+{
+    return fn();
+}
+
+#endif
@@ -0,0 +1,829 @@
+#include "ColumnarSnapshot.h"
+#include "FilterKernels.h"
+#include "TextKernels.h"
+#include <climits>
+#include <mutex>
+
+namespace
+{
+    // YYYY-MM-DD as the integer YYYYMMDD. For strings of this form, integer order is the byte order SQLite compares
+    // creation dates in, whether or not the date exists.
+    bool date_key(const std::string &date, int32_t &key)
+    {
+        if (date.size() != 10 || date[4] != '-' || date[7] != '-')
+        {
+            return false;
+        }
+        key = 0;
+        for (int i : {0, 1, 2, 3, 5, 6, 8, 9})
+        {
+            if (date[i] < '0' || date[i] > '9')
+            {
+                return false;
+            }
+            key = key * 10 + (date[i] - '0');
+        }
+        return true;
+    }
+
+    // Writes the 10 characters of YYYY-MM-DD, without a terminator.
+    void format_date(int32_t key, char *buf)
+    {
+        buf[4] = buf[7] = '-';
+        for (int i : {9, 8, 6, 5, 3, 2, 1, 0})
+        {
+            buf[i] = '0' + key % 10;
+            key /= 10;
+        }
+    }
+
+    // Plain decimal ids only; SQLite's conversion rules for anything else are left to SQLite.
+    bool parse_location_id(const std::string &text, int &id)
+    {
+        if (text.empty() || text.size() > 9)
+        {
+            return false;
+        }
+        id = 0;
+        for (char c : text)
+        {
+            if (c < '0' || c > '9')
+            {
+                return false;
+            }
+            id = id * 10 + (c - '0');
+        }
+        return true;
+    }
+
+    InternedString intern_column(sqlite3_stmt *stmt, int column)
+    {
+        const char *text = reinterpret_cast<const char *>(sqlite3_column_text(stmt, column));
+        return StringPool::instance().intern(std::string_view(text ? text : "", sqlite3_column_bytes(stmt, column)));
+    }
+
+    const char *column_text(sqlite3_stmt *stmt, int column)
+    {
+        const char *text = reinterpret_cast<const char *>(sqlite3_column_text(stmt, column));
+        return text ? text : "";
+    }
+}
+
+ColumnarSnapshot::ColumnarSnapshot() : ready(false), rows(0), live_rows(0) {}
+
+// Loads locations and devices through `db`. The caller holds the registry's write lock, so the copy is consistent.
+bool ColumnarSnapshot::load(sqlite3 *db)
+{
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    clear();
+
+    sqlite3_stmt *stmt;
+    int rc = sqlite3_prepare_v2(db, "SELECT id, name, type FROM locations", -1, &stmt, NULL);
+    if (rc != SQLITE_OK)
+    {
+        std::cerr << "Error preparing SQL statement: " << sqlite3_errmsg(db) << std::endl;
+        return false;
+    }
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        locations[sqlite3_column_int(stmt, 0)] = {location_name_dictionary.code(intern_column(stmt, 1)),
+                                                  location_type_dictionary.code(intern_column(stmt, 2))};
+    }
+    sqlite3_finalize(stmt);
+
+    rc = sqlite3_prepare_v2(db, "SELECT serial_number, name, type, creation_date, location_id, location_name, location_type FROM devices", -1, &stmt, NULL);
+    if (rc != SQLITE_OK)
+    {
+        std::cerr << "Error preparing SQL statement: " << sqlite3_errmsg(db) << std::endl;
+        return false;
+    }
+    bool representable = true;
+    while (representable && (rc = sqlite3_step(stmt)) == SQLITE_ROW)
+    {
+        // Comparisons against numeric creation dates or text location ids follow SQLite's affinity rules, which the columns do not model.
+        representable = sqlite3_column_type(stmt, 3) == SQLITE_TEXT && sqlite3_column_type(stmt, 4) == SQLITE_INTEGER;
+        uint32_t row = append_row();
+        serial_numbers[row] = column_text(stmt, 0);
+        names[row] = column_text(stmt, 1);
+        types[row] = type_dictionary.code(intern_column(stmt, 2));
+        set_date(row, column_text(stmt, 3));
+        location_ids[row] = sqlite3_column_int(stmt, 4);
+        location_names[row] = location_name_dictionary.code(intern_column(stmt, 5));
+        location_types[row] = location_type_dictionary.code(intern_column(stmt, 6));
+        index_row(row);
+    }
+    sqlite3_finalize(stmt);
+
+    if (!representable || rc != SQLITE_DONE)
+    {
+        std::cerr << "Columnar snapshot disabled: " << (representable ? sqlite3_errmsg(db) : "devices with non-text dates or non-integer location ids")
+                  << std::endl;
+        clear();
+        return false;
+    }
+    ready = true;
+    return true;
+}
+
+bool ColumnarSnapshot::filter(const std::string &serial_number, const std::string &type, const std::string &start_date,
+                              const std::string &end_date, const std::string &location_name, const std::string &location_type,
+                              const std::string &location_id, const DeviceVisitor &visitor, size_t &rows) const
+{
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    std::vector<uint64_t> bits;
+    if (!ready || !select(serial_number, type, start_date, end_date, location_name, location_type, location_id, bits))
+    {
+        return false;
+    }
+
+    char date[10];
+    for (size_t w = 0; w < bits.size(); w++)
+    {
+        for (uint64_t word = bits[w]; word != 0; word &= word - 1)
+        {
+            visitor(row_view(w * 64 + __builtin_ctzll(word), date));
+            rows++;
+        }
+    }
+    return true;
+}
+
+bool ColumnarSnapshot::add_device(const Device &device)
+{
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    if (!ready)
+    {
+        return true;
+    }
+    if (const uint32_t *existing = find(device.serial_number))
+    {
+        remove_row(*existing);
+    }
+    uint32_t row = append_row();
+    serial_numbers[row] = device.serial_number;
+    names[row] = device.name;
+    types[row] = type_dictionary.code(device.type);
+    set_date(row, device.creation_date);
+    index_row(row);
+    return set_location(row, device.location_id);
+}
+
+bool ColumnarSnapshot::update_device(const std::string &serial_number, const std::string &name, const std::string &type,
+                                     const std::string &creation_date, const std::string &location_id)
+{
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    const uint32_t *row = find(serial_number);
+    if (!ready || row == nullptr)
+    {
+        return true;
+    }
+    if (!name.empty())
+    {
+        names[*row] = name;
+    }
+    if (!type.empty())
+    {
+        types[*row] = type_dictionary.code(type);
+    }
+    if (!creation_date.empty())
+    {
+        set_date(*row, creation_date);
+    }
+    int id;
+    return location_id.empty() || (parse_location_id(location_id, id) && set_location(*row, id));
+}
+
+bool ColumnarSnapshot::delete_device(const std::string &serial_number)
+{
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    if (const uint32_t *row = find(serial_number))
+    {
+        remove_row(*row);
+        compact();
+    }
+    return true;
+}
+
+bool ColumnarSnapshot::relocate_devices(const std::string &serial_number, const std::string &type, const std::string &start_date,
+                                        const std::string &end_date, const std::string &location_name, const std::string &location_type,
+                                        const std::string &location_id, int target_location_id)
+{
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    std::vector<uint64_t> bits;
+    if (!ready)
+    {
+        return true;
+    }
+    if (!select(serial_number, type, start_date, end_date, location_name, location_type, location_id, bits))
+    {
+        return false;
+    }
+    bool relocated = true;
+    for (size_t w = 0; w < bits.size(); w++)
+    {
+        for (uint64_t word = bits[w]; word != 0; word &= word - 1)
+        {
+            relocated = set_location(w * 64 + __builtin_ctzll(word), target_location_id) && relocated;
+        }
+    }
+    return relocated;
+}
+
+bool ColumnarSnapshot::relocate_devices(const std::vector<std::string> &serial_numbers, int target_location_id)
+{
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    bool relocated = true;
+    for (const auto &serial_number : serial_numbers)
+    {
+        if (const uint32_t *row = find(serial_number))
+        {
+            relocated = set_location(*row, target_location_id) && relocated;
+        }
+    }
+    return relocated;
+}
+
+bool ColumnarSnapshot::add_location(const Location &location)
+{
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    locations[location.id] = {location_name_dictionary.code(location.name), location_type_dictionary.code(location.type)};
+    return true;
+}
+
+// Devices at the location are found with a kernel pass over location_ids.
+bool ColumnarSnapshot::update_location(int id, const std::string &name, const std::string &type)
+{
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    auto location = locations.find(id);
+    if (location == locations.end())
+    {
+        return true;
+    }
+    if (!name.empty())
+    {
+        location->second.name = location_name_dictionary.code(name);
+    }
+    if (!type.empty())
+    {
+        location->second.type = location_type_dictionary.code(type);
+    }
+
+    std::vector<uint64_t> bits = live;
+    FilterKernels::select_equal(reinterpret_cast<const uint32_t *>(location_ids.data()), bits.size(), {static_cast<uint32_t>(id)}, bits.data());
+    for (size_t w = 0; w < bits.size(); w++)
+    {
+        for (uint64_t word = bits[w]; word != 0; word &= word - 1)
+        {
+            uint32_t row = w * 64 + __builtin_ctzll(word);
+            location_names[row] = location->second.name;
+            location_types[row] = location->second.type;
+        }
+    }
+    return true;
+}
+
+bool ColumnarSnapshot::delete_location(int id)
+{
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    locations.erase(id);
+    std::vector<uint64_t> bits = live;
+    FilterKernels::select_equal(reinterpret_cast<const uint32_t *>(location_ids.data()), bits.size(), {static_cast<uint32_t>(id)}, bits.data());
+    for (size_t w = 0; w < bits.size(); w++)
+    {
+        for (uint64_t word = bits[w]; word != 0; word &= word - 1)
+        {
+            remove_row(w * 64 + __builtin_ctzll(word));
+        }
+    }
+    compact();
+    return true;
+}
+
+// Fixed-width columns come first, so a damaged row count fails a bounds check before anything is sized by it.
+void ColumnarSnapshot::save(WarmStartWriter &out) const
+{
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    out.put(static_cast<uint8_t>(ready));
+    if (!ready)
+    {
+        return;
+    }
+    out.put(static_cast<uint64_t>(rows));
+    out.put(static_cast<uint64_t>(live_rows));
+    out.put_array(types.data(), rows);
+    out.put_array(dates.data(), rows);
+    out.put_array(location_ids.data(), rows);
+    out.put_array(location_names.data(), rows);
+    out.put_array(location_types.data(), rows);
+    out.put_array(live.data(), live.size());
+    out.put(static_cast<uint64_t>(serial_index.size()));
+    out.put_array(serial_index.data(), serial_index.size());
+    for (const Dictionary *dictionary : {&type_dictionary, &location_name_dictionary, &location_type_dictionary})
+    {
+        out.put(static_cast<uint32_t>(dictionary->values.size()));
+        for (const InternedString &value : dictionary->values)
+        {
+            out.put_string(value.str());
+        }
+    }
+    out.put(static_cast<uint32_t>(locations.size()));
+    for (const auto &location : locations)
+    {
+        out.put(static_cast<int32_t>(location.first));
+        out.put(location.second.name);
+        out.put(location.second.type);
+    }
+    for (const auto *column : {&serial_numbers, &names})
+    {
+        for (size_t row = 0; row < rows; row++)
+        {
+            out.put_string((*column)[row]);
+        }
+    }
+    out.put(static_cast<uint64_t>(irregular_dates.size()));
+    for (const auto &date : irregular_dates)
+    {
+        out.put(date.first);
+        out.put_string(date.second);
+    }
+}
+
+bool ColumnarSnapshot::restore(WarmStartReader &in)
+{
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    clear();
+    if (!read_image(in))
+    {
+        clear();
+        return false;
+    }
+    ready = true;
+    return true;
+}
+
+size_t ColumnarSnapshot::size() const
+{
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    return live_rows;
+}
+
+// private methods
+void ColumnarSnapshot::clear()
+{
+    ready = false;
+    rows = 0;
+    live_rows = 0;
+    for (auto *column : {&serial_numbers, &names})
+    {
+        std::vector<std::string>().swap(*column);
+    }
+    for (auto *column : {&types, &location_names, &location_types})
+    {
+        std::vector<uint32_t>().swap(*column);
+    }
+    std::vector<int32_t>().swap(dates);
+    std::vector<int32_t>().swap(location_ids);
+    std::vector<uint64_t>().swap(live);
+    irregular_dates.clear();
+    std::vector<uint32_t>().swap(serial_index);
+    type_dictionary = Dictionary();
+    location_name_dictionary = Dictionary();
+    location_type_dictionary = Dictionary();
+    locations.clear();
+}
+
+// Reads what save() wrote and checks it can be used as is: codes within their dictionaries, the live bitmap
+// matching the row counts, the serial index holding each live row once.
+bool ColumnarSnapshot::read_image(WarmStartReader &in)
+{
+    uint8_t saved_ready = 0;
+    uint64_t saved_rows = 0;
+    uint64_t saved_live_rows = 0;
+    in.get(saved_ready);
+    in.get(saved_rows);
+    in.get(saved_live_rows);
+    if (!in.ok() || !saved_ready || saved_rows > UINT32_MAX || saved_live_rows > saved_rows)
+    {
+        return false;
+    }
+    rows = saved_rows;
+    live_rows = saved_live_rows;
+    size_t padded = (rows + 63) / 64 * 64;
+    if (!in.get_array(types, rows) || !in.get_array(dates, rows) || !in.get_array(location_ids, rows) ||
+        !in.get_array(location_names, rows) || !in.get_array(location_types, rows) || !in.get_array(live, padded / 64))
+    {
+        return false;
+    }
+    uint64_t index_slots = 0;
+    in.get(index_slots);
+    if (index_slots < live_rows * 2 || (index_slots & (index_slots - 1)) != 0 || !in.get_array(serial_index, index_slots))
+    {
+        return false;
+    }
+    for (auto *column : {&types, &location_names, &location_types})
+    {
+        column->resize(padded);
+    }
+    dates.resize(padded);
+    location_ids.resize(padded);
+
+    std::string value;
+    for (Dictionary *dictionary : {&type_dictionary, &location_name_dictionary, &location_type_dictionary})
+    {
+        uint32_t count = 0;
+        in.get(count);
+        for (uint32_t code = 0; code < count && in.get_string(value); code++)
+        {
+            if (dictionary->code(StringPool::instance().intern(value)) != code)
+            {
+                return false;
+            }
+        }
+    }
+    uint32_t location_count = 0;
+    in.get(location_count);
+    for (uint32_t i = 0; i < location_count && in.ok(); i++)
+    {
+        int32_t id = 0;
+        LocationCodes codes{0, 0};
+        in.get(id);
+        in.get(codes.name);
+        in.get(codes.type);
+        if (codes.name >= location_name_dictionary.values.size() || codes.type >= location_type_dictionary.values.size())
+        {
+            return false;
+        }
+        locations[id] = codes;
+    }
+
+    size_t live_count = 0;
+    for (size_t w = 0; w < live.size(); w++)
+    {
+        live_count += __builtin_popcountll(live[w]);
+    }
+    if (live_count != live_rows || (rows % 64 != 0 && live.back() >> (rows % 64) != 0))
+    {
+        return false;
+    }
+    for (uint32_t row = 0; row < rows; row++)
+    {
+        if (types[row] >= type_dictionary.values.size() || location_names[row] >= location_name_dictionary.values.size() ||
+            location_types[row] >= location_type_dictionary.values.size())
+        {
+            return false;
+        }
+    }
+    size_t indexed = 0;
+    for (uint32_t row : serial_index)
+    {
+        if (row != EMPTY_SLOT && (row >= rows || !(live[row / 64] >> (row % 64) & 1)))
+        {
+            return false;
+        }
+        indexed += row != EMPTY_SLOT;
+    }
+    if (indexed != live_rows)
+    {
+        return false;
+    }
+
+    for (auto *column : {&serial_numbers, &names})
+    {
+        column->resize(padded);
+        for (size_t row = 0; row < rows && in.get_string((*column)[row]); row++)
+        {
+        }
+    }
+    uint64_t irregular_count = 0;
+    in.get(irregular_count);
+    for (uint64_t i = 0; i < irregular_count && in.ok(); i++)
+    {
+        uint32_t row = 0;
+        in.get(row);
+        in.get_string(value);
+        if (row >= rows || dates[row] != IRREGULAR_DATE)
+        {
+            return false;
+        }
+        irregular_dates[row] = value;
+    }
+    if (!in.ok())
+    {
+        return false;
+    }
+
+    return true;
+}
+
+// Columns grow 64 rows at a time so the kernels only ever see whole bitmap words.
+uint32_t ColumnarSnapshot::append_row()
+{
+    uint32_t row = rows++;
+    if (row % 64 == 0)
+    {
+        size_t padded = row + 64;
+        serial_numbers.resize(padded);
+        names.resize(padded);
+        types.resize(padded);
+        dates.resize(padded);
+        location_ids.resize(padded);
+        location_names.resize(padded);
+        location_types.resize(padded);
+        live.push_back(0);
+    }
+    live[row / 64] |= uint64_t(1) << (row % 64);
+    live_rows++;
+    return row;
+}
+
+void ColumnarSnapshot::set_date(uint32_t row, const std::string &creation_date)
+{
+    if (date_key(creation_date, dates[row]))
+    {
+        irregular_dates.erase(row);
+    }
+    else
+    {
+        dates[row] = IRREGULAR_DATE;
+        irregular_dates[row] = creation_date;
+    }
+}
+
+bool ColumnarSnapshot::set_location(uint32_t row, int location_id)
+{
+    auto location = locations.find(location_id);
+    if (location == locations.end())
+    {
+        return false;
+    }
+    location_ids[row] = location_id;
+    location_names[row] = location->second.name;
+    location_types[row] = location->second.type;
+    return true;
+}
+
+void ColumnarSnapshot::remove_row(uint32_t row)
+{
+    unindex_row(row);
+    irregular_dates.erase(row);
+    std::string().swap(serial_numbers[row]);
+    std::string().swap(names[row]);
+    live[row / 64] &= ~(uint64_t(1) << (row % 64));
+    live_rows--;
+}
+
+// Once deleted rows outnumber live ones, live rows are moved down over them.
+void ColumnarSnapshot::compact()
+{
+    if (rows < 1024 || live_rows * 2 >= rows)
+    {
+        return;
+    }
+    std::unordered_map<uint32_t, std::string> moved_dates;
+    uint32_t kept = 0;
+    for (uint32_t row = 0; row < rows; row++)
+    {
+        if (!(live[row / 64] >> (row % 64) & 1))
+        {
+            continue;
+        }
+        if (row != kept)
+        {
+            serial_numbers[kept] = std::move(serial_numbers[row]);
+            names[kept] = std::move(names[row]);
+            types[kept] = types[row];
+            dates[kept] = dates[row];
+            location_ids[kept] = location_ids[row];
+            location_names[kept] = location_names[row];
+            location_types[kept] = location_types[row];
+        }
+        auto irregular = irregular_dates.find(row);
+        if (irregular != irregular_dates.end())
+        {
+            moved_dates[kept] = std::move(irregular->second);
+        }
+        kept++;
+    }
+
+    rows = kept;
+    size_t padded = (rows + 63) / 64 * 64;
+    serial_numbers.resize(padded);
+    names.resize(padded);
+    types.resize(padded);
+    dates.resize(padded);
+    location_ids.resize(padded);
+    location_names.resize(padded);
+    location_types.resize(padded);
+    live.assign(padded / 64, ~uint64_t(0));
+    if (rows % 64 != 0)
+    {
+        live.back() = (uint64_t(1) << (rows % 64)) - 1;
+    }
+    irregular_dates = std::move(moved_dates);
+    rebuild_index();
+}
+
+// Call after append_row() has counted the row as live.
+void ColumnarSnapshot::index_row(uint32_t row)
+{
+    if (live_rows * 2 > serial_index.size())
+    {
+        rebuild_index(); // indexes every live row, this one included
+        return;
+    }
+    size_t mask = serial_index.size() - 1;
+    size_t slot = home_slot(serial_numbers[row]);
+    while (serial_index[slot] != EMPTY_SLOT && !TextKernels::equal_nocase(serial_numbers[serial_index[slot]], serial_numbers[row]))
+    {
+        slot = (slot + 1) & mask;
+    }
+    serial_index[slot] = row;
+}
+
+// Backward-shift deletion: later entries of the probe run move up into the gap, so lookups need no tombstones.
+void ColumnarSnapshot::unindex_row(uint32_t row)
+{
+    size_t mask = serial_index.size() - 1;
+    size_t gap = home_slot(serial_numbers[row]);
+    while (serial_index[gap] != row)
+    {
+        if (serial_index[gap] == EMPTY_SLOT)
+        {
+            return;
+        }
+        gap = (gap + 1) & mask;
+    }
+    for (size_t slot = (gap + 1) & mask; serial_index[slot] != EMPTY_SLOT; slot = (slot + 1) & mask)
+    {
+        // An entry may fill the gap unless its home slot lies cyclically in (gap, slot].
+        size_t home = home_slot(serial_numbers[serial_index[slot]]);
+        if (((slot - home) & mask) >= ((slot - gap) & mask))
+        {
+            serial_index[gap] = serial_index[slot];
+            gap = slot;
+        }
+    }
+    serial_index[gap] = EMPTY_SLOT;
+}
+
+void ColumnarSnapshot::rebuild_index()
+{
+    size_t slots = 1024;
+    while (slots < live_rows * 4)
+    {
+        slots *= 2;
+    }
+    serial_index.assign(slots, EMPTY_SLOT);
+    size_t mask = slots - 1;
+    for (uint32_t row = 0; row < rows; row++)
+    {
+        if (live[row / 64] >> (row % 64) & 1)
+        {
+            size_t slot = home_slot(serial_numbers[row]);
+            while (serial_index[slot] != EMPTY_SLOT)
+            {
+                slot = (slot + 1) & mask;
+            }
+            serial_index[slot] = row;
+        }
+    }
+}
+
+size_t ColumnarSnapshot::home_slot(const std::string &serial_number) const
+{
+    return TextKernels::hash_nocase(serial_number.data(), serial_number.size()) & (serial_index.size() - 1);
+}
+
+const uint32_t *ColumnarSnapshot::find(const std::string &serial_number) const
+{
+    if (serial_index.empty())
+    {
+        return nullptr;
+    }
+    size_t mask = serial_index.size() - 1;
+    for (size_t slot = home_slot(serial_number); serial_index[slot] != EMPTY_SLOT; slot = (slot + 1) & mask)
+    {
+        if (TextKernels::equal_nocase(serial_numbers[serial_index[slot]], serial_number))
+        {
+            return &serial_index[slot];
+        }
+    }
+    return nullptr;
+}
+
+// Fills `bits` with the live rows matching every non-empty predicate.
+bool ColumnarSnapshot::select(const std::string &serial_number, const std::string &type, const std::string &start_date,
+                              const std::string &end_date, const std::string &location_name, const std::string &location_type,
+                              const std::string &location_id, std::vector<uint64_t> &bits) const
+{
+    int32_t low = INT_MIN;
+    int32_t high = INT_MAX;
+    int id = 0;
+    if ((!start_date.empty() && !date_key(start_date, low)) || (!end_date.empty() && !date_key(end_date, high)) ||
+        (!location_id.empty() && !parse_location_id(location_id, id)))
+    {
+        return false;
+    }
+
+    if (serial_number.empty())
+    {
+        bits = live;
+    }
+    else
+    {
+        bits.assign(live.size(), 0);
+        if (const uint32_t *row = find(serial_number))
+        {
+            bits[*row / 64] |= uint64_t(1) << (*row % 64);
+        }
+    }
+
+    size_t words = bits.size();
+    if (!type.empty())
+    {
+        FilterKernels::select_equal(types.data(), words, type_dictionary.matching(type), bits.data());
+    }
+    if (!start_date.empty() || !end_date.empty())
+    {
+        // Irregular dates sit at IRREGULAR_DATE in the column and are compared as strings, like SQLite does.
+        std::vector<uint32_t> irregular_matches;
+        for (const auto &irregular : irregular_dates)
+        {
+            uint32_t row = irregular.first;
+            if ((bits[row / 64] >> (row % 64) & 1) && (start_date.empty() || irregular.second >= start_date) &&
+                (end_date.empty() || irregular.second <= end_date))
+            {
+                irregular_matches.push_back(row);
+            }
+        }
+        FilterKernels::select_range(dates.data(), words, low, high, bits.data());
+        for (const auto &irregular : irregular_dates)
+        {
+            bits[irregular.first / 64] &= ~(uint64_t(1) << (irregular.first % 64));
+        }
+        for (uint32_t row : irregular_matches)
+        {
+            bits[row / 64] |= uint64_t(1) << (row % 64);
+        }
+    }
+    if (!location_name.empty())
+    {
+        FilterKernels::select_equal(location_names.data(), words, location_name_dictionary.matching(location_name), bits.data());
+    }
+    if (!location_type.empty())
+    {
+        FilterKernels::select_equal(location_types.data(), words, location_type_dictionary.matching(location_type), bits.data());
+    }
+    if (!location_id.empty())
+    {
+        FilterKernels::select_equal(reinterpret_cast<const uint32_t *>(location_ids.data()), words, {static_cast<uint32_t>(id)}, bits.data());
+    }
+    return true;
+}
+
+DeviceRow ColumnarSnapshot::row_view(uint32_t row, char *date) const
+{
+    DeviceRow view;
+    view.serial_number = serial_numbers[row];
+    view.name = names[row];
+    view.type = type_dictionary.values[types[row]].str();
+    if (dates[row] == IRREGULAR_DATE)
+    {
+        view.creation_date = irregular_dates.at(row);
+    }
+    else
+    {
+        format_date(dates[row], date);
+        view.creation_date = std::string_view(date, 10);
+    }
+    view.location_id = location_ids[row];
+    view.location_name = location_name_dictionary.values[location_names[row]].str();
+    view.location_type = location_type_dictionary.values[location_types[row]].str();
+    return view;
+}
+
+uint32_t ColumnarSnapshot::Dictionary::code(const InternedString &value)
+{
+    auto it = codes.find(&value.str());
+    if (it != codes.end())
+    {
+        return it->second;
+    }
+    uint32_t code = values.size();
+    values.push_back(value);
+    codes.emplace(&value.str(), code);
+    return code;
+}
+
+std::vector<uint32_t> ColumnarSnapshot::Dictionary::matching(const std::string &value) const
+{
+    std::vector<uint32_t> matches;
+    for (uint32_t code = 0; code < values.size(); code++)
+    {
+        if (TextKernels::equal_nocase(values[code].str(), value))
+        {
+            matches.push_back(code);
+        }
+    }
+    return matches;
+}
@@ -0,0 +1,104 @@
+#pragma once
+#include "DBHandler.h"
+#include "TextKernels.h"
+#include "WarmStart.h"
+#include <cstdint>
+#include <shared_mutex>
+#include <unordered_map>
+
+// Structure-of-arrays copy of one registry file's devices, used to answer filter_devices without SQLite.
+// Type and location name/type are dictionary codes, creation dates are yyyymmdd integers and deleted rows are
+// cleared in a live bitmap, so each predicate is one pass of FilterKernels over a 32-bit column.
+//
+// DBHandler applies every committed mutation to the snapshot under its write lock. A patch that cannot be
+// applied exactly returns false and the caller reloads the snapshot from SQLite.
+class ColumnarSnapshot
+{
+public:
+    ColumnarSnapshot();
+
+    bool load(sqlite3 *db);
+    // Image for the warm-start file. restore() replaces the contents; it returns false, leaving the snapshot
+    // empty and not ready, if the image is malformed or was saved before the snapshot was ready.
+    void save(WarmStartWriter &out) const;
+    bool restore(WarmStartReader &in);
+
+    // Same predicates and matching rules as DBHandler::filter_clause; visits matching rows under the read lock and
+    // counts them in `rows`. Returns false when a parameter cannot be evaluated exactly here (a date outside the
+    // YYYY-MM-DD form, a non-numeric location_id); SQLite answers those.
+    bool filter(const std::string &serial_number, const std::string &type, const std::string &start_date, const std::string &end_date,
+                const std::string &location_name, const std::string &location_type, const std::string &location_id,
+                const DeviceVisitor &visitor, size_t &rows) const;
+
+    bool add_device(const Device &device);
+    bool update_device(const std::string &serial_number, const std::string &name, const std::string &type, const std::string &creation_date,
+                       const std::string &location_id);
+    bool delete_device(const std::string &serial_number);
+    bool relocate_devices(const std::string &serial_number, const std::string &type, const std::string &start_date,
+                          const std::string &end_date, const std::string &location_name, const std::string &location_type,
+                          const std::string &location_id, int target_location_id);
+    bool relocate_devices(const std::vector<std::string> &serial_numbers, int target_location_id);
+    bool add_location(const Location &location);
+    bool update_location(int id, const std::string &name, const std::string &type);
+    bool delete_location(int id);
+
+    size_t size() const;
+
+private:
+    static const int32_t IRREGULAR_DATE = -1;
+    static constexpr uint32_t EMPTY_SLOT = UINT32_MAX;
+
+    // Code per distinct value. Keys are pooled strings, so a code lookup hashes a pointer.
+    struct Dictionary
+    {
+        std::vector<InternedString> values;
+        std::unordered_map<const std::string *, uint32_t> codes;
+
+        uint32_t code(const InternedString &value);
+        std::vector<uint32_t> matching(const std::string &value) const; // codes equal to value ignoring ASCII case
+    };
+
+    struct LocationCodes
+    {
+        uint32_t name;
+        uint32_t type;
+    };
+
+    mutable std::shared_mutex mutex;
+    bool ready; // false until load() succeeds; patches are ignored meanwhile
+    size_t rows; // rows in use, live or deleted; columns are padded to a multiple of 64
+    size_t live_rows;
+    std::vector<std::string> serial_numbers;
+    std::vector<std::string> names;
+    std::vector<uint32_t> types;
+    std::vector<int32_t> dates;
+    std::vector<int32_t> location_ids;
+    std::vector<uint32_t> location_names;
+    std::vector<uint32_t> location_types;
+    std::vector<uint64_t> live;
+    std::unordered_map<uint32_t, std::string> irregular_dates; // creation dates not in YYYY-MM-DD form, by row
+    // Row of every live serial number: linear probing over row numbers, keys compared ignoring ASCII case (as the
+    // NOCASE column does) against serial_numbers. Flat, so the warm-start file holds it as a single array.
+    std::vector<uint32_t> serial_index; // EMPTY_SLOT or a row; a power of two at most half full
+    Dictionary type_dictionary;
+    Dictionary location_name_dictionary;
+    Dictionary location_type_dictionary;
+    std::unordered_map<int, LocationCodes> locations;
+
+    void clear();
+    bool read_image(WarmStartReader &in);
+    uint32_t append_row();
+    void set_date(uint32_t row, const std::string &creation_date);
+    bool set_location(uint32_t row, int location_id);
+    void remove_row(uint32_t row);
+    void compact();
+    void index_row(uint32_t row);
+    void unindex_row(uint32_t row);
+    void rebuild_index();
+    size_t home_slot(const std::string &serial_number) const;
+    const uint32_t *find(const std::string &serial_number) const;
+    bool select(const std::string &serial_number, const std::string &type, const std::string &start_date, const std::string &end_date,
+                const std::string &location_name, const std::string &location_type, const std::string &location_id,
+                std::vector<uint64_t> &bits) const;
+    DeviceRow row_view(uint32_t row, char *date) const; // date: 10 bytes of scratch for the formatted creation date
+};
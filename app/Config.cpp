@@ -0,0 +1,72 @@
+#include "Config.h"
+#include <cstdlib>
+#include <iostream>
+
+namespace
+{
+    void read_string(const char *name, std::string &value)
+    {
+        const char *env = std::getenv(name);
+        if (env != nullptr && *env != '\0')
+        {
+            value = env;
+        }
+    }
+
+    void read_int(const char *name, int &value)
+    {
+        const char *env = std::getenv(name);
+        if (env == nullptr || *env == '\0')
+        {
+            return;
+        }
+        try
+        {
+            value = std::stoi(env);
+        }
+        catch (...)
+        {
+            std::cerr << "Ignoring invalid " << name << ": " << env << std::endl;
+        }
+    }
+
+    void read_double(const char *name, double &value)
+    {
+        const char *env = std::getenv(name);
+        if (env == nullptr || *env == '\0')
+        {
+            return;
+        }
+        try
+        {
+            value = std::stod(env);
+        }
+        catch (...)
+        {
+            std::cerr << "Ignoring invalid " << name << ": " << env << std::endl;
+        }
+    }
+}
+
+Config load_config()
+{
+    Config config;
+    read_string("REGISTRY_DB_PATH", config.db_path);
+    read_int("REGISTRY_SHARDS", config.shards);
+    read_int("REGISTRY_READ_CONNECTIONS", config.read_connections);
+    read_int("REGISTRY_COLUMNAR_SNAPSHOT", config.columnar_snapshot);
+    read_int("REGISTRY_WARM_START", config.warm_start);
+    read_int("REGISTRY_PORT", config.port);
+    read_int("REGISTRY_EVENT_LOOP_PORT", config.event_loop_port);
+    read_int("REGISTRY_EVENT_LOOP_IDLE_S", config.event_loop_idle_s);
+    read_int("REGISTRY_DB_THREADS", config.db_threads);
+    read_string("REGISTRY_REPLICATE_FROM", config.replicate_from);
+    read_int("REGISTRY_REPLICATION_LOG", config.replication_log);
+    read_double("REGISTRY_SLOW_QUERY_MS", config.slow_query_ms);
+    read_int("REGISTRY_MAINTENANCE", config.maintenance);
+    read_double("REGISTRY_MAINTENANCE_IDLE_RPS", config.maintenance_idle_rps);
+    read_int("REGISTRY_ADMISSION_LIMIT", config.admission_limit);
+    read_int("REGISTRY_ADMISSION_MIN_LIMIT", config.admission_min_limit);
+    read_double("REGISTRY_TARGET_LATENCY_MS", config.target_latency_ms);
+    return config;
+}
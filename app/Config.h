@@ -0,0 +1,26 @@
+#pragma once
+#include <string>
+
+// Server settings, read from REGISTRY_* environment variables so they can be set per container.
+struct Config
+{
+    std::string db_path = "registry.db"; // REGISTRY_DB_PATH
+    int shards = 1;                      // REGISTRY_SHARDS, above 1 partitions devices over that many files
+    int read_connections = 4;            // REGISTRY_READ_CONNECTIONS, read-only connections per registry file; 0 reads on the writer
+    int columnar_snapshot = 0;           // REGISTRY_COLUMNAR_SNAPSHOT, 1 answers device filters from an in-memory columnar copy
+    int warm_start = 1;                  // REGISTRY_WARM_START, 0 rebuilds in-memory state from SQLite at every start instead of using <db>.warm
+    int port = 8080;                     // REGISTRY_PORT
+    int event_loop_port = 0;             // REGISTRY_EVENT_LOOP_PORT, also serves device, location and admin routes from the epoll front end on this port
+    int event_loop_idle_s = 300;         // REGISTRY_EVENT_LOOP_IDLE_S, idle keep-alive timeout on that front end
+    int db_threads = 4;                  // REGISTRY_DB_THREADS, threads running the event loop's database calls in a coroutine build
+    std::string replicate_from;          // REGISTRY_REPLICATE_FROM, host:port of the primary; set to run as a read-only follower
+    int replication_log = 100000;        // REGISTRY_REPLICATION_LOG, mutations a primary keeps for followers to catch up from
+    double slow_query_ms = 100.0;        // REGISTRY_SLOW_QUERY_MS
+    int maintenance = 1;                 // REGISTRY_MAINTENANCE, 0 leaves checkpoints and statistics to SQLite and skips incremental vacuum
+    double maintenance_idle_rps = 20;    // REGISTRY_MAINTENANCE_IDLE_RPS, request rate below which background maintenance may run
+    int admission_limit = 256;           // REGISTRY_ADMISSION_LIMIT
+    int admission_min_limit = 8;         // REGISTRY_ADMISSION_MIN_LIMIT
+    double target_latency_ms = 0;        // REGISTRY_TARGET_LATENCY_MS, 0 disables the adaptive limit
+};
+
+Config load_config();
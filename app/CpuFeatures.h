@@ -0,0 +1,15 @@
+#pragma once
+
+// Runtime CPU feature checks for the kernels that ship an AVX2 version next to a portable one.
+#if defined(__x86_64__) || defined(__i386__)
+#define REGISTRY_X86 1
+#endif
+
+inline bool cpu_has_avx2()
+{
+#ifdef REGISTRY_X86
+    return __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+}
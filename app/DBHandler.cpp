@@ -1,6 +1,186 @@
 #include "DBHandler.h"
+#include "ColumnarSnapshot.h"
+#include "Metrics.h"
+#include <chrono>
+#include <iterator>
+#include <random>
 
-DBHandler::DBHandler(const std::string &db_path) : db(nullptr), db_path(db_path) {}
+namespace
+{
+    // Devices carry their location's name and type (see migrate_schema), so reads need no join.
+    const std::string DEVICE_SELECT = "SELECT devices.serial_number, devices.name, devices.type, devices.creation_date, devices.location_id,"
+                                      " devices.location_name, devices.location_type FROM devices ";
+
+    // Indexes that give device listings their sort orders (see order_clauses). Rows of a WITHOUT ROWID table are
+    // indexed together with their primary key, so equal keys come out in serial number order.
+    struct SortIndex
+    {
+        const char *name;
+        const char *columns;
+    };
+    const SortIndex SORT_INDEXES[] = {{"devices_name", "name"}, {"devices_creation_date", "creation_date"},
+                                      {"devices_location_id_creation_date", "location_id, creation_date"}};
+
+    // Index hint and ORDER BY ... LIMIT ? for a listing in `order`. The hint names the index whose order the
+    // ORDER BY follows, so SQLite walks it instead of sorting into a temporary B-tree. With an equality on
+    // location_id, serial number and creation date orders start at that location's entries; other filters are
+    // checked row by row along the index. A serial number filter matches one row at most and needs neither.
+    void order_clauses(const DeviceOrder &order, bool by_location, bool by_serial, std::string &hint, std::string &tail)
+    {
+        static const char *const COLUMNS[] = {"", "devices.serial_number", "devices.name", "devices.creation_date"};
+        if (order.sort != SORT_NONE && !by_serial)
+        {
+            const char *direction = order.descending ? " DESC" : "";
+            switch (order.sort)
+            {
+            case SORT_SERIAL_NUMBER:
+                hint = by_location ? "INDEXED BY devices_location_id " : "NOT INDEXED ";
+                break;
+            case SORT_NAME:
+                hint = "INDEXED BY devices_name ";
+                break;
+            default:
+                hint = by_location ? "INDEXED BY devices_location_id_creation_date " : "INDEXED BY devices_creation_date ";
+                break;
+            }
+            tail = std::string(" ORDER BY ") + COLUMNS[order.sort] + direction;
+            if (order.sort != SORT_SERIAL_NUMBER)
+            {
+                tail += std::string(", devices.serial_number") + direction;
+            }
+        }
+        if (order.limit > 0)
+        {
+            tail += " LIMIT ?";
+        }
+    }
+
+    // Batches up to this size are resolved with bound IN lists, larger ones through a temp-table join.
+    const size_t LOOKUP_IN_LIST_MAX = 2000;
+    const size_t LOOKUP_CHUNK = 512;
+
+    // A text column in SQLite's buffer, valid until the statement steps or resets. Empty for NULL.
+    std::string_view column_view(sqlite3_stmt *stmt, int column)
+    {
+        const char *text = reinterpret_cast<const char *>(sqlite3_column_text(stmt, column));
+        return text ? std::string_view(text, sqlite3_column_bytes(stmt, column)) : std::string_view();
+    }
+
+    // Target location id is parameter 1; the location columns follow it.
+    const std::string RELOCATE_SET = "location_id = ?1, location_name = (SELECT name FROM locations WHERE id = ?1),"
+                                     " location_type = (SELECT type FROM locations WHERE id = ?1)";
+
+    // While a warm-start token is stored, triggers clear it on the first row another writer changes; this
+    // handler drops the token itself instead (see drop_warm_start_stamp), so its own writes pay for no trigger.
+    struct WarmStartTrigger
+    {
+        const char *table;
+        const char *event;
+    };
+    const WarmStartTrigger WARM_START_TRIGGERS[] = {{"devices", "insert"}, {"devices", "update"}, {"devices", "delete"},
+                                                    {"locations", "insert"}, {"locations", "update"}, {"locations", "delete"}};
+
+    // device_history stores each version as a delta: add rows hold every column, update rows only the columns
+    // that changed (NULL for the rest), delete rows none. Triggers on devices write it in the transaction of the
+    // change, so every write path, cascades and other programs included, is recorded. Rows are appended in commit
+    // order; the index on (serial_number, changed_at) finds one device's versions.
+    enum HistoryOp
+    {
+        HISTORY_ADD,
+        HISTORY_UPDATE,
+        HISTORY_DELETE
+    };
+    const char *const HISTORY_OP_NAMES[] = {"add", "update", "delete"};
+    const int HISTORY_COLUMN_COUNT = 6;
+    const char *const HISTORY_COLUMNS[HISTORY_COLUMN_COUNT] = {"name", "type", "creation_date", "location_id", "location_name", "location_type"};
+    const int HISTORY_ALL_COLUMNS = (1 << HISTORY_COLUMN_COUNT) - 1;
+
+    // Milliseconds since the Unix epoch. SQLite fixes 'now' for the length of a statement, so the rows one
+    // statement changes share a timestamp.
+    const std::string HISTORY_NOW = "CAST((julianday('now') - 2440587.5) * 86400000 AS INTEGER)";
+
+    // changed_at, op, the HISTORY_COLUMNS and serial_number, in that order.
+    const std::string HISTORY_SELECT = "SELECT changed_at, op, name, type, creation_date, location_id, location_name, location_type, serial_number "
+                                       "FROM device_history ";
+
+    // Table, index and triggers of device_history. Devices recorded before the table existed get an add entry
+    // at the time of the migration.
+    std::string history_schema()
+    {
+        std::string names;
+        std::string full;
+        std::string delta;
+        std::string changed;
+        for (const char *column : HISTORY_COLUMNS)
+        {
+            std::string differs = std::string("NEW.") + column + " IS NOT OLD." + column + " COLLATE binary";
+            names += (names.empty() ? "" : ", ") + std::string(column);
+            full += std::string(", NEW.") + column;
+            delta += ", CASE WHEN " + differs + " THEN NEW." + column + " END";
+            changed += (changed.empty() ? "" : " OR ") + differs;
+        }
+        std::string insert = " INSERT INTO device_history (serial_number, changed_at, op, " + names + ") VALUES ";
+        std::string add = insert + "(NEW.serial_number, " + HISTORY_NOW + ", " + std::to_string(HISTORY_ADD) + full + ");";
+        std::string update = insert + "(NEW.serial_number, " + HISTORY_NOW + ", " + std::to_string(HISTORY_UPDATE) + delta + ");";
+        std::string remove = " INSERT INTO device_history (serial_number, changed_at, op) VALUES (OLD.serial_number, " + HISTORY_NOW + ", " +
+                             std::to_string(HISTORY_DELETE) + ");";
+        std::string renamed = "NEW.serial_number IS NOT OLD.serial_number COLLATE binary";
+        return "CREATE TABLE IF NOT EXISTS device_history (id INTEGER PRIMARY KEY, serial_number TEXT COLLATE nocase NOT NULL, "
+               "changed_at INTEGER NOT NULL, op INTEGER NOT NULL, name TEXT, type TEXT, creation_date TEXT, location_id INTEGER, "
+               "location_name TEXT, location_type TEXT);"
+               "CREATE INDEX IF NOT EXISTS device_history_serial ON device_history (serial_number, changed_at);"
+               "CREATE TRIGGER IF NOT EXISTS devices_history_insert AFTER INSERT ON devices BEGIN" + add + " END;"
+               "CREATE TRIGGER IF NOT EXISTS devices_history_update AFTER UPDATE ON devices WHEN NOT (" + renamed + ") AND (" + changed + ") BEGIN" +
+               update + " END;"
+               // A new serial number ends one device and starts another.
+               "CREATE TRIGGER IF NOT EXISTS devices_history_rename AFTER UPDATE ON devices WHEN " + renamed + " BEGIN" + remove + add + " END;"
+               "CREATE TRIGGER IF NOT EXISTS devices_history_delete AFTER DELETE ON devices BEGIN" + remove + " END;"
+               "INSERT INTO device_history (serial_number, changed_at, op, " + names + ") SELECT serial_number, " + HISTORY_NOW + ", " +
+               std::to_string(HISTORY_ADD) + ", " + names + " FROM devices WHERE NOT EXISTS (SELECT 1 FROM device_history);";
+    }
+
+    // Copies the non-NULL HISTORY_COLUMNS of a device_history row into `device`, leaving alone the columns set in
+    // `filled`. Returns `filled` with the copied columns added.
+    int apply_history_row(sqlite3_stmt *stmt, Device &device, int filled)
+    {
+        for (int i = 0; i < HISTORY_COLUMN_COUNT; i++)
+        {
+            int column = i + 2;
+            if ((filled & (1 << i)) != 0 || sqlite3_column_type(stmt, column) == SQLITE_NULL)
+            {
+                continue;
+            }
+            std::string_view text = column_view(stmt, column);
+            switch (i)
+            {
+            case 0:
+                device.name = text;
+                break;
+            case 1:
+                device.type = StringPool::instance().intern(text);
+                break;
+            case 2:
+                device.creation_date = text;
+                break;
+            case 3:
+                device.location_id = sqlite3_column_int(stmt, column);
+                break;
+            case 4:
+                device.location_name = StringPool::instance().intern(text);
+                break;
+            case 5:
+                device.location_type = StringPool::instance().intern(text);
+                break;
+            }
+            filled |= 1 << i;
+        }
+        return filled;
+    }
+}
+
+DBHandler::DBHandler(const std::string &db_path, int read_connections, bool columnar_snapshot, bool warm_start)
+    : db(nullptr), db_path(db_path), read_connections(read_connections), warm_start(warm_start), warm_start_stamped(true),
+      profiler(db_path), trace_owner(this), columnar(columnar_snapshot ? std::make_unique<ColumnarSnapshot>() : nullptr) {}
 
 DBHandler::~DBHandler()
 {
@@ -10,11 +190,58 @@ DBHandler::~DBHandler()
 bool DBHandler::open_connection()
 {
     int rc = sqlite3_open(db_path.c_str(), &db);
-    return (rc == SQLITE_OK);
+    if (rc != SQLITE_OK)
+    {
+        return false;
+    }
+    sqlite3_trace_v2(db, SQLITE_TRACE_PROFILE, &DBHandler::trace_callback, trace_owner);
+    if (!migrate_schema())
+    {
+        return false;
+    }
+
+    if (read_connections > 0)
+    {
+        // WAL lets the read-only connections keep their snapshot while the writer commits.
+        sqlite3_stmt *stmt;
+        bool wal = sqlite3_prepare_v2(db, "PRAGMA journal_mode=WAL", -1, &stmt, NULL) == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW &&
+                   std::string(reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0))) == "wal";
+        sqlite3_finalize(stmt);
+        if (!wal)
+        {
+            std::cerr << "Error enabling WAL: " << sqlite3_errmsg(db) << std::endl;
+            return false;
+        }
+        if (!read_pool.open(db_path, read_connections, &DBHandler::trace_callback, trace_owner))
+        {
+            return false;
+        }
+    }
+
+    bool filter_loaded = false;
+    bool columnar_loaded = false;
+    if (warm_start)
+    {
+        load_warm_start(filter_loaded, columnar_loaded);
+    }
+    if (!filter_loaded && !build_serial_filter(0))
+    {
+        return false;
+    }
+    if (!columnar_loaded)
+    {
+        load_columnar();
+    }
+    return true;
 }
 
 void DBHandler::close_connection()
 {
+    if (db && warm_start)
+    {
+        save_warm_start();
+    }
+    read_pool.close();
     if (db)
     {
         sqlite3_close(db);
@@ -26,26 +253,36 @@ void DBHandler::close_connection()
 // 1. List all devices
 std::vector<Device> DBHandler::get_devices()
 {
-    std::string sql = "SELECT devices.serial_number, devices.name, devices.type, devices.creation_date, devices.location_id, locations.name, locations.type"
-                      " FROM devices INNER JOIN locations ON devices.location_id = locations.id ";
-
     std::vector<Device> devices;
+    visit_devices([&devices](const DeviceRow &row)
+                  { devices.push_back(row.to_device()); });
+    return devices;
+}
+
+size_t DBHandler::visit_devices(const DeviceVisitor &visitor, const DeviceOrder &order)
+{
+    std::string hint;
+    std::string tail;
+    order_clauses(order, false, false, hint, tail);
+    std::string sql = DEVICE_SELECT + hint + tail;
+
+    ReadAccess access = begin_read();
+    sqlite3 *conn = access.conn;
     sqlite3_stmt *stmt;
-    int rc = sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, NULL);
+    int rc = sqlite3_prepare_v2(conn, sql.c_str(), -1, &stmt, NULL);
     if (rc != SQLITE_OK)
     {
-        std::cerr << "Error preparing SQL statement: " << sqlite3_errmsg(db) << std::endl;
-        return devices;
+        std::cerr << "Error preparing SQL statement: " << sqlite3_errmsg(conn) << std::endl;
+        return 0;
     }
-
-    while (sqlite3_step(stmt) == SQLITE_ROW)
+    if (order.limit > 0)
     {
-        Device device = extract_device_data(stmt);
-        devices.push_back(device);
+        sqlite3_bind_int64(stmt, 1, static_cast<sqlite3_int64>(order.limit));
     }
 
+    size_t rows = visit_rows(stmt, visitor);
     sqlite3_finalize(stmt);
-    return devices;
+    return rows;
 }
 
 // 2. Filter by metadata: Only serial_number, name, type, creation_date, location_id, start_date, end_date, location_name, location_type.
@@ -53,61 +290,79 @@ std::vector<Device> DBHandler::filter_devices(const std::string &serial_number,
                                               const std::string &creation_date, const std::string &location_id, const std::string &start_date,
                                               const std::string &end_date, const std::string &location_name, const std::string &location_type)
 {
-    std::string sql = "SELECT devices.serial_number, devices.name, devices.type, devices.creation_date, devices.location_id, locations.name, locations.type"
-                      " FROM devices INNER JOIN locations ON devices.location_id = locations.id "
-                      "WHERE 1=1";
-    if (!serial_number.empty())
-    {
-        sql += " AND devices.serial_number = '" + serial_number + "'";
-    }
-    if (!type.empty())
-    {
-        sql += " AND devices.type = '" + type + "'";
-    }
-    if (!start_date.empty())
-    {
-        sql += " AND devices.creation_date >= '" + start_date + "'";
-    }
-    if (!end_date.empty())
-    {
-        sql += " AND devices.creation_date <= '" + end_date + "'";
-    }
-    if (!location_name.empty())
-    {
-        sql += " AND locations.name = '" + location_name + "'";
-    }
-    if (!location_type.empty())
-    {
-        sql += " AND locations.type = '" + location_type + "'";
-    }
-    if (!location_id.empty())
+    std::vector<Device> filtered_devices;
+    visit_filtered_devices(serial_number, name, type, creation_date, location_id, start_date, end_date, location_name, location_type,
+                           [&filtered_devices](const DeviceRow &row)
+                           { filtered_devices.push_back(row.to_device()); });
+    return filtered_devices;
+}
+
+size_t DBHandler::visit_filtered_devices(const std::string &serial_number, const std::string &name, const std::string &type,
+                                         const std::string &creation_date, const std::string &location_id, const std::string &start_date,
+                                         const std::string &end_date, const std::string &location_name, const std::string &location_type,
+                                         const DeviceVisitor &visitor, const DeviceOrder &order)
+{
+    // The columnar snapshot yields its own row order in full, so sorted or limited listings go to SQLite.
+    size_t rows = 0;
+    bool storage_order = order.sort == SORT_NONE && order.limit == 0;
+    if (storage_order && columnar && columnar->filter(serial_number, type, start_date, end_date, location_name, location_type, location_id, visitor, rows))
     {
-        sql += " AND location_id =  " + location_id;
+        return rows;
     }
 
-    std::vector<Device> filtered_devices;
+    // Values are bound rather than spliced into the SQL, so each filter combination compiles to one statement text.
+    std::vector<const std::string *> values;
+    std::string hint;
+    std::string tail;
+    order_clauses(order, !location_id.empty(), !serial_number.empty(), hint, tail);
+    std::string sql = DEVICE_SELECT + hint + "WHERE 1=1" +
+                      filter_clause(serial_number, type, start_date, end_date, location_name, location_type, location_id, values) + tail;
+
+    ReadAccess access = begin_read();
+    sqlite3 *conn = access.conn;
     sqlite3_stmt *stmt;
-    int rc = sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, NULL);
+    int rc = sqlite3_prepare_v2(conn, sql.c_str(), -1, &stmt, NULL);
     if (rc != SQLITE_OK)
     {
-        std::cerr << "Error preparing SQL statement: " << sqlite3_errmsg(db) << std::endl;
-        return filtered_devices;
+        std::cerr << "Error preparing SQL statement: " << sqlite3_errmsg(conn) << std::endl;
+        return 0;
     }
 
-    while (sqlite3_step(stmt) == SQLITE_ROW)
+    for (size_t i = 0; i < values.size(); i++)
+    {
+        sqlite3_bind_text(stmt, i + 1, values[i]->c_str(), -1, SQLITE_STATIC);
+    }
+    if (order.limit > 0)
     {
-        Device device = extract_device_data(stmt);
-        filtered_devices.push_back(device);
+        sqlite3_bind_int64(stmt, values.size() + 1, static_cast<sqlite3_int64>(order.limit));
     }
 
+    rows = visit_rows(stmt, visitor);
     sqlite3_finalize(stmt);
-    return filtered_devices;
+    return rows;
+}
+
+// A single registry file is a single part.
+size_t DBHandler::visit_device_parts(const DevicePartVisitors &visitors, const DeviceOrder &order)
+{
+    return visit_devices(visitors(0, 1), order);
+}
+
+size_t DBHandler::visit_filtered_device_parts(const std::string &serial_number, const std::string &name, const std::string &type,
+                                              const std::string &creation_date, const std::string &location_id, const std::string &start_date,
+                                              const std::string &end_date, const std::string &location_name, const std::string &location_type,
+                                              const DevicePartVisitors &visitors, const DeviceOrder &order)
+{
+    return visit_filtered_devices(serial_number, name, type, creation_date, location_id, start_date, end_date, location_name, location_type,
+                                  visitors(0, 1), order);
 }
 
 // 3. Add new device
 bool DBHandler::add_device(const Device &device)
 {
-    std::string sql = "INSERT INTO devices (serial_number, name, type, creation_date, location_id) VALUES (?, ?, ?, ?, ?)";
+    // For a missing location the subqueries yield NULL, which the NOT NULL location columns reject.
+    std::string sql = "INSERT INTO devices (serial_number, name, type, creation_date, location_id, location_name, location_type)"
+                      " VALUES (?, ?, ?, ?, ?, (SELECT name FROM locations WHERE id = ?5), (SELECT type FROM locations WHERE id = ?5))";
 
     sqlite3_stmt *stmt;
     int rc = sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, NULL);
@@ -117,10 +372,37 @@ bool DBHandler::add_device(const Device &device)
         return false;
     }
 
+    std::lock_guard<std::mutex> lock(write_mutex);
+    drop_warm_start_stamp();
+    // The serial goes into the filter before the row commits, so a pooled reader never gets a definite miss for a
+    // committed device. A failed INSERT takes it out again; a false positive meanwhile costs one query.
+    if (!serial_filter.add(device.serial_number))
+    {
+        // The filter is full: rebuild it larger, then add the serial to the new one.
+        build_serial_filter(serial_filter.capacity() * 2);
+        serial_filter.add(device.serial_number);
+    }
     bind_device_data(stmt, device);
     rc = sqlite3_step(stmt);
-
     sqlite3_finalize(stmt);
+
+    if (rc != SQLITE_DONE)
+    {
+        serial_filter.remove(device.serial_number);
+    }
+    if (rc == SQLITE_DONE && columnar && !columnar->add_device(device))
+    {
+        load_columnar();
+    }
+    if (rc == SQLITE_DONE)
+    {
+        publish({{"op", "add_device"},
+                 {"device", {{"serial_number", device.serial_number},
+                             {"name", device.name},
+                             {"type", device.type},
+                             {"creation_date", device.creation_date},
+                             {"location_id", device.location_id}}}});
+    }
     return (rc == SQLITE_DONE);
 }
 
@@ -142,7 +424,7 @@ bool DBHandler::update_device(const std::string &serial_number, const std::strin
     }
     if (!location_id.empty())
     {
-        sql += "location_id = ?, ";
+        sql += "location_id = ?, location_name = (SELECT name FROM locations WHERE id = ?), location_type = (SELECT type FROM locations WHERE id = ?), ";
     }
     sql.pop_back();
     sql.pop_back();
@@ -169,14 +451,29 @@ bool DBHandler::update_device(const std::string &serial_number, const std::strin
     {
         sqlite3_bind_text(stmt, bind_index++, creation_date.c_str(), -1, SQLITE_STATIC);
     }
-    if (!location_id.empty())
+    for (int i = 0; i < 3 && !location_id.empty(); i++)
     {
         sqlite3_bind_text(stmt, bind_index++, location_id.c_str(), -1, SQLITE_STATIC);
     }
     sqlite3_bind_text(stmt, bind_index++, serial_number.c_str(), -1, SQLITE_STATIC);
+    std::lock_guard<std::mutex> lock(write_mutex);
+    drop_warm_start_stamp();
     rc = sqlite3_step(stmt);
 
     sqlite3_finalize(stmt);
+    if (rc == SQLITE_DONE && columnar && !columnar->update_device(serial_number, name, type, creation_date, location_id))
+    {
+        load_columnar();
+    }
+    if (rc == SQLITE_DONE)
+    {
+        publish({{"op", "update_device"},
+                 {"serial_number", serial_number},
+                 {"name", name},
+                 {"type", type},
+                 {"creation_date", creation_date},
+                 {"location_id", location_id}});
+    }
     return (rc == SQLITE_DONE);
 }
 
@@ -193,13 +490,264 @@ bool DBHandler::delete_device(const std::string &serial_number)
         return false;
     }
 
+    std::lock_guard<std::mutex> lock(write_mutex);
+    drop_warm_start_stamp();
     sqlite3_bind_text(stmt, 1, serial_number.c_str(), -1, SQLITE_STATIC);
     rc = sqlite3_step(stmt);
-
+    int deleted = rc == SQLITE_DONE ? sqlite3_changes(db) : 0;
     sqlite3_finalize(stmt);
+
+    if (deleted > 0)
+    {
+        serial_filter.remove(serial_number);
+        if (columnar)
+        {
+            columnar->delete_device(serial_number);
+        }
+        publish({{"op", "delete_device"}, {"serial_number", serial_number}});
+    }
     return (rc == SQLITE_DONE);
 }
 
+// 6. Look up a batch of devices by serial number. Serials the filter rules out never reach SQLite.
+std::vector<Device> DBHandler::lookup_devices(const std::vector<std::string> &serial_numbers)
+{
+    std::vector<std::string> candidates;
+    for (const auto &serial_number : serial_numbers)
+    {
+        if (serial_filter.might_contain(serial_number))
+        {
+            candidates.push_back(serial_number);
+        }
+    }
+
+    std::vector<Device> devices;
+    if (candidates.size() > LOOKUP_IN_LIST_MAX)
+    {
+        lookup_with_temp_table(candidates, devices);
+        return devices;
+    }
+
+    // Chunks are padded to a power of two by repeating the last serial, so only a handful of statement texts exist.
+    // All chunks read the same snapshot.
+    ReadAccess access = begin_read();
+    sqlite3 *conn = access.conn;
+    for (size_t first = 0; first < candidates.size(); first += LOOKUP_CHUNK)
+    {
+        size_t count = std::min(LOOKUP_CHUNK, candidates.size() - first);
+        size_t placeholders = 1;
+        while (placeholders < count)
+        {
+            placeholders *= 2;
+        }
+        std::string sql = DEVICE_SELECT + "WHERE devices.serial_number IN (?";
+        for (size_t i = 1; i < placeholders; i++)
+        {
+            sql += ", ?";
+        }
+        sql += ")";
+
+        sqlite3_stmt *stmt;
+        int rc = sqlite3_prepare_v2(conn, sql.c_str(), -1, &stmt, NULL);
+        if (rc != SQLITE_OK)
+        {
+            std::cerr << "Error preparing SQL statement: " << sqlite3_errmsg(conn) << std::endl;
+            return devices;
+        }
+        for (size_t i = 0; i < placeholders; i++)
+        {
+            const std::string &serial_number = candidates[first + std::min(i, count - 1)];
+            sqlite3_bind_text(stmt, i + 1, serial_number.c_str(), -1, SQLITE_STATIC);
+        }
+        while (sqlite3_step(stmt) == SQLITE_ROW)
+        {
+            devices.push_back(extract_device_data(stmt));
+        }
+        sqlite3_finalize(stmt);
+    }
+    return devices;
+}
+
+// 7. Move every device matching the filters to another location with one UPDATE. Returns the number of devices moved, -1 on error.
+int DBHandler::relocate_devices(const std::string &serial_number, const std::string &type, const std::string &start_date,
+                                const std::string &end_date, const std::string &location_name, const std::string &location_type,
+                                const std::string &location_id, int target_location_id)
+{
+    std::vector<const std::string *> values;
+    std::string sql = "UPDATE devices SET " + RELOCATE_SET + " WHERE 1=1" +
+                      filter_clause(serial_number, type, start_date, end_date, location_name, location_type, location_id, values);
+
+    // Followers replay the serial numbers actually moved, not the filter. On a sharded registry every shard commits
+    // and publishes its part on its own, and the filter applied again at each of those log positions could match
+    // devices added in between.
+    std::lock_guard<std::mutex> lock(write_mutex);
+    bool returning = static_cast<bool>(mutation_listener);
+    if (returning)
+    {
+        sql += " RETURNING serial_number";
+    }
+
+    sqlite3_stmt *stmt;
+    int rc = sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, NULL);
+    if (rc != SQLITE_OK)
+    {
+        std::cerr << "Error preparing SQL statement: " << sqlite3_errmsg(db) << std::endl;
+        return -1;
+    }
+
+    sqlite3_bind_int(stmt, 1, target_location_id);
+    for (size_t i = 0; i < values.size(); i++)
+    {
+        sqlite3_bind_text(stmt, i + 2, values[i]->c_str(), -1, SQLITE_STATIC);
+    }
+
+    drop_warm_start_stamp();
+    std::vector<std::string> moved;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW)
+    {
+        moved.emplace_back(reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0)));
+    }
+    int relocated = rc == SQLITE_DONE ? sqlite3_changes(db) : -1;
+    sqlite3_finalize(stmt);
+    if (relocated > 0 && columnar &&
+        !columnar->relocate_devices(serial_number, type, start_date, end_date, location_name, location_type, location_id, target_location_id))
+    {
+        load_columnar();
+    }
+    if (relocated > 0 && returning)
+    {
+        publish({{"op", "relocate_devices"}, {"serial_numbers", moved}, {"to_location_id", target_location_id}});
+    }
+    return relocated;
+}
+
+// 8. Move a list of devices to another location in one transaction. Returns the number of devices moved, -1 on error.
+int DBHandler::relocate_devices(const std::vector<std::string> &serial_numbers, int target_location_id)
+{
+    std::lock_guard<std::mutex> write_lock(write_mutex);
+    std::lock_guard<std::mutex> lookup_lock(lookup_mutex);
+    drop_warm_start_stamp();
+    if (sqlite3_exec(db, "BEGIN", NULL, NULL, NULL) != SQLITE_OK)
+    {
+        std::cerr << "Error starting transaction: " << sqlite3_errmsg(db) << std::endl;
+        return -1;
+    }
+    if (!fill_lookup_table(serial_numbers))
+    {
+        sqlite3_exec(db, "ROLLBACK", NULL, NULL, NULL);
+        return -1;
+    }
+
+    sqlite3_stmt *stmt;
+    std::string sql = "UPDATE devices SET " + RELOCATE_SET + " WHERE serial_number IN (SELECT serial_number FROM temp.lookup_serials)";
+    int rc = sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, NULL);
+    if (rc != SQLITE_OK)
+    {
+        std::cerr << "Error preparing SQL statement: " << sqlite3_errmsg(db) << std::endl;
+        sqlite3_exec(db, "ROLLBACK", NULL, NULL, NULL);
+        return -1;
+    }
+    sqlite3_bind_int(stmt, 1, target_location_id);
+    rc = sqlite3_step(stmt);
+    int relocated = sqlite3_changes(db);
+    sqlite3_finalize(stmt);
+
+    if (rc != SQLITE_DONE || sqlite3_exec(db, "DELETE FROM temp.lookup_serials; COMMIT", NULL, NULL, NULL) != SQLITE_OK)
+    {
+        sqlite3_exec(db, "ROLLBACK", NULL, NULL, NULL);
+        return -1;
+    }
+    if (relocated > 0 && columnar && !columnar->relocate_devices(serial_numbers, target_location_id))
+    {
+        load_columnar();
+    }
+    if (relocated > 0)
+    {
+        publish({{"op", "relocate_devices"}, {"serial_numbers", serial_numbers}, {"to_location_id", target_location_id}});
+    }
+    return relocated;
+}
+
+// 9. Every recorded version of a device, oldest first. Update entries only hold what changed, so each one is
+// applied to the state before it.
+std::vector<DeviceVersion> DBHandler::get_device_history(const std::string &serial_number)
+{
+    std::vector<DeviceVersion> versions;
+    ReadAccess access = begin_read();
+    sqlite3 *conn = access.conn;
+    sqlite3_stmt *stmt;
+    int rc = sqlite3_prepare_v2(conn, (HISTORY_SELECT + "WHERE serial_number = ? ORDER BY changed_at, id").c_str(), -1, &stmt, NULL);
+    if (rc != SQLITE_OK)
+    {
+        std::cerr << "Error preparing SQL statement: " << sqlite3_errmsg(conn) << std::endl;
+        return versions;
+    }
+    sqlite3_bind_text(stmt, 1, serial_number.c_str(), -1, SQLITE_STATIC);
+
+    Device device;
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        int op = sqlite3_column_int(stmt, 1);
+        if (op < HISTORY_ADD || op > HISTORY_DELETE)
+        {
+            continue;
+        }
+        if (op != HISTORY_UPDATE)
+        {
+            device = Device();
+        }
+        apply_history_row(stmt, device, 0);
+        device.serial_number = column_view(stmt, 8);
+        versions.push_back({sqlite3_column_int64(stmt, 0), HISTORY_OP_NAMES[op], device});
+    }
+    sqlite3_finalize(stmt);
+    return versions;
+}
+
+// 10. The version in effect at `as_of`: the index seek lands on the newest entry at or before it, and older
+// entries are read back only until every column is known, at most as far as the device's add entry.
+bool DBHandler::get_device_as_of(const std::string &serial_number, int64_t as_of, DeviceVersion &version)
+{
+    ReadAccess access = begin_read();
+    sqlite3 *conn = access.conn;
+    sqlite3_stmt *stmt;
+    int rc = sqlite3_prepare_v2(conn, (HISTORY_SELECT + "WHERE serial_number = ? AND changed_at <= ? ORDER BY changed_at DESC, id DESC").c_str(),
+                                -1, &stmt, NULL);
+    if (rc != SQLITE_OK)
+    {
+        std::cerr << "Error preparing SQL statement: " << sqlite3_errmsg(conn) << std::endl;
+        return false;
+    }
+    sqlite3_bind_text(stmt, 1, serial_number.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_int64(stmt, 2, as_of);
+
+    version = DeviceVersion();
+    int filled = 0;
+    bool found = false;
+    while (filled != HISTORY_ALL_COLUMNS && sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        int op = sqlite3_column_int(stmt, 1);
+        if (!found)
+        {
+            if (op != HISTORY_ADD && op != HISTORY_UPDATE)
+            {
+                break;
+            }
+            version.changed_at = sqlite3_column_int64(stmt, 0);
+            version.op = HISTORY_OP_NAMES[op];
+            version.device.serial_number = column_view(stmt, 8);
+            found = true;
+        }
+        else if (op == HISTORY_DELETE)
+        {
+            break;
+        }
+        filled = apply_history_row(stmt, version.device, filled);
+    }
+    sqlite3_finalize(stmt);
+    return found && filled == HISTORY_ALL_COLUMNS;
+}
+
 // LOCATIONS TABLE OPERATIONS
 // 1. List all locations
 std::vector<Location> DBHandler::get_locations()
@@ -207,11 +755,13 @@ std::vector<Location> DBHandler::get_locations()
     std::string sql = "SELECT * FROM locations";
 
     std::vector<Location> locations;
+    ReadAccess access = begin_read();
+    sqlite3 *conn = access.conn;
     sqlite3_stmt *stmt;
-    int rc = sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, NULL);
+    int rc = sqlite3_prepare_v2(conn, sql.c_str(), -1, &stmt, NULL);
     if (rc != SQLITE_OK)
     {
-        std::cerr << "Error preparing SQL statement: " << sqlite3_errmsg(db) << std::endl;
+        std::cerr << "Error preparing SQL statement: " << sqlite3_errmsg(conn) << std::endl;
         return locations;
     }
 
@@ -246,10 +796,22 @@ bool DBHandler::add_location(const Location &location)
         return false;
     }
 
+    std::lock_guard<std::mutex> lock(write_mutex);
+    drop_warm_start_stamp();
     bind_location_data(stmt, location);
     rc = sqlite3_step(stmt);
 
     sqlite3_finalize(stmt);
+    if (rc == SQLITE_DONE)
+    {
+        // Followers get the assigned id so their locations keep the primary's ids.
+        int id = location.id == -1 ? static_cast<int>(sqlite3_last_insert_rowid(db)) : location.id;
+        if (columnar)
+        {
+            columnar->add_location({id, location.name, location.type});
+        }
+        publish({{"op", "add_location"}, {"location", {{"id", id}, {"name", location.name}, {"type", location.type}}}});
+    }
     return (rc == SQLITE_DONE);
 }
 
@@ -287,21 +849,81 @@ bool DBHandler::update_location(const int id, const std::string &name, const std
         sqlite3_bind_text(stmt, bind_index++, type.c_str(), -1, SQLITE_STATIC);
     }
     sqlite3_bind_int(stmt, bind_index++, id);
+    std::lock_guard<std::mutex> lock(write_mutex);
+    drop_warm_start_stamp();
+    if (sqlite3_exec(db, "BEGIN", NULL, NULL, NULL) != SQLITE_OK)
+    {
+        std::cerr << "Error starting transaction: " << sqlite3_errmsg(db) << std::endl;
+        sqlite3_finalize(stmt);
+        return false;
+    }
     rc = sqlite3_step(stmt);
-
     sqlite3_finalize(stmt);
-    return (rc == SQLITE_DONE);
+
+    // The devices at this location get the new name and type in the same transaction.
+    sqlite3_stmt *stmt_devices;
+    int rcDevices = sqlite3_prepare_v2(db, "UPDATE devices SET location_name = locations.name, location_type = locations.type FROM locations "
+                                           "WHERE locations.id = ?1 AND devices.location_id = ?1",
+                                       -1, &stmt_devices, NULL);
+    if (rcDevices != SQLITE_OK)
+    {
+        std::cerr << "Error preparing SQL statement for devices: " << sqlite3_errmsg(db) << std::endl;
+        sqlite3_exec(db, "ROLLBACK", NULL, NULL, NULL);
+        return false;
+    }
+    sqlite3_bind_int(stmt_devices, 1, id);
+    rcDevices = sqlite3_step(stmt_devices);
+    sqlite3_finalize(stmt_devices);
+
+    if (rc != SQLITE_DONE || rcDevices != SQLITE_DONE || sqlite3_exec(db, "COMMIT", NULL, NULL, NULL) != SQLITE_OK)
+    {
+        sqlite3_exec(db, "ROLLBACK", NULL, NULL, NULL);
+        return false;
+    }
+    if (columnar)
+    {
+        columnar->update_location(id, name, type);
+    }
+    publish({{"op", "update_location"}, {"id", id}, {"name", name}, {"type", type}});
+    return true;
 }
 
 // 4. Delete a location: All devices with this location id will be deleted as well.
 bool DBHandler::delete_location(const int id)
 {
+    std::lock_guard<std::mutex> lock(write_mutex);
+    drop_warm_start_stamp();
+    if (sqlite3_exec(db, "BEGIN", NULL, NULL, NULL) != SQLITE_OK)
+    {
+        std::cerr << "Error starting transaction: " << sqlite3_errmsg(db) << std::endl;
+        return false;
+    }
+
+    // Collect the serial numbers first so they can be dropped from serial_filter once the delete commits.
+    std::vector<std::string> serial_numbers;
+    std::string sql_serials = "SELECT serial_number FROM devices WHERE location_id = ?;";
+    sqlite3_stmt *stmt_serials;
+    int rcSerials = sqlite3_prepare_v2(db, sql_serials.c_str(), -1, &stmt_serials, NULL);
+    if (rcSerials != SQLITE_OK)
+    {
+        std::cerr << "Error preparing SQL statement for devices: " << sqlite3_errmsg(db) << std::endl;
+        sqlite3_exec(db, "ROLLBACK", NULL, NULL, NULL);
+        return false;
+    }
+    sqlite3_bind_int(stmt_serials, 1, id);
+    while (sqlite3_step(stmt_serials) == SQLITE_ROW)
+    {
+        serial_numbers.push_back(reinterpret_cast<const char *>(sqlite3_column_text(stmt_serials, 0)));
+    }
+    sqlite3_finalize(stmt_serials);
+
     std::string sql_devices = "DELETE FROM devices WHERE location_id = ?;";
     sqlite3_stmt *stmt_devices;
     int rcDevices = sqlite3_prepare_v2(db, sql_devices.c_str(), -1, &stmt_devices, NULL);
     if (rcDevices != SQLITE_OK)
     {
         std::cerr << "Error preparing SQL statement for devices: " << sqlite3_errmsg(db) << std::endl;
+        sqlite3_exec(db, "ROLLBACK", NULL, NULL, NULL);
         return false;
     }
     sqlite3_bind_int(stmt_devices, 1, id);
@@ -314,25 +936,50 @@ bool DBHandler::delete_location(const int id)
     if (rcLocation != SQLITE_OK)
     {
         std::cerr << "Error preparing SQL statement for locations: " << sqlite3_errmsg(db) << std::endl;
+        sqlite3_exec(db, "ROLLBACK", NULL, NULL, NULL);
         return false;
     }
     sqlite3_bind_int(stmt_location, 1, id);
     rcLocation = sqlite3_step(stmt_location);
     sqlite3_finalize(stmt_location);
 
-    return (rcDevices == SQLITE_DONE && rcLocation == SQLITE_DONE);
+    if (rcDevices != SQLITE_DONE || rcLocation != SQLITE_DONE || sqlite3_exec(db, "COMMIT", NULL, NULL, NULL) != SQLITE_OK)
+    {
+        sqlite3_exec(db, "ROLLBACK", NULL, NULL, NULL);
+        return false;
+    }
+
+    for (const auto &serial_number : serial_numbers)
+    {
+        serial_filter.remove(serial_number);
+    }
+    if (columnar)
+    {
+        columnar->delete_location(id);
+    }
+    publish({{"op", "delete_location"}, {"id", id}});
+    return true;
 }
 
 // HELPER METHODS
 // public methods
 bool DBHandler::serial_num_exists(std::string &serial_num)
 {
+    if (!serial_filter.might_contain(serial_num))
+    {
+        Metrics::instance().serial_filter_lookup(true);
+        return false;
+    }
+    Metrics::instance().serial_filter_lookup(false);
+
     std::string sql = "SELECT COUNT(*) FROM devices WHERE serial_number = ?";
+    ReadAccess access = begin_read();
+    sqlite3 *conn = access.conn;
     sqlite3_stmt *stmt;
-    int rc = sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, NULL);
+    int rc = sqlite3_prepare_v2(conn, sql.c_str(), -1, &stmt, NULL);
     if (rc != SQLITE_OK)
     {
-        std::cerr << "Error preparing SQL statement: " << sqlite3_errmsg(db) << std::endl;
+        std::cerr << "Error preparing SQL statement: " << sqlite3_errmsg(conn) << std::endl;
         return false;
     }
 
@@ -345,17 +992,23 @@ bool DBHandler::serial_num_exists(std::string &serial_num)
     }
 
     sqlite3_finalize(stmt);
+    if (count == 0)
+    {
+        Metrics::instance().serial_filter_false_positive();
+    }
     return (count > 0);
 }
 
 bool DBHandler::location_exists(int location_id)
 {
     std::string sql = "SELECT COUNT(*) FROM locations WHERE id = ?";
+    ReadAccess access = begin_read();
+    sqlite3 *conn = access.conn;
     sqlite3_stmt *stmt;
-    int rc = sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, NULL);
+    int rc = sqlite3_prepare_v2(conn, sql.c_str(), -1, &stmt, NULL);
     if (rc != SQLITE_OK)
     {
-        std::cerr << "Error preparing SQL statement: " << sqlite3_errmsg(db) << std::endl;
+        std::cerr << "Error preparing SQL statement: " << sqlite3_errmsg(conn) << std::endl;
         return false;
     }
 
@@ -371,7 +1024,518 @@ bool DBHandler::location_exists(int location_id)
     return (count > 0);
 }
 
+QueryProfiler &DBHandler::get_profiler()
+{
+    return profiler;
+}
+
+// The listener runs under write_mutex right after each committed mutation, so it sees mutations in commit order.
+void DBHandler::set_mutation_listener(MutationListener listener)
+{
+    std::lock_guard<std::mutex> lock(write_mutex);
+    mutation_listener = std::move(listener);
+}
+
+// Copies the registry to `path` with VACUUM INTO. at_snapshot runs before writes resume, so it can note
+// which published mutations the copy contains.
+bool DBHandler::snapshot(const std::string &path, const std::function<void()> &at_snapshot)
+{
+    sqlite3_stmt *stmt;
+    int rc = sqlite3_prepare_v2(db, "VACUUM INTO ?", -1, &stmt, NULL);
+    if (rc != SQLITE_OK)
+    {
+        std::cerr << "Error preparing SQL statement: " << sqlite3_errmsg(db) << std::endl;
+        return false;
+    }
+    sqlite3_bind_text(stmt, 1, path.c_str(), -1, SQLITE_STATIC);
+
+    std::lock_guard<std::mutex> lock(write_mutex);
+    rc = sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+    if (rc != SQLITE_DONE)
+    {
+        std::cerr << "Error writing snapshot: " << sqlite3_errmsg(db) << std::endl;
+        return false;
+    }
+    at_snapshot();
+    return true;
+}
+
+bool DBHandler::save_warm_start()
+{
+    std::lock_guard<std::mutex> lock(write_mutex);
+    if (!db)
+    {
+        return false;
+    }
+    auto start = std::chrono::steady_clock::now();
+    std::random_device random;
+    uint64_t token = 0;
+    while (token == 0)
+    {
+        token = (uint64_t(random()) << 32) | random();
+    }
+
+    std::string path = db_path + ".warm";
+    WarmStartWriter out(path, token);
+    serial_filter.save(out);
+    if (columnar)
+    {
+        columnar->save(out);
+    }
+    else
+    {
+        out.put(uint8_t(0));
+    }
+    if (!out.commit())
+    {
+        return false;
+    }
+
+    // Until the token is in the registry the file matches nothing, so a crash before this leaves it unused.
+    std::string sql = "BEGIN;UPDATE registry_meta SET value = " + std::to_string(static_cast<sqlite3_int64>(token)) +
+                      " WHERE key = 'warm_start_token';";
+    for (const auto &trigger : WARM_START_TRIGGERS)
+    {
+        sql += std::string("CREATE TRIGGER IF NOT EXISTS ") + trigger.table + "_" + trigger.event + "_unstamp AFTER " + trigger.event + " ON " +
+               trigger.table + " WHEN (SELECT value FROM registry_meta WHERE key = 'warm_start_token') != 0"
+               " BEGIN UPDATE registry_meta SET value = 0 WHERE key = 'warm_start_token'; END;";
+    }
+    sql += "COMMIT;";
+    if (sqlite3_exec(db, sql.c_str(), NULL, NULL, NULL) != SQLITE_OK)
+    {
+        std::cerr << "Error storing warm-start token: " << sqlite3_errmsg(db) << std::endl;
+        sqlite3_exec(db, "ROLLBACK", NULL, NULL, NULL);
+        return false;
+    }
+    warm_start_stamped = true;
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    std::cerr << "Saved warm-start file " << path << " in " << elapsed.count() << " ms." << std::endl;
+    return true;
+}
+
+std::vector<DBHandler *> DBHandler::registry_files()
+{
+    return {this};
+}
+
+// A passive checkpoint copies what it can without waiting for readers. A truncating one also resets the WAL file
+// to zero bytes once every frame is back in the database; the writer has no busy handler, so it does not wait
+// for readers either and reports busy instead. Without WAL there is nothing to do.
+bool DBHandler::checkpoint(bool truncate, MaintenanceResult &result)
+{
+    std::lock_guard<std::mutex> lock(write_mutex);
+    if (!db)
+    {
+        return false;
+    }
+    int log = 0;
+    int copied = 0;
+    int rc = sqlite3_wal_checkpoint_v2(db, NULL, truncate ? SQLITE_CHECKPOINT_TRUNCATE : SQLITE_CHECKPOINT_PASSIVE, &log, &copied);
+    result.busy = rc == SQLITE_BUSY;
+    if (rc != SQLITE_OK && !result.busy)
+    {
+        std::cerr << "Error checkpointing " << db_path << ": " << sqlite3_errmsg(db) << std::endl;
+        return false;
+    }
+    result.applicable = result.busy || log >= 0;
+    result.pages = std::max(log, 0);
+    result.remaining = std::max(log - copied, 0);
+    return true;
+}
+
+// The first run fills sqlite_stat1 with ANALYZE; later runs leave it to PRAGMA optimize, which re-analyzes only
+// tables whose size has changed enough to matter. analysis_limit makes ANALYZE sample each index instead of reading all of it.
+bool DBHandler::optimize(int analysis_limit)
+{
+    std::lock_guard<std::mutex> lock(write_mutex);
+    int64_t analyzed = 0;
+    if (!db || !query_int("SELECT COUNT(*) FROM sqlite_master WHERE name = 'sqlite_stat1'", analyzed))
+    {
+        return false;
+    }
+    std::string sql = "PRAGMA analysis_limit = " + std::to_string(analysis_limit) + ";" + (analyzed ? "PRAGMA optimize(0x10002);" : "ANALYZE;");
+    if (sqlite3_exec(db, sql.c_str(), NULL, NULL, NULL) != SQLITE_OK)
+    {
+        std::cerr << "Error analyzing " << db_path << ": " << sqlite3_errmsg(db) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Releases up to `pages` pages of the freelist to the file system. Needs auto_vacuum=INCREMENTAL, which a file
+// only takes at creation or with a full VACUUM.
+bool DBHandler::incremental_vacuum(int pages, MaintenanceResult &result)
+{
+    std::lock_guard<std::mutex> lock(write_mutex);
+    int64_t mode = 0;
+    int64_t free_pages = 0;
+    if (!db || !query_int("PRAGMA auto_vacuum", mode) || !query_int("PRAGMA freelist_count", free_pages))
+    {
+        return false;
+    }
+    result.applicable = mode == 2;
+    result.remaining = free_pages;
+    if (!result.applicable || free_pages == 0)
+    {
+        return true;
+    }
+    std::string sql = "PRAGMA incremental_vacuum(" + std::to_string(pages) + ")";
+    if (sqlite3_exec(db, sql.c_str(), NULL, NULL, NULL) != SQLITE_OK || !query_int("PRAGMA freelist_count", result.remaining))
+    {
+        std::cerr << "Error vacuuming " << db_path << ": " << sqlite3_errmsg(db) << std::endl;
+        return false;
+    }
+    result.pages = free_pages - result.remaining;
+    return true;
+}
+
 // private methods
+// Joins against a temp table of the requested serials. The temp table belongs to the writer connection, so lookups
+// take write_mutex like any writer: their statements must not land inside another thread's transaction or overwrite
+// the change count it is about to read.
+void DBHandler::lookup_with_temp_table(const std::vector<std::string> &serial_numbers, std::vector<Device> &devices)
+{
+    std::lock_guard<std::mutex> write_lock(write_mutex);
+    std::lock_guard<std::mutex> lookup_lock(lookup_mutex);
+    if (!fill_lookup_table(serial_numbers))
+    {
+        return;
+    }
+
+    sqlite3_stmt *stmt;
+    std::string sql = DEVICE_SELECT + "INNER JOIN temp.lookup_serials ON devices.serial_number = temp.lookup_serials.serial_number";
+    int rc = sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, NULL);
+    if (rc != SQLITE_OK)
+    {
+        std::cerr << "Error preparing SQL statement: " << sqlite3_errmsg(db) << std::endl;
+        return;
+    }
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        devices.push_back(extract_device_data(stmt));
+    }
+    sqlite3_finalize(stmt);
+    sqlite3_exec(db, "DELETE FROM temp.lookup_serials", NULL, NULL, NULL);
+}
+
+// Loads serial numbers into the lookup_serials temp table. The caller holds write_mutex and lookup_mutex.
+bool DBHandler::fill_lookup_table(const std::vector<std::string> &serial_numbers)
+{
+    if (sqlite3_exec(db, "CREATE TEMP TABLE IF NOT EXISTS lookup_serials (serial_number TEXT COLLATE nocase PRIMARY KEY) WITHOUT ROWID;"
+                         "DELETE FROM temp.lookup_serials;",
+                     NULL, NULL, NULL) != SQLITE_OK)
+    {
+        std::cerr << "Error preparing lookup table: " << sqlite3_errmsg(db) << std::endl;
+        return false;
+    }
+
+    sqlite3_stmt *stmt;
+    int rc = sqlite3_prepare_v2(db, "INSERT OR IGNORE INTO temp.lookup_serials (serial_number) VALUES (?)", -1, &stmt, NULL);
+    if (rc != SQLITE_OK)
+    {
+        std::cerr << "Error preparing SQL statement: " << sqlite3_errmsg(db) << std::endl;
+        return false;
+    }
+    for (const auto &serial_number : serial_numbers)
+    {
+        sqlite3_bind_text(stmt, 1, serial_number.c_str(), -1, SQLITE_STATIC);
+        sqlite3_step(stmt);
+        sqlite3_reset(stmt);
+    }
+    sqlite3_finalize(stmt);
+    return true;
+}
+
+// Conditions shared by filter_devices and relocate_devices. `values` receives the strings to bind, in order.
+std::string DBHandler::filter_clause(const std::string &serial_number, const std::string &type, const std::string &start_date,
+                                     const std::string &end_date, const std::string &location_name, const std::string &location_type,
+                                     const std::string &location_id, std::vector<const std::string *> &values)
+{
+    std::string sql;
+    if (!serial_number.empty())
+    {
+        sql += " AND devices.serial_number = ?";
+        values.push_back(&serial_number);
+    }
+    if (!type.empty())
+    {
+        sql += " AND devices.type = ?";
+        values.push_back(&type);
+    }
+    if (!start_date.empty())
+    {
+        sql += " AND devices.creation_date >= ?";
+        values.push_back(&start_date);
+    }
+    if (!end_date.empty())
+    {
+        sql += " AND devices.creation_date <= ?";
+        values.push_back(&end_date);
+    }
+    if (!location_name.empty())
+    {
+        sql += " AND devices.location_name = ?";
+        values.push_back(&location_name);
+    }
+    if (!location_type.empty())
+    {
+        sql += " AND devices.location_type = ?";
+        values.push_back(&location_type);
+    }
+    if (!location_id.empty())
+    {
+        sql += " AND devices.location_id = ?";
+        values.push_back(&location_id);
+    }
+    return sql;
+}
+
+void DBHandler::publish(const json &mutation)
+{
+    if (mutation_listener)
+    {
+        mutation_listener(mutation);
+    }
+}
+
+// Registries created before devices carried their location's name and type get the two columns, filled from
+// locations, and an index on location_id for the fan-out in update_location; that part runs once per file.
+// Every registry also gets registry_meta, which holds the warm-start token, device_history with its triggers, and
+// the sort indexes.
+bool DBHandler::migrate_schema()
+{
+    sqlite3_stmt *stmt;
+    int rc = sqlite3_prepare_v2(db, "SELECT COUNT(*) FROM pragma_table_info('devices') WHERE name = 'location_name'", -1, &stmt, NULL);
+    if (rc != SQLITE_OK)
+    {
+        std::cerr << "Error preparing SQL statement: " << sqlite3_errmsg(db) << std::endl;
+        return false;
+    }
+    bool migrated = sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_int(stmt, 0) > 0;
+    sqlite3_finalize(stmt);
+    if (!migrated)
+    {
+        const char *sql = "BEGIN;"
+                          "ALTER TABLE devices ADD COLUMN location_name TEXT COLLATE nocase NOT NULL DEFAULT '';"
+                          "ALTER TABLE devices ADD COLUMN location_type TEXT COLLATE nocase NOT NULL DEFAULT '';"
+                          "UPDATE devices SET location_name = locations.name, location_type = locations.type FROM locations "
+                          "WHERE devices.location_id = locations.id;"
+                          "CREATE INDEX IF NOT EXISTS devices_location_id ON devices (location_id);"
+                          "COMMIT;";
+        if (sqlite3_exec(db, sql, NULL, NULL, NULL) != SQLITE_OK)
+        {
+            std::cerr << "Error migrating devices table: " << sqlite3_errmsg(db) << std::endl;
+            sqlite3_exec(db, "ROLLBACK", NULL, NULL, NULL);
+            return false;
+        }
+        std::cerr << "Added location columns to the devices table of " << db_path << "." << std::endl;
+    }
+
+    std::string tables = "BEGIN;"
+                         "CREATE TABLE IF NOT EXISTS registry_meta (key TEXT PRIMARY KEY, value INTEGER NOT NULL);"
+                         "INSERT OR IGNORE INTO registry_meta (key, value) VALUES ('warm_start_token', 0);" +
+                         history_schema() + "COMMIT;";
+    if (sqlite3_exec(db, tables.c_str(), NULL, NULL, NULL) != SQLITE_OK)
+    {
+        std::cerr << "Error creating registry_meta and device_history: " << sqlite3_errmsg(db) << std::endl;
+        sqlite3_exec(db, "ROLLBACK", NULL, NULL, NULL);
+        return false;
+    }
+    if (sqlite3_changes(db) > 0)
+    {
+        std::cerr << "Recorded " << sqlite3_changes(db) << " existing devices in the device_history table of " << db_path << "." << std::endl;
+    }
+
+    std::string names;
+    std::string sql = "BEGIN;";
+    for (const auto &index : SORT_INDEXES)
+    {
+        names += std::string(names.empty() ? "'" : ", '") + index.name + "'";
+        sql += std::string("CREATE INDEX IF NOT EXISTS ") + index.name + " ON devices (" + index.columns + ");";
+    }
+    int64_t existing = 0;
+    if (!query_int(("SELECT COUNT(*) FROM sqlite_master WHERE type = 'index' AND name IN (" + names + ")").c_str(), existing))
+    {
+        return false;
+    }
+    if (existing < static_cast<int64_t>(std::size(SORT_INDEXES)))
+    {
+        sql += "COMMIT;";
+        if (sqlite3_exec(db, sql.c_str(), NULL, NULL, NULL) != SQLITE_OK)
+        {
+            std::cerr << "Error creating sort indexes: " << sqlite3_errmsg(db) << std::endl;
+            sqlite3_exec(db, "ROLLBACK", NULL, NULL, NULL);
+            return false;
+        }
+        std::cerr << "Added sort indexes to the devices table of " << db_path << "." << std::endl;
+    }
+    return true;
+}
+
+bool DBHandler::read_warm_start_token(uint64_t &token)
+{
+    sqlite3_stmt *stmt;
+    int rc = sqlite3_prepare_v2(db, "SELECT value FROM registry_meta WHERE key = 'warm_start_token'", -1, &stmt, NULL);
+    if (rc != SQLITE_OK)
+    {
+        std::cerr << "Error preparing SQL statement: " << sqlite3_errmsg(db) << std::endl;
+        return false;
+    }
+    bool found = sqlite3_step(stmt) == SQLITE_ROW;
+    token = found ? static_cast<uint64_t>(sqlite3_column_int64(stmt, 0)) : 0;
+    sqlite3_finalize(stmt);
+    return found;
+}
+
+// The first write after open_connection or save_warm_start takes the token out of the registry, before it commits,
+// so a warm-start file never outlives a write even if the process dies before saving a new one. The triggers
+// that do the same for other writers (the sqlite3 shell, other tools) go with it; if this fails they stay and
+// clear the token on the write instead. Callers hold write_mutex.
+void DBHandler::drop_warm_start_stamp()
+{
+    if (!warm_start_stamped)
+    {
+        return;
+    }
+    std::string sql = "BEGIN;UPDATE registry_meta SET value = 0 WHERE key = 'warm_start_token';";
+    for (const auto &trigger : WARM_START_TRIGGERS)
+    {
+        sql += std::string("DROP TRIGGER IF EXISTS ") + trigger.table + "_" + trigger.event + "_unstamp;";
+    }
+    sql += "COMMIT;";
+    if (sqlite3_exec(db, sql.c_str(), NULL, NULL, NULL) != SQLITE_OK)
+    {
+        std::cerr << "Error dropping warm-start token: " << sqlite3_errmsg(db) << std::endl;
+        sqlite3_exec(db, "ROLLBACK", NULL, NULL, NULL);
+        return;
+    }
+    warm_start_stamped = false;
+}
+
+// First column of the first row of `sql` on the writer connection.
+bool DBHandler::query_int(const char *sql, int64_t &value)
+{
+    sqlite3_stmt *stmt;
+    int rc = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
+    if (rc != SQLITE_OK)
+    {
+        std::cerr << "Error preparing SQL statement: " << sqlite3_errmsg(db) << std::endl;
+        return false;
+    }
+    bool found = sqlite3_step(stmt) == SQLITE_ROW;
+    value = found ? sqlite3_column_int64(stmt, 0) : 0;
+    sqlite3_finalize(stmt);
+    return found;
+}
+
+// Restores serial_filter and the columnar snapshot from the warm-start file if the registry still holds its token.
+// open_connection rebuilds whatever is not restored from SQLite.
+void DBHandler::load_warm_start(bool &filter_loaded, bool &columnar_loaded)
+{
+    auto start = std::chrono::steady_clock::now();
+    std::string path = db_path + ".warm";
+    WarmStartReader in(path);
+    if (!in.is_open())
+    {
+        return;
+    }
+    uint64_t token = 0;
+    if (!in.ok() || !read_warm_start_token(token) || token == 0 || in.token() != token)
+    {
+        std::cerr << "Warm-start file " << path << " is stale or damaged; rebuilding from SQLite." << std::endl;
+        return;
+    }
+    filter_loaded = serial_filter.restore(in);
+    if (!filter_loaded)
+    {
+        std::cerr << "Warm-start file " << path << " holds no usable serial filter; rebuilding from SQLite." << std::endl;
+        return;
+    }
+    columnar_loaded = columnar && columnar->restore(in);
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    std::cerr << "Restored serial filter";
+    if (columnar_loaded)
+    {
+        std::cerr << " and columnar snapshot (" << columnar->size() << " devices)";
+    }
+    std::cerr << " from " << path << " in " << elapsed.count() << " ms." << std::endl;
+}
+
+// Rebuilds the columnar snapshot from the writer connection. Callers other than open_connection must hold write_mutex.
+void DBHandler::load_columnar()
+{
+    if (columnar && columnar->load(db))
+    {
+        std::cerr << "Loaded columnar snapshot of " << db_path << ": " << columnar->size() << " devices." << std::endl;
+    }
+}
+
+// Loads every serial number into serial_filter. Callers other than open_connection must hold write_mutex.
+bool DBHandler::build_serial_filter(size_t min_capacity)
+{
+    sqlite3_stmt *stmt;
+    int rc = sqlite3_prepare_v2(db, "SELECT COUNT(*) FROM devices", -1, &stmt, NULL);
+    if (rc != SQLITE_OK)
+    {
+        std::cerr << "Error preparing SQL statement: " << sqlite3_errmsg(db) << std::endl;
+        return false;
+    }
+    size_t count = sqlite3_step(stmt) == SQLITE_ROW ? sqlite3_column_int64(stmt, 0) : 0;
+    sqlite3_finalize(stmt);
+
+    // Leave room to grow so add_device rarely has to rebuild.
+    serial_filter.reset(std::max(min_capacity, count * 2));
+    rc = sqlite3_prepare_v2(db, "SELECT serial_number FROM devices", -1, &stmt, NULL);
+    if (rc != SQLITE_OK)
+    {
+        std::cerr << "Error preparing SQL statement: " << sqlite3_errmsg(db) << std::endl;
+        return false;
+    }
+    bool complete = true;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW)
+    {
+        complete = serial_filter.add(reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0))) && complete;
+    }
+    sqlite3_finalize(stmt);
+
+    // An incomplete filter would give false negatives, so it stays in "maybe" mode instead.
+    if (rc == SQLITE_DONE && complete)
+    {
+        serial_filter.mark_ready();
+    }
+    else
+    {
+        std::cerr << "Serial number filter disabled: could not load all serial numbers" << std::endl;
+    }
+    return true;
+}
+
+DBHandler::ReadAccess DBHandler::begin_read()
+{
+    ReadAccess access{read_pool.begin(), std::unique_lock<std::mutex>(write_mutex, std::defer_lock), nullptr};
+    access.conn = access.transaction.connection();
+    if (access.conn == nullptr)
+    {
+        access.write_lock.lock();
+        access.conn = db;
+    }
+    return access;
+}
+
+int DBHandler::trace_callback(unsigned type, void *context, void *stmt, void *duration)
+{
+    if (type == SQLITE_TRACE_PROFILE)
+    {
+        uint64_t duration_ns = *static_cast<sqlite3_int64 *>(duration);
+        Metrics::instance().observe_statement(duration_ns);
+        static_cast<DBHandler *>(context)->profiler.record(static_cast<sqlite3_stmt *>(stmt), duration_ns);
+    }
+    return 0;
+}
+
 void DBHandler::bind_device_data(sqlite3_stmt *stmt, const Device &device)
 {
     sqlite3_bind_text(stmt, 1, device.serial_number.c_str(), -1, SQLITE_STATIC);
@@ -381,16 +1545,45 @@ void DBHandler::bind_device_data(sqlite3_stmt *stmt, const Device &device)
     sqlite3_bind_int(stmt, 5, device.location_id);
 }
 
+size_t DBHandler::visit_rows(sqlite3_stmt *stmt, const DeviceVisitor &visitor)
+{
+    size_t rows = 0;
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        visitor(device_row(stmt));
+        rows++;
+    }
+    return rows;
+}
+
+DeviceRow DBHandler::device_row(sqlite3_stmt *stmt)
+{
+    DeviceRow row;
+    row.serial_number = column_view(stmt, 0);
+    row.name = column_view(stmt, 1);
+    row.type = column_view(stmt, 2);
+    row.creation_date = column_view(stmt, 3);
+    row.location_id = sqlite3_column_int(stmt, 4);
+    row.location_name = column_view(stmt, 5);
+    row.location_type = column_view(stmt, 6);
+    return row;
+}
+
 Device DBHandler::extract_device_data(sqlite3_stmt *stmt)
+{
+    return device_row(stmt).to_device();
+}
+
+Device DeviceRow::to_device() const
 {
     Device device;
-    device.serial_number = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0));
-    device.name = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 1));
-    device.type = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 2));
-    device.creation_date = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 3));
-    device.location_id = sqlite3_column_int(stmt, 4);
-    device.location_name = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 5));
-    device.location_type = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 6));
+    device.serial_number = serial_number;
+    device.name = name;
+    device.type = StringPool::instance().intern(type);
+    device.creation_date = creation_date;
+    device.location_id = location_id;
+    device.location_name = StringPool::instance().intern(location_name);
+    device.location_type = StringPool::instance().intern(location_type);
     return device;
 }
 
@@ -2,17 +2,84 @@
 #include <sqlite3.h>
 #include "httplib.h"
 #include "json.hpp"
+#include "QueryProfiler.h"
+#include "ReadConnectionPool.h"
+#include "SerialFilter.h"
+#include "StringPool.h"
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string_view>
 using json = nlohmann::json;
 
+// type, location_name and location_type take few distinct values, so they share pooled storage.
 struct Device
 {
     std::string serial_number;
     std::string name;
-    std::string type;
+    InternedString type;
     std::string creation_date;
     int location_id;
-    std::string location_name;
-    std::string location_type;
+    InternedString location_name;
+    InternedString location_type;
+};
+
+// Current row of a device query as handed to a DeviceVisitor. The text fields point into SQLite's row buffer or
+// the columnar snapshot and stay valid only until the visitor returns.
+struct DeviceRow
+{
+    std::string_view serial_number;
+    std::string_view name;
+    std::string_view type;
+    std::string_view creation_date;
+    int location_id;
+    std::string_view location_name;
+    std::string_view location_type;
+
+    Device to_device() const;
+};
+
+// Runs while the query's read transaction or the snapshot's read lock is held, so it must not call back into the handler.
+using DeviceVisitor = std::function<void(const DeviceRow &)>;
+
+// Keys a device listing can be sorted by. Each has an index that yields rows in that order, ties broken by serial
+// number, so a sorted query walks the index instead of sorting.
+enum DeviceSort
+{
+    SORT_NONE, // storage order
+    SORT_SERIAL_NUMBER,
+    SORT_NAME,
+    SORT_CREATION_DATE
+};
+
+struct DeviceOrder
+{
+    DeviceSort sort = SORT_NONE;
+    bool descending = false;
+    size_t limit = 0; // 0 for every row
+};
+
+// Makes the visitor for part `part` of `parts` of a listing. Every part is made, in order, before any row is
+// visited; the parts may then be visited on threads of their own, and their rows taken in part order are the rows
+// of the listing.
+using DevicePartVisitors = std::function<DeviceVisitor(size_t part, size_t parts)>;
+
+// One entry of a device's history (see device_history in DatabaseStructure.md) with the device as the change left
+// it. Delete entries carry only the serial number.
+struct DeviceVersion
+{
+    int64_t changed_at; // milliseconds since the Unix epoch
+    std::string op;     // "add", "update" or "delete"
+    Device device;
+};
+
+// Outcome of one maintenance step on a registry file.
+struct MaintenanceResult
+{
+    bool applicable = true; // false without WAL (checkpoint) or without auto_vacuum=INCREMENTAL (vacuum)
+    bool busy = false;      // a truncating checkpoint found readers or a writer and only ran passively
+    int64_t pages = 0;      // WAL frames in the log (checkpoint) or pages freed (vacuum)
+    int64_t remaining = 0;  // WAL frames not yet copied back (checkpoint) or pages left on the freelist (vacuum)
 };
 
 struct Location
@@ -22,40 +89,123 @@ struct Location
     std::string type;
 };
 
+// Owns the SQLite connection to one registry file. Methods are virtual so ShardedDBHandler can spread the registry over several files.
+// Receives every committed mutation as a JSON record, e.g. {"op": "delete_device", "serial_number": "1a"}.
+using MutationListener = std::function<void(const json &)>;
+
+class ColumnarSnapshot;
+
 class DBHandler
 {
 public:
-    DBHandler(const std::string &db_path);
-    ~DBHandler();
-    bool open_connection();
-    void close_connection();
+    // With read_connections > 0 the registry is switched to WAL and list/filter/lookup reads use that many read-only connections.
+    // With columnar_snapshot, filter_devices is answered from an in-memory ColumnarSnapshot kept current by every write.
+    // With warm_start, open_connection restores that in-memory state from `<db_path>.warm` when no write has reached
+    // the registry since the file was saved, and close_connection saves it there.
+    DBHandler(const std::string &db_path, int read_connections = 0, bool columnar_snapshot = false, bool warm_start = false);
+    virtual ~DBHandler();
+    virtual bool open_connection();
+    virtual void close_connection();
 
     // DEVICES TABLE OPERATIONS
-    std::vector<Device> get_devices();
-    std::vector<Device> filter_devices(const std::string &serial_number, const std::string &name, const std::string &type,
-                                       const std::string &creation_date, const std::string &location_id, const std::string &start_date,
-                                       const std::string &end_date, const std::string &location_name, const std::string &location_type);
-    bool add_device(const Device &device);
-    bool update_device(const std::string &serial_number, const std::string &name, const std::string &type,
-                       const std::string &creation_date, const std::string &location_id);
-    bool delete_device(const std::string &serial_number);
+    virtual std::vector<Device> get_devices();
+    virtual std::vector<Device> filter_devices(const std::string &serial_number, const std::string &name, const std::string &type,
+                                               const std::string &creation_date, const std::string &location_id, const std::string &start_date,
+                                               const std::string &end_date, const std::string &location_name, const std::string &location_type);
+    // Same queries row by row, without building Device objects, in `order`. Return the number of rows visited.
+    virtual size_t visit_devices(const DeviceVisitor &visitor, const DeviceOrder &order = DeviceOrder());
+    virtual size_t visit_filtered_devices(const std::string &serial_number, const std::string &name, const std::string &type,
+                                          const std::string &creation_date, const std::string &location_id, const std::string &start_date,
+                                          const std::string &end_date, const std::string &location_name, const std::string &location_type,
+                                          const DeviceVisitor &visitor, const DeviceOrder &order = DeviceOrder());
+    // The same again in parts, which a sharded registry visits in parallel: one part per shard for a listing in
+    // storage order without a limit, a single part otherwise.
+    virtual size_t visit_device_parts(const DevicePartVisitors &visitors, const DeviceOrder &order = DeviceOrder());
+    virtual size_t visit_filtered_device_parts(const std::string &serial_number, const std::string &name, const std::string &type,
+                                               const std::string &creation_date, const std::string &location_id, const std::string &start_date,
+                                               const std::string &end_date, const std::string &location_name, const std::string &location_type,
+                                               const DevicePartVisitors &visitors, const DeviceOrder &order = DeviceOrder());
+    virtual bool add_device(const Device &device);
+    virtual bool update_device(const std::string &serial_number, const std::string &name, const std::string &type,
+                               const std::string &creation_date, const std::string &location_id);
+    virtual bool delete_device(const std::string &serial_number);
+    virtual std::vector<Device> lookup_devices(const std::vector<std::string> &serial_numbers);
+    virtual int relocate_devices(const std::string &serial_number, const std::string &type, const std::string &start_date,
+                                 const std::string &end_date, const std::string &location_name, const std::string &location_type,
+                                 const std::string &location_id, int target_location_id);
+    virtual int relocate_devices(const std::vector<std::string> &serial_numbers, int target_location_id);
+    // Every recorded version of a device, oldest first.
+    virtual std::vector<DeviceVersion> get_device_history(const std::string &serial_number);
+    // The version in effect at `as_of` (milliseconds since the Unix epoch); false if the device did not exist then.
+    virtual bool get_device_as_of(const std::string &serial_number, int64_t as_of, DeviceVersion &version);
 
     // LOCATIONS TABLE OPERATIONS
-    std::vector<Location> get_locations();
-    bool add_location(const Location &location);
-    bool update_location(const int id, const std::string &name, const std::string &type);
-    bool delete_location(const int id);
+    virtual std::vector<Location> get_locations();
+    virtual bool add_location(const Location &location);
+    virtual bool update_location(const int id, const std::string &name, const std::string &type);
+    virtual bool delete_location(const int id);
 
     // Helper methods
-    bool serial_num_exists(std::string &serial_num);
-    bool location_exists(int location_id);
+    virtual bool serial_num_exists(std::string &serial_num);
+    virtual bool location_exists(int location_id);
+    QueryProfiler &get_profiler();
+    virtual void set_mutation_listener(MutationListener listener);
+    virtual bool snapshot(const std::string &path, const std::function<void()> &at_snapshot);
+    // Writes the serial filter and columnar snapshot to the warm-start file, blocking writes meanwhile. The file
+    // stays valid until the next write.
+    virtual bool save_warm_start();
+
+    // Maintenance steps for MaintenanceScheduler. Each runs on this file's writer connection while writes wait.
+    virtual std::vector<DBHandler *> registry_files(); // handlers that own a registry file: this one, or every shard
+    bool checkpoint(bool truncate, MaintenanceResult &result);
+    bool optimize(int analysis_limit); // ANALYZE of at most analysis_limit rows per index, then PRAGMA optimize
+    bool incremental_vacuum(int pages, MaintenanceResult &result);
 
 private:
-    sqlite3 *db;
+    friend class ShardedDBHandler;
+
+    sqlite3 *db; // writer connection
     std::string db_path;
+    int read_connections;
+    bool warm_start;
+    bool warm_start_stamped; // the registry may hold a warm-start token, as it may at open; guarded by write_mutex
+    ReadConnectionPool read_pool;
+    QueryProfiler profiler;
+    DBHandler *trace_owner; // handler whose profiler records this handler's statements
+    MutationListener mutation_listener;
+    SerialFilter serial_filter;
+    std::unique_ptr<ColumnarSnapshot> columnar; // null unless enabled
+    std::mutex write_mutex; // orders writes, so serial_filter and the mutation listener see them in commit order
+    std::mutex lookup_mutex; // guards the lookup_serials temp table; taken after write_mutex
+
+    // The connection a read runs on: a pooled read transaction, or the writer connection under write_mutex when the
+    // pool is off, so a read never sees another thread's uncommitted transaction.
+    struct ReadAccess
+    {
+        ReadConnectionPool::Transaction transaction;
+        std::unique_lock<std::mutex> write_lock;
+        sqlite3 *conn;
+    };
 
     // Helper methods
+    static int trace_callback(unsigned type, void *context, void *stmt, void *duration);
+    ReadAccess begin_read();
+    bool migrate_schema();
+    bool build_serial_filter(size_t min_capacity);
+    void publish(const json &mutation);
+    void load_columnar();
+    bool read_warm_start_token(uint64_t &token);
+    void drop_warm_start_stamp();
+    bool query_int(const char *sql, int64_t &value);
+    void load_warm_start(bool &filter_loaded, bool &columnar_loaded);
+    void lookup_with_temp_table(const std::vector<std::string> &serial_numbers, std::vector<Device> &devices);
+    bool fill_lookup_table(const std::vector<std::string> &serial_numbers);
+    std::string filter_clause(const std::string &serial_number, const std::string &type, const std::string &start_date,
+                              const std::string &end_date, const std::string &location_name, const std::string &location_type,
+                              const std::string &location_id, std::vector<const std::string *> &values);
     void bind_device_data(sqlite3_stmt *stmt, const Device &device);
+    size_t visit_rows(sqlite3_stmt *stmt, const DeviceVisitor &visitor);
+    DeviceRow device_row(sqlite3_stmt *stmt);
     Device extract_device_data(sqlite3_stmt *stmt);
     void bind_location_data(sqlite3_stmt *stmt, const Location &location);
     Location extract_location_data(sqlite3_stmt *stmt);
@@ -1,44 +1,159 @@
 #include "DeviceHandler.h"
+#include "JsonWriter.h"
+#include "Metrics.h"
+#include "RequestArena.h"
+#include "TextKernels.h"
+#include <unordered_set>
+
+namespace
+{
+    const size_t MAX_LOOKUP_SERIALS = 100000;
+
+    // Fills the object field by field. A braced initializer builds a temporary array per field, and nlohmann
+    // allocates a heap stack to destroy each one.
+    void set_device(RequestJson &info, const Device &device)
+    {
+        info["serial_number"] = device.serial_number;
+        info["name"] = device.name;
+        info["type"] = device.type;
+        info["creation_date"] = device.creation_date;
+        info["location_id"] = device.location_id;
+        info["location_name"] = device.location_name;
+        info["location_type"] = device.location_type;
+    }
+
+    void append_device(RequestJson &devices, const Device &device)
+    {
+        set_device(devices.emplace_back(RequestJson::value_t::object), device);
+    }
+
+    // Milliseconds since the Unix epoch as UTC ISO 8601, e.g. "2024-03-01T09:30:00.250Z".
+    std::string format_timestamp(int64_t milliseconds)
+    {
+        time_t seconds = milliseconds / 1000;
+        std::tm tm;
+        gmtime_r(&seconds, &tm);
+        char buf[40];
+        size_t length = strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%S", &tm);
+        snprintf(buf + length, sizeof(buf) - length, ".%03dZ", static_cast<int>(milliseconds % 1000));
+        return buf;
+    }
+
+    void set_version(RequestJson &entry, const DeviceVersion &version)
+    {
+        entry["changed_at"] = format_timestamp(version.changed_at);
+        entry["op"] = version.op;
+        if (version.op != "delete")
+        {
+            set_device(entry["device"], version.device);
+        }
+    }
+
+    // Keys in the sorted order nlohmann writes them in, so list and filter responses keep their exact form.
+    void write_device(JsonWriter &writer, const DeviceRow &row)
+    {
+        writer.begin_object();
+        writer.key("creation_date");
+        writer.value(row.creation_date);
+        writer.key("location_id");
+        writer.value(row.location_id);
+        writer.key("location_name");
+        writer.value(row.location_name);
+        writer.key("location_type");
+        writer.value(row.location_type);
+        writer.key("name");
+        writer.value(row.name);
+        writer.key("serial_number");
+        writer.value(row.serial_number);
+        writer.key("type");
+        writer.value(row.type);
+        writer.end_object();
+    }
+
+    // Writes the rows of a listing into `body` as a JSON array. `visit` runs the listing with a DevicePartVisitors:
+    // part 0 writes straight into the body, later parts, which may run concurrently, into buffers of their own that
+    // are appended in part order.
+    template <typename Visit>
+    size_t write_devices(std::string &body, Visit visit)
+    {
+        std::vector<std::string> buffers;
+        std::vector<JsonWriter> writers;
+        body += '[';
+        size_t rows = visit([&](size_t part, size_t parts) -> DeviceVisitor
+                            {
+                                if (part == 0)
+                                {
+                                    buffers.resize(parts - 1);
+                                    writers.reserve(parts);
+                                }
+                                writers.emplace_back(part == 0 ? body : buffers[part - 1]);
+                                JsonWriter *writer = &writers.back();
+                                return [writer](const DeviceRow &row)
+                                { write_device(*writer, row); }; });
+        for (const auto &buffer : buffers)
+        {
+            if (!buffer.empty())
+            {
+                if (body.size() > 1)
+                {
+                    body += ',';
+                }
+                body += buffer;
+            }
+        }
+        body += ']';
+        return rows;
+    }
+
+    // Moves the body into the response; set_content would copy it.
+    void set_json_body(httplib::Response &res, std::string &&body)
+    {
+        res.body = std::move(body);
+        res.set_header("Content-Type", "application/json");
+    }
+}
 
 DeviceHandler::DeviceHandler(DBHandler &dbHandler) : db(dbHandler) {}
 
-void DeviceHandler::list_devices(const httplib::Request &req, httplib::Response &res)
+// Rows are written into the response body straight from the query, without Device objects or a JSON tree.
+Task<> DeviceHandler::list_devices(const httplib::Request &req, httplib::Response &res)
 {
-    json response;
-    auto devices = db.get_devices();
+    RequestJson response;
+    DeviceOrder order;
+    std::string invalid;
+    if (!parse_order(req, order, invalid))
+    {
+        res.status = 400;
+        response["status"] = "invalid";
+        response["message"] = invalid;
+        res.set_content(response.dump(), "application/json");
+        CO_RETURN;
+    }
 
-    if (devices.empty())
+    std::string body;
+    size_t rows = CO_AWAIT db_call([&]
+                                   { return write_devices(body, [&](const DevicePartVisitors &visitors)
+                                                          { return db.visit_device_parts(visitors, order); }); });
+
+    if (rows == 0)
     {
         res.status = 404;
         response["status"] = "not found";
         response["message"] = "No devices found in devices table";
         res.set_content(response.dump(), "application/json");
-        return;
+        CO_RETURN;
     }
 
     res.status = 200;
-    json response_content;
-    for (const auto &device : devices)
-    {
-        json dev_info = {
-            {"serial_number", device.serial_number},
-            {"name", device.name},
-            {"type", device.type},
-            {"creation_date", device.creation_date},
-            {"location_id", device.location_id},
-            {"location_name", device.location_name},
-            {"location_type", device.location_type}};
-        response_content.push_back(dev_info);
-    }
-    res.set_content(response_content.dump(), "application/json");
+    set_json_body(res, std::move(body));
 }
 
-void DeviceHandler::filter_devices(const httplib::Request &req, httplib::Response &res)
+Task<> DeviceHandler::filter_devices(const httplib::Request &req, httplib::Response &res)
 {
-    json response;
+    RequestJson response;
 
-    const std::set<std::string> validFilters = {"serial_number", "name", "type", "creation_date", "location_id",
-                                                "start_date", "end_date", "location_name", "location_type"};
+    static const std::set<std::string> validFilters = {"serial_number", "name", "type", "creation_date", "location_id",
+                                                       "start_date", "end_date", "location_name", "location_type"};
     bool hasValidFilter = std::any_of(validFilters.begin(), validFilters.end(),
                                       [&req](const std::string &param)
                                       { return req.has_param(param); });
@@ -48,51 +163,53 @@ void DeviceHandler::filter_devices(const httplib::Request &req, httplib::Respons
         response["status"] = "invalid";
         response["message"] = "Invalid request parameters: Only serial_number, name, type, creation_date, location_id, start_date, end_date, location_name, location_type";
         res.set_content(response.dump(), "application/json");
-        return;
+        CO_RETURN;
     }
 
-    std::string serial_number = req.get_param_value("serial_number");
-    std::string name = req.get_param_value("name");
-    std::string type = req.get_param_value("type");
-    std::string creation_date = req.get_param_value("creation_date");
-    std::string location_id_str = req.get_param_value("location_id");
-    std::string start_date = req.get_param_value("start_date");
-    std::string end_date = req.get_param_value("end_date");
-    std::string location_name = req.get_param_value("location_name");
-    std::string location_type = req.get_param_value("location_type");
+    const std::string &serial_number = request_param(req, "serial_number");
+    const std::string &name = request_param(req, "name");
+    const std::string &type = request_param(req, "type");
+    const std::string &creation_date = request_param(req, "creation_date");
+    const std::string &location_id_str = request_param(req, "location_id");
+    const std::string &start_date = request_param(req, "start_date");
+    const std::string &end_date = request_param(req, "end_date");
+    const std::string &location_name = request_param(req, "location_name");
+    const std::string &location_type = request_param(req, "location_type");
+    DeviceOrder order;
+    std::string invalid;
+    if (!parse_order(req, order, invalid))
+    {
+        res.status = 400;
+        response["status"] = "invalid";
+        response["message"] = invalid;
+        res.set_content(response.dump(), "application/json");
+        CO_RETURN;
+    }
 
-    auto filtered_devices = db.filter_devices(serial_number, name, type, creation_date, location_id_str, start_date, end_date, location_name, location_type);
+    std::string body;
+    size_t rows = CO_AWAIT db_call([&]
+                                   { return write_devices(body, [&](const DevicePartVisitors &visitors)
+                                                          { return db.visit_filtered_device_parts(serial_number, name, type, creation_date, location_id_str,
+                                                                                                  start_date, end_date, location_name, location_type,
+                                                                                                  visitors, order); }); });
 
-    if (filtered_devices.empty())
+    if (rows == 0)
     {
         res.status = 404;
         response["status"] = "not found";
         response["message"] = "No devices match filters";
-    }
-    else
-    {
-        res.status = 200;
-        for (const auto &device : filtered_devices)
-        {
-            json device_info = {
-                {"serial_number", device.serial_number},
-                {"name", device.name},
-                {"type", device.type},
-                {"creation_date", device.creation_date},
-                {"location_id", device.location_id},
-                {"location_name", device.location_name},
-                {"location_type", device.location_type}};
-            response.push_back(device_info);
-        }
+        res.set_content(response.dump(), "application/json");
+        CO_RETURN;
     }
 
-    res.set_content(response.dump(), "application/json");
+    res.status = 200;
+    set_json_body(res, std::move(body));
 }
 
-void DeviceHandler::add_device(const httplib::Request &req, httplib::Response &res)
+Task<> DeviceHandler::add_device(const httplib::Request &req, httplib::Response &res)
 {
     Device newDevice;
-    json response;
+    RequestJson response;
 
     if (!(req.has_param("serial_number") && req.has_param("name") && req.has_param("type") && req.has_param("location_id")))
     {
@@ -100,21 +217,22 @@ void DeviceHandler::add_device(const httplib::Request &req, httplib::Response &r
         response["status"] = "invalid";
         response["message"] = "Invalid request parameters: Must have at least serial_number, name, type, and location_id";
         res.set_content(response.dump(), "application/json");
-        return;
+        CO_RETURN;
     }
 
-    newDevice.name = req.get_param_value("name");
-    newDevice.type = req.get_param_value("type");
-    newDevice.serial_number = req.get_param_value("serial_number");
+    newDevice.name = request_param(req, "name");
+    newDevice.type = request_param(req, "type");
+    newDevice.serial_number = request_param(req, "serial_number");
     if (is_alphanumeric(newDevice.serial_number))
     {
-        if (db.serial_num_exists(newDevice.serial_number))
+        if (CO_AWAIT db_call([&]
+                             { return db.serial_num_exists(newDevice.serial_number); }))
         {
             res.status = 409;
             response["status"] = "conflict";
             response["message"] = "Serial Number already exists in devices table";
             res.set_content(response.dump(), "application/json");
-            return;
+            CO_RETURN;
         }
     }
     else
@@ -123,18 +241,19 @@ void DeviceHandler::add_device(const httplib::Request &req, httplib::Response &r
         response["status"] = "invalid";
         response["message"] = "Invalid serial_number";
         res.set_content(response.dump(), "application/json");
-        return;
+        CO_RETURN;
     }
     try
     {
-        newDevice.location_id = std::stoi(req.get_param_value("location_id"));
-        if (!db.location_exists(newDevice.location_id))
+        newDevice.location_id = std::stoi(request_param(req, "location_id"));
+        if (!CO_AWAIT db_call([&]
+                              { return db.location_exists(newDevice.location_id); }))
         {
             res.status = 404;
             response["status"] = "not found";
             response["message"] = "Location ID does not exist in locations table";
             res.set_content(response.dump(), "application/json");
-            return;
+            CO_RETURN;
         }
     }
     catch (...)
@@ -143,19 +262,19 @@ void DeviceHandler::add_device(const httplib::Request &req, httplib::Response &r
         response["status"] = "invalid";
         response["message"] = "Invalid location_id";
         res.set_content(response.dump(), "application/json");
-        return;
+        CO_RETURN;
     }
 
     if (req.has_param("creation_date"))
     {
-        newDevice.creation_date = req.get_param_value("creation_date");
+        newDevice.creation_date = request_param(req, "creation_date");
         if (!is_valid_date(newDevice.creation_date))
         {
             res.status = 400;
             response["status"] = "invalid";
             response["message"] = "Invalid creation_date";
             res.set_content(response.dump(), "application/json");
-            return;
+            CO_RETURN;
         }
     }
     else
@@ -163,7 +282,8 @@ void DeviceHandler::add_device(const httplib::Request &req, httplib::Response &r
         newDevice.creation_date = get_today_date();
     }
 
-    auto added = db.add_device(newDevice);
+    auto added = CO_AWAIT db_call([&]
+                                  { return db.add_device(newDevice); });
 
     if (added)
     {
@@ -172,7 +292,7 @@ void DeviceHandler::add_device(const httplib::Request &req, httplib::Response &r
         response["message"] = "New device created successfully: " +
                               newDevice.serial_number + " | " +
                               newDevice.name + " | " +
-                              newDevice.type + " | " +
+                              newDevice.type.str() + " | " +
                               newDevice.creation_date + " | " +
                               std::to_string(newDevice.location_id);
     }
@@ -186,9 +306,9 @@ void DeviceHandler::add_device(const httplib::Request &req, httplib::Response &r
     res.set_content(response.dump(), "application/json");
 }
 
-void DeviceHandler::update_device(const httplib::Request &req, httplib::Response &res)
+Task<> DeviceHandler::update_device(const httplib::Request &req, httplib::Response &res, std::string serial_number)
 {
-    json response;
+    RequestJson response;
 
     if (!(req.has_param("name") || req.has_param("type") || req.has_param("creation_date") || req.has_param("location_id")))
     {
@@ -196,39 +316,40 @@ void DeviceHandler::update_device(const httplib::Request &req, httplib::Response
         response["status"] = "invalid";
         response["message"] = "Invalid request parameters: Only name &/or type &/or creation_date &/or location_id";
         res.set_content(response.dump(), "application/json");
-        return;
+        CO_RETURN;
     }
 
-    std::string name = req.get_param_value("name");
-    std::string type = req.get_param_value("type");
-    std::string serial_number = req.matches[1];
-    if (!db.serial_num_exists(serial_number))
+    const std::string &name = request_param(req, "name");
+    const std::string &type = request_param(req, "type");
+    if (!CO_AWAIT db_call([&]
+                          { return db.serial_num_exists(serial_number); }))
     {
         res.status = 404;
         response["status"] = "not found";
         response["message"] = "Serial Number does not exist in devices table";
         res.set_content(response.dump(), "application/json");
-        return;
+        CO_RETURN;
     }
-    std::string creation_date = req.get_param_value("creation_date");
+    const std::string &creation_date = request_param(req, "creation_date");
     if (!creation_date.empty() && !is_valid_date(creation_date))
     {
         res.status = 400;
         response["status"] = "invalid";
         response["message"] = "Invalid creation_date";
         res.set_content(response.dump(), "application/json");
-        return;
+        CO_RETURN;
     }
-    std::string location_id = req.get_param_value("location_id");
+    const std::string &location_id = request_param(req, "location_id");
     try
     {
-        if (!location_id.empty() && !db.location_exists(std::stoi(location_id)))
+        if (!location_id.empty() && !CO_AWAIT db_call([&]
+                                                      { return db.location_exists(std::stoi(location_id)); }))
         {
             res.status = 404;
             response["status"] = "not found";
             response["message"] = "Location ID does not exist in locations table";
             res.set_content(response.dump(), "application/json");
-            return;
+            CO_RETURN;
         }
     }
     catch (...)
@@ -237,10 +358,11 @@ void DeviceHandler::update_device(const httplib::Request &req, httplib::Response
         response["status"] = "invalid";
         response["message"] = "Invalid location_id";
         res.set_content(response.dump(), "application/json");
-        return;
+        CO_RETURN;
     }
 
-    auto updated = db.update_device(serial_number, name, type, creation_date, location_id);
+    auto updated = CO_AWAIT db_call([&]
+                                    { return db.update_device(serial_number, name, type, creation_date, location_id); });
 
     if (updated)
     {
@@ -258,21 +380,22 @@ void DeviceHandler::update_device(const httplib::Request &req, httplib::Response
     res.set_content(response.dump(), "application/json");
 }
 
-void DeviceHandler::delete_device(const httplib::Request &req, httplib::Response &res)
+Task<> DeviceHandler::delete_device(const httplib::Request &req, httplib::Response &res, std::string serial_number)
 {
-    json response;
+    RequestJson response;
 
-    std::string serial_number = req.matches[1];
-    if (!db.serial_num_exists(serial_number))
+    if (!CO_AWAIT db_call([&]
+                          { return db.serial_num_exists(serial_number); }))
     {
         res.status = 404;
         response["status"] = "not found";
         response["message"] = "Serial Number does not exist in devices table";
         res.set_content(response.dump(), "application/json");
-        return;
+        CO_RETURN;
     }
 
-    auto deleted = db.delete_device(serial_number);
+    auto deleted = CO_AWAIT db_call([&]
+                                    { return db.delete_device(serial_number); });
 
     if (deleted)
     {
@@ -288,24 +411,227 @@ void DeviceHandler::delete_device(const httplib::Request &req, httplib::Response
         response["message"] = "Failed to delete device in DBHandler";
         res.set_content(response.dump(), "application/json");
     }
-};
+}
 
-void DeviceHandler::handle_requests(httplib::Server &svr)
+Task<> DeviceHandler::lookup_devices(const httplib::Request &req, httplib::Response &res)
 {
-    svr.Get("/devices", [&](const httplib::Request &req, httplib::Response &res)
-            { list_devices(req, res); });
+    RequestJson response;
 
-    svr.Get("/devices/filter", [&](const httplib::Request &req, httplib::Response &res)
-            { filter_devices(req, res); });
+    RequestJson serials = RequestJson::parse(req.body, nullptr, false);
+    bool valid = serials.is_array() && serials.size() <= MAX_LOOKUP_SERIALS &&
+                 std::all_of(serials.begin(), serials.end(), [](const RequestJson &serial)
+                             { return serial.is_string(); });
+    if (!valid)
+    {
+        res.status = 400;
+        response["status"] = "invalid";
+        response["message"] = "Invalid request body: Must be a JSON array of at most " + std::to_string(MAX_LOOKUP_SERIALS) + " serial numbers";
+        res.set_content(response.dump(), "application/json");
+        CO_RETURN;
+    }
 
-    svr.Post("/devices", [&](const httplib::Request &req, httplib::Response &res)
-             { add_device(req, res); });
+    // Serial numbers are case-insensitive, so duplicates are dropped ignoring ASCII case.
+    std::pmr::vector<const std::string *> requested(RequestArena::resource());
+    std::vector<std::string> lookup;
+    std::pmr::unordered_set<std::string, TextKernels::NocaseHash, TextKernels::NocaseEqual> seen(RequestArena::resource());
+    for (const auto &serial : serials)
+    {
+        const std::string &serial_number = serial.get_ref<const std::string &>();
+        if (!seen.insert(serial_number).second)
+        {
+            continue;
+        }
+        requested.push_back(&serial_number);
+        if (is_alphanumeric(serial_number))
+        {
+            lookup.push_back(serial_number);
+        }
+    }
 
-    svr.Patch(R"(/devices/([^/]+))", [&](const httplib::Request &req, httplib::Response &res)
-              { update_device(req, res); });
+    auto devices = CO_AWAIT db_call([&]
+                                    { return db.lookup_devices(lookup); });
+
+    std::pmr::unordered_set<std::string, TextKernels::NocaseHash, TextKernels::NocaseEqual> found(RequestArena::resource());
+    RequestJson found_devices = RequestJson::array();
+    for (const auto &device : devices)
+    {
+        found.insert(device.serial_number);
+        append_device(found_devices, device);
+    }
+    RequestJson missing = RequestJson::array();
+    for (const std::string *serial_number : requested)
+    {
+        if (found.count(*serial_number) == 0)
+        {
+            missing.push_back(*serial_number);
+        }
+    }
 
-    svr.Delete(R"(/devices/([^/]+))", [&](const httplib::Request &req, httplib::Response &res)
-               { delete_device(req, res); });
+    res.status = 200;
+    response["found"] = std::move(found_devices);
+    response["missing"] = std::move(missing);
+    res.set_content(response.dump(), "application/json");
+}
+
+Task<> DeviceHandler::relocate_devices(const httplib::Request &req, httplib::Response &res)
+{
+    RequestJson response;
+
+    // name and creation_date are not applied by the device filter, so they are rejected rather than silently widening the move.
+    static const std::set<std::string> validFilters = {"serial_number", "type", "location_id", "start_date", "end_date", "location_name", "location_type"};
+    bool hasFilter = std::any_of(validFilters.begin(), validFilters.end(),
+                                 [&req](const std::string &param)
+                                 { return req.has_param(param); });
+    RequestJson serials = RequestJson::parse(req.body, nullptr, false);
+    bool hasSerials = serials.is_array();
+    bool valid = req.has_param("to_location_id") && !req.has_param("name") && !req.has_param("creation_date") && hasFilter != hasSerials &&
+                 (!hasSerials || (serials.size() <= MAX_LOOKUP_SERIALS &&
+                                  std::all_of(serials.begin(), serials.end(), [](const RequestJson &serial)
+                                              { return serial.is_string(); })));
+    if (!valid)
+    {
+        res.status = 400;
+        response["status"] = "invalid";
+        response["message"] = "Invalid request parameters: Must have to_location_id and either a JSON array of serial numbers or at least one of "
+                              "serial_number, type, location_id, start_date, end_date, location_name, location_type";
+        res.set_content(response.dump(), "application/json");
+        CO_RETURN;
+    }
+
+    int target_location_id;
+    try
+    {
+        target_location_id = std::stoi(request_param(req, "to_location_id"));
+    }
+    catch (...)
+    {
+        res.status = 400;
+        response["status"] = "invalid";
+        response["message"] = "Invalid to_location_id";
+        res.set_content(response.dump(), "application/json");
+        CO_RETURN;
+    }
+    if (!CO_AWAIT db_call([&]
+                          { return db.location_exists(target_location_id); }))
+    {
+        res.status = 404;
+        response["status"] = "not found";
+        response["message"] = "Location ID does not exist in locations table";
+        res.set_content(response.dump(), "application/json");
+        CO_RETURN;
+    }
+
+    int relocated;
+    if (hasSerials)
+    {
+        std::vector<std::string> serial_numbers = serials.get<std::vector<std::string>>();
+        relocated = CO_AWAIT db_call([&]
+                                     { return db.relocate_devices(serial_numbers, target_location_id); });
+    }
+    else
+    {
+        relocated = CO_AWAIT db_call([&]
+                                     { return db.relocate_devices(request_param(req, "serial_number"), request_param(req, "type"), request_param(req, "start_date"),
+                                                                  request_param(req, "end_date"), request_param(req, "location_name"),
+                                                                  request_param(req, "location_type"), request_param(req, "location_id"), target_location_id); });
+    }
+
+    if (relocated >= 0)
+    {
+        res.status = 200;
+        response["status"] = "success";
+        response["message"] = "Successfully relocated " + std::to_string(relocated) + " devices to location " + std::to_string(target_location_id);
+        response["relocated"] = relocated;
+    }
+    else
+    {
+        res.status = 500;
+        response["status"] = "error";
+        response["message"] = "Failed to relocate devices in DBHandler";
+    }
+
+    res.set_content(response.dump(), "application/json");
+}
+
+// Without as_of, every version of the device; with it, the one in effect at that time.
+Task<> DeviceHandler::device_history(const httplib::Request &req, httplib::Response &res, std::string serial_number)
+{
+    RequestJson response;
+
+    if (req.has_param("as_of"))
+    {
+        const std::string &as_of = request_param(req, "as_of");
+        int64_t as_of_ms;
+        if (!parse_timestamp(as_of, as_of_ms))
+        {
+            res.status = 400;
+            response["status"] = "invalid";
+            response["message"] = "Invalid as_of: Must be YYYY-MM-DD or YYYY-MM-DDTHH:MM:SS[.sss][Z], in UTC";
+            res.set_content(response.dump(), "application/json");
+            CO_RETURN;
+        }
+
+        DeviceVersion version;
+        if (!CO_AWAIT db_call([&]
+                              { return db.get_device_as_of(serial_number, as_of_ms, version); }))
+        {
+            res.status = 404;
+            response["status"] = "not found";
+            response["message"] = "Serial Number did not exist in devices table at " + as_of;
+            res.set_content(response.dump(), "application/json");
+            CO_RETURN;
+        }
+        res.status = 200;
+        set_version(response, version);
+        res.set_content(response.dump(), "application/json");
+        CO_RETURN;
+    }
+
+    auto versions = CO_AWAIT db_call([&]
+                                     { return db.get_device_history(serial_number); });
+    if (versions.empty())
+    {
+        res.status = 404;
+        response["status"] = "not found";
+        response["message"] = "Serial Number has no history in device_history table";
+        res.set_content(response.dump(), "application/json");
+        CO_RETURN;
+    }
+
+    response = RequestJson::array();
+    for (const auto &version : versions)
+    {
+        set_version(response.emplace_back(RequestJson::value_t::object), version);
+    }
+    res.status = 200;
+    res.set_content(response.dump(), "application/json");
+}
+
+void DeviceHandler::handle_requests(Router &router)
+{
+    router.GetAsync("/devices", [&](const httplib::Request &req, httplib::Response &res, const Router::Params &) -> Task<>
+                    { RequestArena::Scope arena; RequestTimer timer(Route::LIST_DEVICES, res); CO_AWAIT list_devices(req, res); });
+
+    router.GetAsync("/devices/filter", [&](const httplib::Request &req, httplib::Response &res, const Router::Params &) -> Task<>
+                    { RequestArena::Scope arena; RequestTimer timer(Route::FILTER_DEVICES, res); CO_AWAIT filter_devices(req, res); });
+
+    router.PostAsync("/devices/lookup", [&](const httplib::Request &req, httplib::Response &res, const Router::Params &) -> Task<>
+                     { RequestArena::Scope arena; RequestTimer timer(Route::LOOKUP_DEVICES, res); CO_AWAIT lookup_devices(req, res); });
+
+    router.PostAsync("/devices/relocate", [&](const httplib::Request &req, httplib::Response &res, const Router::Params &) -> Task<>
+                     { RequestArena::Scope arena; RequestTimer timer(Route::RELOCATE_DEVICES, res); CO_AWAIT relocate_devices(req, res); });
+
+    router.PostAsync("/devices", [&](const httplib::Request &req, httplib::Response &res, const Router::Params &) -> Task<>
+                     { RequestArena::Scope arena; RequestTimer timer(Route::ADD_DEVICE, res); CO_AWAIT add_device(req, res); });
+
+    router.PatchAsync("/devices/{serial}", [&](const httplib::Request &req, httplib::Response &res, const Router::Params &params) -> Task<>
+                      { RequestArena::Scope arena; RequestTimer timer(Route::UPDATE_DEVICE, res); CO_AWAIT update_device(req, res, std::string(params.text(0))); });
+
+    router.GetAsync("/devices/{serial}/history", [&](const httplib::Request &req, httplib::Response &res, const Router::Params &params) -> Task<>
+                    { RequestArena::Scope arena; RequestTimer timer(Route::DEVICE_HISTORY, res); CO_AWAIT device_history(req, res, std::string(params.text(0))); });
+
+    router.DeleteAsync("/devices/{serial}", [&](const httplib::Request &req, httplib::Response &res, const Router::Params &params) -> Task<>
+                       { RequestArena::Scope arena; RequestTimer timer(Route::DELETE_DEVICE, res); CO_AWAIT delete_device(req, res, std::string(params.text(0))); });
 }
 
 // Helper methods
@@ -347,14 +673,90 @@ bool DeviceHandler::is_valid_date(const std::string &dateStr)
     return true;
 }
 
-bool DeviceHandler::is_alphanumeric(const std::string &str)
+// A UTC date or date and time. A bare date stands for the end of that day, so as_of=2024-03-01 includes the
+// changes made on 1 March.
+bool DeviceHandler::parse_timestamp(const std::string &text, int64_t &milliseconds)
 {
-    for (char c : str)
+    struct std::tm tm = {0};
+    const char *rest = strptime(text.c_str(), "%Y-%m-%d", &tm);
+    if (rest == nullptr)
     {
-        if (!std::isalnum(static_cast<unsigned char>(c)))
+        return false;
+    }
+    bool date_only = *rest == '\0';
+    int millis = 0;
+    if (!date_only)
+    {
+        rest = *rest == 'T' || *rest == ' ' ? strptime(rest + 1, "%H:%M:%S", &tm) : nullptr;
+        if (rest != nullptr && *rest == '.')
+        {
+            int digits = 0;
+            for (rest++; *rest >= '0' && *rest <= '9'; rest++, digits++)
+            {
+                millis = digits < 3 ? millis * 10 + (*rest - '0') : millis;
+            }
+            for (; digits < 3; digits++)
+            {
+                millis *= 10;
+            }
+        }
+        if (rest != nullptr && *rest == 'Z')
+        {
+            rest++;
+        }
+        if (rest == nullptr || *rest != '\0')
         {
             return false;
         }
     }
+
+    // timegm normalizes out-of-range fields such as February 30th; those are rejected.
+    struct std::tm copy = tm;
+    time_t seconds = timegm(&copy);
+    if (copy.tm_mday != tm.tm_mday || copy.tm_mon != tm.tm_mon || copy.tm_year != tm.tm_year)
+    {
+        return false;
+    }
+    milliseconds = static_cast<int64_t>(seconds) * 1000 + (date_only ? 86400000 - 1 : millis);
     return true;
+}
+
+// sort= takes the keys that have a sort index (see DeviceOrder), order= is asc (default) or desc and sorts by
+// serial number when given alone, limit= caps the number of rows.
+bool DeviceHandler::parse_order(const httplib::Request &req, DeviceOrder &order, std::string &message)
+{
+    static const std::map<std::string, DeviceSort> sorts = {
+        {"serial_number", SORT_SERIAL_NUMBER}, {"name", SORT_NAME}, {"creation_date", SORT_CREATION_DATE}};
+    const std::string &sort = request_param(req, "sort");
+    const std::string &direction = request_param(req, "order");
+    const std::string &limit = request_param(req, "limit");
+
+    auto found = sorts.find(sort);
+    if (!sort.empty() && found == sorts.end())
+    {
+        message = "Invalid sort: Only serial_number, name, creation_date";
+        return false;
+    }
+    if (!direction.empty() && direction != "asc" && direction != "desc")
+    {
+        message = "Invalid order: Must be asc or desc";
+        return false;
+    }
+    bool digits = !limit.empty() && limit.size() <= 9 && std::all_of(limit.begin(), limit.end(), [](char c)
+                                                                      { return c >= '0' && c <= '9'; });
+    if (req.has_param("limit") && (!digits || std::stoul(limit) == 0))
+    {
+        message = "Invalid limit: Must be a positive integer";
+        return false;
+    }
+
+    order.sort = found != sorts.end() ? found->second : direction.empty() ? SORT_NONE : SORT_SERIAL_NUMBER;
+    order.descending = direction == "desc";
+    order.limit = digits ? std::stoul(limit) : 0;
+    return true;
+}
+
+bool DeviceHandler::is_alphanumeric(const std::string &str)
+{
+    return TextKernels::is_alphanumeric(str.data(), str.size());
 }
\ No newline at end of file
@@ -1,24 +1,30 @@
 #pragma once
 #include "DBHandler.h"
+#include "Router.h"
 
 class DeviceHandler
 {
 public:
     explicit DeviceHandler(DBHandler &dbHandler);
 
-    void handle_requests(httplib::Server &svr);
+    void handle_requests(Router &router);
 
 private:
     DBHandler &db;
 
-    void list_devices(const httplib::Request &req, httplib::Response &res);
-    void filter_devices(const httplib::Request &req, httplib::Response &res);
-    void add_device(const httplib::Request &req, httplib::Response &res);
-    void update_device(const httplib::Request &req, httplib::Response &res);
-    void delete_device(const httplib::Request &req, httplib::Response &res);
+    Task<> list_devices(const httplib::Request &req, httplib::Response &res);
+    Task<> filter_devices(const httplib::Request &req, httplib::Response &res);
+    Task<> add_device(const httplib::Request &req, httplib::Response &res);
+    Task<> update_device(const httplib::Request &req, httplib::Response &res, std::string serial_number);
+    Task<> delete_device(const httplib::Request &req, httplib::Response &res, std::string serial_number);
+    Task<> lookup_devices(const httplib::Request &req, httplib::Response &res);
+    Task<> relocate_devices(const httplib::Request &req, httplib::Response &res);
+    Task<> device_history(const httplib::Request &req, httplib::Response &res, std::string serial_number);
 
     // Helper methods
     std::string get_today_date();
     bool is_valid_date(const std::string &date);
+    bool parse_timestamp(const std::string &text, int64_t &milliseconds);
+    bool parse_order(const httplib::Request &req, DeviceOrder &order, std::string &message);
     bool is_alphanumeric(const std::string &date);
 };
\ No newline at end of file
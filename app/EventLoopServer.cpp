@@ -0,0 +1,663 @@
+#include "EventLoopServer.h"
+#include "Metrics.h"
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <set>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace
+{
+    const size_t MAX_HEAD_BYTES = 16 * 1024;    // request line and headers
+    const size_t READ_CHUNK_BYTES = 64 * 1024;
+    const size_t KEEP_BUFFER_BYTES = 64 * 1024; // larger buffers are freed once empty, so idle connections stay small
+    const int MAX_EVENTS = 256;
+
+    // Thousands of idle connections need thousands of descriptors; the soft limit is often 1024.
+    void raise_descriptor_limit()
+    {
+        rlimit limit;
+        if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max)
+        {
+            limit.rlim_cur = limit.rlim_max;
+            setrlimit(RLIMIT_NOFILE, &limit);
+        }
+    }
+
+    std::string trim(const std::string &text)
+    {
+        size_t begin = text.find_first_not_of(" \t");
+        if (begin == std::string::npos)
+        {
+            return "";
+        }
+        size_t end = text.find_last_not_of(" \t");
+        return text.substr(begin, end - begin + 1);
+    }
+}
+
+EventLoopServer::EventLoopServer(Router &router, const EventLoopSettings &settings)
+    : router(router), settings(settings), listen_fd(-1), epoll_fd(-1), wake_fd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)),
+      stopped(false), next_id(0) {}
+
+EventLoopServer::~EventLoopServer()
+{
+    stop();
+    drop_completions(); // requests that finished after the loop exited
+    close(wake_fd);
+}
+
+void EventLoopServer::set_pre_routing_handler(httplib::Server::HandlerWithResponse handler)
+{
+    pre_routing_handler = std::move(handler);
+}
+
+void EventLoopServer::set_post_routing_handler(httplib::Server::Handler handler)
+{
+    post_routing_handler = std::move(handler);
+}
+
+bool EventLoopServer::listen()
+{
+    raise_descriptor_limit();
+
+    listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    int yes = 1;
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(settings.port);
+    if (listen_fd < 0 || bind(listen_fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 || ::listen(listen_fd, SOMAXCONN) != 0)
+    {
+        std::cerr << "Error listening on port " << settings.port << ": " << std::strerror(errno) << std::endl;
+        if (listen_fd >= 0)
+        {
+            close(listen_fd);
+        }
+        return false;
+    }
+
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = listen_fd;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &event);
+    event.data.fd = wake_fd;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &event);
+
+    workers.reset(new_task_queue ? new_task_queue() : new httplib::ThreadPool(CPPHTTPLIB_THREAD_POOL_COUNT));
+
+    epoll_event events[MAX_EVENTS];
+    auto next_sweep = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+    while (!stopped)
+    {
+        int count = epoll_wait(epoll_fd, events, MAX_EVENTS, 1000);
+        for (int i = 0; i < count; i++)
+        {
+            int fd = events[i].data.fd;
+            if (fd == listen_fd)
+            {
+                accept_connections();
+                continue;
+            }
+            if (fd == wake_fd)
+            {
+                uint64_t value;
+                while (read(wake_fd, &value, sizeof(value)) > 0)
+                {
+                }
+                finish_requests();
+                continue;
+            }
+            auto it = connections.find(fd);
+            if (it == connections.end())
+            {
+                continue;
+            }
+            Connection &conn = *it->second;
+            if (events[i].events & EPOLLERR)
+            {
+                close_connection(fd);
+                continue;
+            }
+            bool open = true;
+            if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP))
+            {
+                open = read_from(conn);
+            }
+            if (open && (events[i].events & EPOLLOUT))
+            {
+                write_to(conn);
+            }
+        }
+        if (std::chrono::steady_clock::now() >= next_sweep)
+        {
+            close_idle();
+            next_sweep = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+        }
+    }
+
+    workers->shutdown(); // finishes the requests already queued; their responses are dropped
+    while (!connections.empty())
+    {
+        close_connection(connections.begin()->first);
+    }
+    drop_completions();
+    close(epoll_fd);
+    close(listen_fd);
+    return true;
+}
+
+// Safe to call from any thread, also before listen() has started.
+void EventLoopServer::stop()
+{
+    stopped = true;
+    wake();
+}
+
+// private methods
+void EventLoopServer::accept_connections()
+{
+    while (true)
+    {
+        int fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+            {
+                std::cerr << "Error accepting connection: " << std::strerror(errno) << std::endl;
+            }
+            return;
+        }
+        if (connections.size() >= static_cast<size_t>(settings.max_connections))
+        {
+            close(fd);
+            continue;
+        }
+        int yes = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+
+        // Edge-triggered: each readiness change is reported once, and the handlers read or write until EAGAIN.
+        epoll_event event{};
+        event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        event.data.fd = fd;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0)
+        {
+            close(fd);
+            continue;
+        }
+        auto conn = std::make_unique<Connection>();
+        conn->fd = fd;
+        conn->id = next_id++;
+        conn->last_active = std::chrono::steady_clock::now();
+        connections[fd] = std::move(conn);
+        Metrics::instance().event_loop_connection_opened();
+    }
+}
+
+bool EventLoopServer::read_from(Connection &conn)
+{
+    char buffer[READ_CHUNK_BYTES];
+    while (true)
+    {
+        ssize_t n = recv(conn.fd, buffer, sizeof(buffer), 0);
+        if (n > 0)
+        {
+            conn.in.append(buffer, n);
+            if (conn.in.size() > MAX_HEAD_BYTES + settings.max_body_bytes)
+            {
+                close_connection(conn.fd); // pipelining far ahead of the responses
+                return false;
+            }
+            continue;
+        }
+        if (n == 0)
+        {
+            conn.peer_closed = true;
+            break;
+        }
+        if (errno == EINTR)
+        {
+            continue;
+        }
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+        {
+            break;
+        }
+        close_connection(conn.fd);
+        return false;
+    }
+    conn.last_active = std::chrono::steady_clock::now();
+    return parse_requests(conn);
+}
+
+bool EventLoopServer::write_to(Connection &conn)
+{
+    while (conn.out_offset < conn.out.size())
+    {
+        ssize_t n = send(conn.fd, conn.out.data() + conn.out_offset, conn.out.size() - conn.out_offset, MSG_NOSIGNAL);
+        if (n > 0)
+        {
+            conn.out_offset += n;
+            continue;
+        }
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            return true; // EPOLLOUT resumes the write
+        }
+        close_connection(conn.fd);
+        return false;
+    }
+    conn.out.clear();
+    conn.out_offset = 0;
+    if (conn.out.capacity() > KEEP_BUFFER_BYTES)
+    {
+        std::string().swap(conn.out);
+    }
+    sent(conn);
+    if (conn.close_after_write)
+    {
+        close_connection(conn.fd);
+        return false;
+    }
+    return parse_requests(conn);
+}
+
+// Starts the next request once the previous response has been written, so responses leave in request order
+// and a client that stops reading stops getting work done for it.
+bool EventLoopServer::parse_requests(Connection &conn)
+{
+    while (!conn.busy && conn.out.empty())
+    {
+        if (!conn.head)
+        {
+            size_t end = conn.in.find("\r\n\r\n");
+            if (end == std::string::npos)
+            {
+                if (conn.in.size() > MAX_HEAD_BYTES)
+                {
+                    return reject(conn, 431);
+                }
+                break;
+            }
+            int status = parse_head(conn, end + 4);
+            if (status != 0)
+            {
+                return reject(conn, status);
+            }
+            conn.in.erase(0, end + 4);
+        }
+        if (conn.in.size() < conn.body_length)
+        {
+            if (!conn.continue_sent && conn.head->get_header_value("Expect") == "100-continue")
+            {
+                conn.continue_sent = true;
+                conn.out = "HTTP/1.1 100 Continue\r\n\r\n";
+                return write_to(conn);
+            }
+            break;
+        }
+        conn.head->body.assign(conn.in, 0, conn.body_length);
+        conn.in.erase(0, conn.body_length);
+        if (conn.in.empty() && conn.in.capacity() > KEEP_BUFFER_BYTES)
+        {
+            std::string().swap(conn.in);
+        }
+        conn.body_length = 0;
+        conn.continue_sent = false;
+        dispatch(conn, std::move(conn.head));
+    }
+    if (conn.peer_closed && !conn.busy && conn.out.empty())
+    {
+        close_connection(conn.fd);
+        return false;
+    }
+    return true;
+}
+
+// Parses the request line and headers the way httplib::Server does. Returns 0 or the error status to send.
+int EventLoopServer::parse_head(Connection &conn, size_t head_length)
+{
+    auto req = std::make_unique<httplib::Request>();
+    size_t line_end = conn.in.find("\r\n");
+    std::string line = conn.in.substr(0, line_end);
+    if (line.size() > CPPHTTPLIB_REQUEST_URI_MAX_LENGTH)
+    {
+        return 414;
+    }
+
+    size_t first = line.find(' ');
+    size_t second = first == std::string::npos ? std::string::npos : line.find(' ', first + 1);
+    if (second == std::string::npos || line.find(' ', second + 1) != std::string::npos)
+    {
+        return 400;
+    }
+    req->method = line.substr(0, first);
+    req->target = line.substr(first + 1, second - first - 1);
+    req->version = line.substr(second + 1);
+    static const std::set<std::string> methods{"GET", "HEAD", "POST", "PUT", "DELETE", "CONNECT", "OPTIONS", "TRACE", "PATCH"};
+    if (methods.count(req->method) == 0 || (req->version != "HTTP/1.1" && req->version != "HTTP/1.0"))
+    {
+        return 400;
+    }
+
+    size_t fragment = req->target.find('#');
+    if (fragment != std::string::npos)
+    {
+        req->target.erase(fragment);
+    }
+    size_t query = req->target.find('?');
+    req->path = httplib::detail::decode_url(req->target.substr(0, query), false);
+    if (query != std::string::npos)
+    {
+        if (req->target.find('?', query + 1) != std::string::npos)
+        {
+            return 400;
+        }
+        httplib::detail::parse_query_text(req->target.substr(query + 1), req->params);
+    }
+
+    size_t pos = line_end + 2;
+    while (pos < head_length - 2)
+    {
+        size_t end = conn.in.find("\r\n", pos);
+        size_t colon = conn.in.find(':', pos);
+        if (colon == std::string::npos || colon >= end)
+        {
+            return 400;
+        }
+        req->headers.emplace(conn.in.substr(pos, colon - pos), trim(conn.in.substr(colon + 1, end - colon - 1)));
+        pos = end + 2;
+    }
+
+    if (req->has_header("Transfer-Encoding"))
+    {
+        return 411;
+    }
+    conn.body_length = 0;
+    if (req->has_header("Content-Length"))
+    {
+        const std::string &length = req->get_header_value("Content-Length");
+        if (length.empty() || length.size() > 19 || length.find_first_not_of("0123456789") != std::string::npos)
+        {
+            return 400;
+        }
+        conn.body_length = std::stoull(length);
+        if (conn.body_length > settings.max_body_bytes)
+        {
+            return 413;
+        }
+    }
+    conn.head = std::move(req);
+    return 0;
+}
+
+void EventLoopServer::dispatch(Connection &conn, std::unique_ptr<httplib::Request> req)
+{
+    conn.busy = true;
+    const std::string &connection = req->get_header_value("Connection");
+    bool keep_alive = req->version == "HTTP/1.1" ? connection != "close" : connection == "Keep-Alive" || connection == "keep-alive";
+
+    int fd = conn.fd;
+    uint64_t id = conn.id;
+    std::shared_ptr<httplib::Request> shared(std::move(req));
+#ifdef REGISTRY_COROUTINES
+    workers->enqueue([this, fd, id, shared, keep_alive]() mutable
+                     { spawn(serve(fd, id, std::move(shared), keep_alive)); });
+#else
+    workers->enqueue([this, fd, id, shared, keep_alive]() mutable
+                     {
+                         std::string response = handle(*shared, keep_alive);
+                         complete({fd, id, std::move(response), keep_alive, nullptr}); });
+#endif
+}
+
+// A response for a request that never reaches the handlers; the connection closes after it.
+bool EventLoopServer::reject(Connection &conn, int status)
+{
+    conn.out = "HTTP/1.1 " + std::to_string(status) + " " + httplib::status_message(status) +
+               "\r\nConnection: close\r\nContent-Length: 0\r\n\r\n";
+    conn.close_after_write = true;
+    conn.head.reset();
+    conn.in.clear();
+    return write_to(conn);
+}
+
+void EventLoopServer::finish_requests()
+{
+    std::vector<Completion> done;
+    {
+        std::lock_guard<std::mutex> lock(completions_mutex);
+        done.swap(completions);
+    }
+    for (auto &completion : done)
+    {
+        auto it = connections.find(completion.fd);
+        if (it == connections.end() || it->second->id != completion.id)
+        {
+            if (completion.written)
+            {
+                completion.written(); // closed while the request was with a worker
+            }
+            continue;
+        }
+        Connection &conn = *it->second;
+        conn.busy = false;
+        conn.out = std::move(completion.response);
+        conn.close_after_write = !completion.keep_alive;
+        conn.written = std::move(completion.written);
+        conn.last_active = std::chrono::steady_clock::now();
+        write_to(conn);
+    }
+}
+
+void EventLoopServer::close_idle()
+{
+    auto cutoff = std::chrono::steady_clock::now() - std::chrono::seconds(settings.idle_timeout_s);
+    std::vector<int> idle;
+    for (const auto &entry : connections)
+    {
+        const Connection &conn = *entry.second;
+        if (!conn.busy && conn.out.empty() && conn.last_active < cutoff)
+        {
+            idle.push_back(entry.first);
+        }
+    }
+    for (int fd : idle)
+    {
+        close_connection(fd);
+    }
+}
+
+void EventLoopServer::close_connection(int fd)
+{
+    close(fd); // also removes it from the epoll set
+    auto it = connections.find(fd);
+    if (it != connections.end())
+    {
+        sent(*it->second);
+        connections.erase(it);
+    }
+    Metrics::instance().event_loop_connection_closed();
+}
+
+// Called from workers and database threads.
+void EventLoopServer::complete(Completion completion)
+{
+    {
+        std::lock_guard<std::mutex> lock(completions_mutex);
+        completions.push_back(std::move(completion));
+    }
+    wake();
+}
+
+void EventLoopServer::drop_completions()
+{
+    std::vector<Completion> dropped;
+    {
+        std::lock_guard<std::mutex> lock(completions_mutex);
+        dropped.swap(completions);
+    }
+    for (auto &completion : dropped)
+    {
+        if (completion.written)
+        {
+            completion.written();
+        }
+    }
+}
+
+void EventLoopServer::sent(Connection &conn)
+{
+    if (conn.written)
+    {
+        std::function<void()> written = std::move(conn.written);
+        conn.written = nullptr;
+        written();
+    }
+}
+
+void EventLoopServer::wake()
+{
+    uint64_t one = 1;
+    ssize_t written = write(wake_fd, &one, sizeof(one));
+    (void)written;
+}
+
+#ifdef REGISTRY_COROUTINES
+// Suspends a request until the loop has written its response, then lets it finish (and free the request) there.
+class EventLoopServer::Send
+{
+public:
+    Send(EventLoopServer &server, int fd, uint64_t id, std::string &&response, bool keep_alive)
+        : server(server), completion{fd, id, std::move(response), keep_alive, nullptr} {}
+
+    bool await_ready() const { return false; }
+
+    void await_suspend(std::coroutine_handle<> request)
+    {
+        RequestLocals::detach();
+        completion.written = [request]
+        { request.resume(); };
+        // The loop may resume and free this frame as soon as the completion is queued.
+        EventLoopServer &loop = server;
+        loop.complete(std::move(completion));
+    }
+
+    void await_resume() const {}
+
+private:
+    EventLoopServer &server;
+    Completion completion;
+};
+
+Task<> EventLoopServer::serve(int fd, uint64_t id, std::shared_ptr<httplib::Request> req, bool keep_alive)
+{
+    std::string response = co_await handle(*req, keep_alive);
+    Send send(*this, fd, id, std::move(response), keep_alive);
+    co_await send;
+}
+#endif
+
+// Starts on a worker thread: the same stages httplib::Server goes through for a routed request.
+Task<std::string> EventLoopServer::handle(httplib::Request &req, bool &keep_alive)
+{
+    httplib::Response res;
+    try
+    {
+        if (!pre_routing_handler || pre_routing_handler(req, res) == httplib::Server::HandlerResponse::Unhandled)
+        {
+            if (!req.get_header_value("Content-Type").find("application/x-www-form-urlencoded"))
+            {
+                if (req.body.size() > CPPHTTPLIB_FORM_URL_ENCODED_PAYLOAD_MAX_LENGTH)
+                {
+                    res.status = 413;
+                    CO_RETURN serialize(req, res, keep_alive);
+                }
+                httplib::detail::parse_query_text(req.body, req.params);
+            }
+            if (!CO_AWAIT router.route_async(req, res))
+            {
+                res.status = 404;
+            }
+        }
+    }
+    catch (std::exception &e)
+    {
+        res.status = 500;
+        std::string what = e.what();
+        for (size_t i = what.find_first_of("\r\n"); i != std::string::npos; i = what.find_first_of("\r\n", i))
+        {
+            what.replace(i, 1, what[i] == '\r' ? "\\r" : "\\n");
+        }
+        res.set_header("EXCEPTION_WHAT", what);
+    }
+    catch (...)
+    {
+        res.status = 500;
+        res.set_header("EXCEPTION_WHAT", "UNKNOWN");
+    }
+    if (res.status == -1)
+    {
+        res.status = 200;
+    }
+    CO_RETURN serialize(req, res, keep_alive);
+}
+
+std::string EventLoopServer::serialize(const httplib::Request &req, httplib::Response &res, bool &keep_alive) const
+{
+    if (res.get_header_value("Connection") == "close")
+    {
+        keep_alive = false;
+    }
+    if (keep_alive)
+    {
+        res.set_header("Keep-Alive", "timeout=" + std::to_string(settings.idle_timeout_s));
+    }
+    else if (!res.has_header("Connection"))
+    {
+        res.set_header("Connection", "close");
+    }
+    if (!res.has_header("Content-Type") && !res.body.empty())
+    {
+        res.set_header("Content-Type", "text/plain");
+    }
+    if (!res.has_header("Content-Length"))
+    {
+        res.set_header("Content-Length", std::to_string(res.body.size()));
+    }
+    if (post_routing_handler)
+    {
+        post_routing_handler(req, res);
+    }
+
+    std::string out = "HTTP/1.1 " + std::to_string(res.status) + " " + httplib::status_message(res.status) + "\r\n";
+    for (const auto &header : res.headers)
+    {
+        out += header.first;
+        out += ": ";
+        out += header.second;
+        out += "\r\n";
+    }
+    out += "\r\n";
+    if (req.method != "HEAD")
+    {
+        out += res.body;
+    }
+    return out;
+}
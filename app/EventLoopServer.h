@@ -0,0 +1,116 @@
+#pragma once
+#include "Router.h"
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct EventLoopSettings
+{
+    int port = 0;
+    int idle_timeout_s = 300;          // keep-alive connections without a request in flight close after this long
+    int max_connections = 100000;      // further connections are accepted and closed at once
+    size_t max_body_bytes = 64 << 20; // larger requests get 413
+};
+
+// Alternative HTTP/1.1 front end (Linux, epoll) for the routes registered on a Router. httplib holds a worker
+// thread for the whole life of a keep-alive connection; here one thread waits on every connection's non-blocking
+// socket, parses requests as bytes arrive, and hands each complete request to a worker pool. The worker runs the
+// route and the loop writes the response. An idle connection costs its socket and a small Connection struct, so
+// thousands of agents can keep connections open on a handful of threads.
+//
+// With coroutine handlers (Async.h) the worker only starts a request: it is free again once the handler awaits
+// its first database call, the handler finishes on a DbExecutor thread, and the request awaits the loop writing
+// its response. The number of requests in flight is then bounded by the admission limit, not by threads.
+//
+// Requests on one connection are answered in order, one at a time. Request bodies need a Content-Length (chunked
+// uploads get 411) and responses must carry their body in Response::body; content providers and TLS are not
+// supported.
+class EventLoopServer
+{
+public:
+    EventLoopServer(Router &router, const EventLoopSettings &settings);
+    ~EventLoopServer();
+
+    // The same hooks as httplib::Server, so that AdmissionController can be installed on either front end.
+    std::function<httplib::TaskQueue *()> new_task_queue;
+    void set_pre_routing_handler(httplib::Server::HandlerWithResponse handler);
+    void set_post_routing_handler(httplib::Server::Handler handler);
+
+    // Serves until stop(); false if the port cannot be bound.
+    bool listen();
+    void stop();
+
+private:
+    struct Connection
+    {
+        int fd;
+        uint64_t id;
+        std::string in;  // bytes received and not yet consumed by a request
+        std::string out; // response bytes not yet sent
+        size_t out_offset = 0;
+        std::unique_ptr<httplib::Request> head; // parsed request line and headers while the body arrives
+        size_t body_length = 0;
+        bool continue_sent = false;
+        bool busy = false; // a request is with the worker pool
+        bool close_after_write = false;
+        bool peer_closed = false;
+        std::chrono::steady_clock::time_point last_active;
+        std::function<void()> written; // the current response's Completion::written
+    };
+
+    // A response built by a worker, waiting for the loop to write it.
+    struct Completion
+    {
+        int fd;
+        uint64_t id;
+        std::string response;
+        bool keep_alive;
+        std::function<void()> written; // if set, runs on the loop thread once the response is sent or dropped
+    };
+
+#ifdef REGISTRY_COROUTINES
+    class Send;
+#endif
+
+    Router &router;
+    EventLoopSettings settings;
+    httplib::Server::HandlerWithResponse pre_routing_handler;
+    httplib::Server::Handler post_routing_handler;
+
+    int listen_fd;
+    int epoll_fd;
+    int wake_fd;
+    std::atomic<bool> stopped;
+    std::unique_ptr<httplib::TaskQueue> workers;
+
+    std::unordered_map<int, std::unique_ptr<Connection>> connections;
+    uint64_t next_id;
+    std::mutex completions_mutex;
+    std::vector<Completion> completions;
+
+    // The methods taking a Connection return false once they have closed it.
+    void accept_connections();
+    bool read_from(Connection &conn);
+    bool write_to(Connection &conn);
+    bool parse_requests(Connection &conn);
+    int parse_head(Connection &conn, size_t head_length);
+    void dispatch(Connection &conn, std::unique_ptr<httplib::Request> req);
+    bool reject(Connection &conn, int status);
+    void finish_requests();
+    void close_idle();
+    void close_connection(int fd);
+    void complete(Completion completion);
+    void drop_completions();
+    static void sent(Connection &conn);
+    void wake();
+
+#ifdef REGISTRY_COROUTINES
+    Task<> serve(int fd, uint64_t id, std::shared_ptr<httplib::Request> req, bool keep_alive);
+#endif
+    Task<std::string> handle(httplib::Request &req, bool &keep_alive);
+    std::string serialize(const httplib::Request &req, httplib::Response &res, bool &keep_alive) const;
+};
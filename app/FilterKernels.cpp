@@ -0,0 +1,157 @@
+#include "FilterKernels.h"
+#include "CpuFeatures.h"
+
+#ifdef REGISTRY_X86
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    void select_equal_scalar(const uint32_t *column, size_t words, const std::vector<uint32_t> &values, uint64_t *bits)
+    {
+        for (size_t w = 0; w < words; w++)
+        {
+            if (bits[w] == 0)
+            {
+                continue;
+            }
+            const uint32_t *block = column + w * 64;
+            uint64_t matches = 0;
+            for (int i = 0; i < 64; i++)
+            {
+                bool match = false;
+                for (uint32_t value : values)
+                {
+                    match |= block[i] == value;
+                }
+                matches |= static_cast<uint64_t>(match) << i;
+            }
+            bits[w] &= matches;
+        }
+    }
+
+    void select_range_scalar(const int32_t *column, size_t words, int32_t low, int32_t high, uint64_t *bits)
+    {
+        for (size_t w = 0; w < words; w++)
+        {
+            if (bits[w] == 0)
+            {
+                continue;
+            }
+            const int32_t *block = column + w * 64;
+            uint64_t matches = 0;
+            for (int i = 0; i < 64; i++)
+            {
+                matches |= static_cast<uint64_t>(block[i] >= low && block[i] <= high) << i;
+            }
+            bits[w] &= matches;
+        }
+    }
+
+#ifdef REGISTRY_X86
+    // Eight lanes per compare; movemask turns each compare into 8 bits of the 64-row word.
+    __attribute__((target("avx2"))) void select_equal_avx2(const uint32_t *column, size_t words, const std::vector<uint32_t> &values,
+                                                           uint64_t *bits)
+    {
+        for (size_t w = 0; w < words; w++)
+        {
+            if (bits[w] == 0)
+            {
+                continue;
+            }
+            const uint32_t *block = column + w * 64;
+            uint64_t matches = 0;
+            for (int g = 0; g < 8; g++)
+            {
+                __m256i lanes = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(block + g * 8));
+                __m256i hit = _mm256_setzero_si256();
+                for (uint32_t value : values)
+                {
+                    hit = _mm256_or_si256(hit, _mm256_cmpeq_epi32(lanes, _mm256_set1_epi32(static_cast<int>(value))));
+                }
+                matches |= static_cast<uint64_t>(_mm256_movemask_ps(_mm256_castsi256_ps(hit))) << (g * 8);
+            }
+            bits[w] &= matches;
+        }
+    }
+
+    __attribute__((target("avx2"))) void select_range_avx2(const int32_t *column, size_t words, int32_t low, int32_t high, uint64_t *bits)
+    {
+        __m256i lows = _mm256_set1_epi32(low);
+        __m256i highs = _mm256_set1_epi32(high);
+        for (size_t w = 0; w < words; w++)
+        {
+            if (bits[w] == 0)
+            {
+                continue;
+            }
+            const int32_t *block = column + w * 64;
+            uint64_t misses = 0;
+            for (int g = 0; g < 8; g++)
+            {
+                __m256i lanes = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(block + g * 8));
+                __m256i outside = _mm256_or_si256(_mm256_cmpgt_epi32(lows, lanes), _mm256_cmpgt_epi32(lanes, highs));
+                misses |= static_cast<uint64_t>(_mm256_movemask_ps(_mm256_castsi256_ps(outside))) << (g * 8);
+            }
+            bits[w] &= ~misses;
+        }
+    }
+#endif
+
+    struct Implementation
+    {
+        const char *name;
+        decltype(&select_equal_scalar) select_equal;
+        decltype(&select_range_scalar) select_range;
+    };
+
+    const Implementation SCALAR = {"scalar", &select_equal_scalar, &select_range_scalar};
+#ifdef REGISTRY_X86
+    const Implementation AVX2 = {"avx2", &select_equal_avx2, &select_range_avx2};
+#endif
+
+    const Implementation *detect()
+    {
+#ifdef REGISTRY_X86
+        if (cpu_has_avx2())
+        {
+            return &AVX2;
+        }
+#endif
+        return &SCALAR;
+    }
+
+    const Implementation *active = detect();
+}
+
+void FilterKernels::select_equal(const uint32_t *column, size_t words, const std::vector<uint32_t> &values, uint64_t *bits)
+{
+    active->select_equal(column, words, values, bits);
+}
+
+void FilterKernels::select_range(const int32_t *column, size_t words, int32_t low, int32_t high, uint64_t *bits)
+{
+    active->select_range(column, words, low, high, bits);
+}
+
+const char *FilterKernels::implementation()
+{
+    return active->name;
+}
+
+bool FilterKernels::set_implementation(const std::string &name)
+{
+    if (name == "scalar")
+    {
+        active = &SCALAR;
+        return true;
+    }
+#ifdef REGISTRY_X86
+    if (name == "avx2" && cpu_has_avx2())
+    {
+        active = &AVX2;
+        return true;
+    }
+#endif
+    return false;
+}
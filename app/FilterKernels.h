@@ -0,0 +1,20 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Predicate kernels over 32-bit columns that narrow a selection bitmap: bit i of bits[w] stands for row
+// 64 * w + i, and columns hold `words` * 64 values. Each kernel clears the bits of rows that fail its predicate
+// and skips blocks of 64 rows that are already empty. AVX2 versions are picked at startup when the CPU has
+// AVX2; the portable scalar versions are the fallback.
+namespace FilterKernels
+{
+    // Keeps rows whose value is one of `values`.
+    void select_equal(const uint32_t *column, size_t words, const std::vector<uint32_t> &values, uint64_t *bits);
+    // Keeps rows with low <= value <= high.
+    void select_range(const int32_t *column, size_t words, int32_t low, int32_t high, uint64_t *bits);
+
+    const char *implementation(); // "avx2" or "scalar"
+    bool set_implementation(const std::string &name); // for benchmarks; false if the CPU lacks it
+}
@@ -0,0 +1,188 @@
+#include "JsonWriter.h"
+#include <charconv>
+
+namespace
+{
+    const char REPLACEMENT[] = "\xEF\xBF\xBD";
+
+    // Length of the well-formed UTF-8 sequence starting at text[i], or 0 if it is not one.
+    size_t utf8_sequence(std::string_view text, size_t i)
+    {
+        unsigned char lead = text[i];
+        size_t length;
+        unsigned char low = 0x80, high = 0xBF; // allowed range of the second byte
+        if (lead >= 0xC2 && lead <= 0xDF)
+        {
+            length = 2;
+        }
+        else if (lead >= 0xE0 && lead <= 0xEF)
+        {
+            length = 3;
+            low = lead == 0xE0 ? 0xA0 : 0x80;  // no overlong forms
+            high = lead == 0xED ? 0x9F : 0xBF; // no surrogates
+        }
+        else if (lead >= 0xF0 && lead <= 0xF4)
+        {
+            length = 4;
+            low = lead == 0xF0 ? 0x90 : 0x80;
+            high = lead == 0xF4 ? 0x8F : 0xBF; // nothing above U+10FFFF
+        }
+        else
+        {
+            return 0;
+        }
+        if (i + length > text.size())
+        {
+            return 0;
+        }
+        unsigned char second = text[i + 1];
+        if (second < low || second > high)
+        {
+            return 0;
+        }
+        for (size_t k = 2; k < length; k++)
+        {
+            if ((static_cast<unsigned char>(text[i + k]) & 0xC0) != 0x80)
+            {
+                return 0;
+            }
+        }
+        return length;
+    }
+}
+
+JsonWriter::JsonWriter(std::string &out) : out(out), separate(false) {}
+
+void JsonWriter::begin_array()
+{
+    if (separate)
+    {
+        out += ',';
+    }
+    out += '[';
+    separate = false;
+}
+
+void JsonWriter::end_array()
+{
+    out += ']';
+    separate = true;
+}
+
+void JsonWriter::begin_object()
+{
+    if (separate)
+    {
+        out += ',';
+    }
+    out += '{';
+    separate = false;
+}
+
+void JsonWriter::end_object()
+{
+    out += '}';
+    separate = true;
+}
+
+void JsonWriter::key(std::string_view name)
+{
+    if (separate)
+    {
+        out += ',';
+    }
+    write_string(name);
+    out += ':';
+    separate = false;
+}
+
+void JsonWriter::value(std::string_view text)
+{
+    if (separate)
+    {
+        out += ',';
+    }
+    write_string(text);
+    separate = true;
+}
+
+void JsonWriter::value(int64_t number)
+{
+    if (separate)
+    {
+        out += ',';
+    }
+    char buf[24];
+    auto result = std::to_chars(buf, buf + sizeof(buf), number);
+    out.append(buf, result.ptr);
+    separate = true;
+}
+
+// private methods
+// Copies runs of bytes that need no escaping in one append.
+void JsonWriter::write_string(std::string_view text)
+{
+    static const char HEX[] = "0123456789abcdef";
+    out += '"';
+    size_t run = 0;
+    size_t i = 0;
+    while (i < text.size())
+    {
+        unsigned char c = text[i];
+        if (c >= 0x20 && c != '"' && c != '\\' && c < 0x80)
+        {
+            i++;
+            continue;
+        }
+        out.append(text.data() + run, i - run);
+        if (c >= 0x80)
+        {
+            size_t length = utf8_sequence(text, i);
+            if (length == 0)
+            {
+                out += REPLACEMENT;
+                length = 1;
+            }
+            else
+            {
+                out.append(text.data() + i, length);
+            }
+            i += length;
+        }
+        else
+        {
+            switch (c)
+            {
+            case '"':
+                out += "\\\"";
+                break;
+            case '\\':
+                out += "\\\\";
+                break;
+            case '\b':
+                out += "\\b";
+                break;
+            case '\f':
+                out += "\\f";
+                break;
+            case '\n':
+                out += "\\n";
+                break;
+            case '\r':
+                out += "\\r";
+                break;
+            case '\t':
+                out += "\\t";
+                break;
+            default:
+                out += "\\u00";
+                out += HEX[c >> 4];
+                out += HEX[c & 0xF];
+            }
+            i++;
+        }
+        run = i;
+    }
+    out.append(text.data() + run, i - run);
+    out += '"';
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Appends compact JSON text to a string as values arrive, for responses streamed from DBHandler row visitors.
+// Output matches nlohmann::json::dump() for the same document, provided object keys are written in sorted order.
+// Invalid UTF-8 in string values is replaced with U+FFFD instead of failing the response.
+class JsonWriter
+{
+public:
+    explicit JsonWriter(std::string &out);
+
+    void begin_array();
+    void end_array();
+    void begin_object();
+    void end_object();
+    void key(std::string_view name);
+    void value(std::string_view text);
+    void value(int64_t number);
+
+private:
+    std::string &out;
+    bool separate; // the next key or array element needs a comma
+
+    void write_string(std::string_view text);
+};
@@ -1,11 +1,14 @@
 #include "LocationHandler.h"
+#include "Metrics.h"
+#include "RequestArena.h"
 
 LocationHandler::LocationHandler(DBHandler &dbHandler) : db(dbHandler) {}
 
-void LocationHandler::list_locations(const httplib::Request &req, httplib::Response &res)
+Task<> LocationHandler::list_locations(const httplib::Request &req, httplib::Response &res)
 {
-    json response;
-    auto locations = db.get_locations();
+    RequestJson response;
+    auto locations = CO_AWAIT db_call([&]
+                                      { return db.get_locations(); });
 
     if (locations.empty())
     {
@@ -13,27 +16,26 @@ void LocationHandler::list_locations(const httplib::Request &req, httplib::Respo
         response["status"] = "not found";
         response["message"] = "No locations found in locations table";
         res.set_content(response.dump(), "application/json");
-        return;
+        CO_RETURN;
     }
 
     res.status = 200;
-    json response_content;
+    RequestJson response_content;
     for (const auto &location : locations)
     {
-        json loc_info = {
-            {"id", location.id},
-            {"name", location.name},
-            {"type", location.type}};
-        response_content.push_back(loc_info);
+        RequestJson &loc_info = response_content.emplace_back(RequestJson::value_t::object);
+        loc_info["id"] = location.id;
+        loc_info["name"] = location.name;
+        loc_info["type"] = location.type;
     }
 
     res.set_content(response_content.dump(), "application/json");
 }
 
-void LocationHandler::add_location(const httplib::Request &req, httplib::Response &res)
+Task<> LocationHandler::add_location(const httplib::Request &req, httplib::Response &res)
 {
     Location newLocation;
-    json response;
+    RequestJson response;
 
     if (!(req.has_param("name") && req.has_param("type")))
     {
@@ -41,24 +43,25 @@ void LocationHandler::add_location(const httplib::Request &req, httplib::Respons
         response["status"] = "invalid";
         response["message"] = "Invalid request parameters: Must have at least both name and type";
         res.set_content(response.dump(), "application/json");
-        return;
+        CO_RETURN;
     }
 
-    newLocation.name = req.get_param_value("name");
-    newLocation.type = req.get_param_value("type");
+    newLocation.name = request_param(req, "name");
+    newLocation.type = request_param(req, "type");
     newLocation.id = -1; // Default value for ID
     if (req.has_param("id"))
     {
         try
         {
-            newLocation.id = std::stoi(req.get_param_value("id"));
-            if (db.location_exists(newLocation.id))
+            newLocation.id = std::stoi(request_param(req, "id"));
+            if (CO_AWAIT db_call([&]
+                                 { return db.location_exists(newLocation.id); }))
             {
                 res.status = 409;
                 response["status"] = "conflict";
                 response["message"] = "Location ID already exists in locations table";
                 res.set_content(response.dump(), "application/json");
-                return;
+                CO_RETURN;
             }
         }
         catch (...)
@@ -67,11 +70,12 @@ void LocationHandler::add_location(const httplib::Request &req, httplib::Respons
             response["status"] = "invalid";
             response["message"] = "Invalid id";
             res.set_content(response.dump(), "application/json");
-            return;
+            CO_RETURN;
         }
     }
 
-    bool added = db.add_location(newLocation);
+    bool added = CO_AWAIT db_call([&]
+                                  { return db.add_location(newLocation); });
 
     if (added)
     {
@@ -89,9 +93,9 @@ void LocationHandler::add_location(const httplib::Request &req, httplib::Respons
     res.set_content(response.dump(), "application/json");
 }
 
-void LocationHandler::update_location(const httplib::Request &req, httplib::Response &res)
+Task<> LocationHandler::update_location(const httplib::Request &req, httplib::Response &res, int id)
 {
-    json response;
+    RequestJson response;
 
     if (!(req.has_param("name") || req.has_param("type")))
     {
@@ -99,22 +103,23 @@ void LocationHandler::update_location(const httplib::Request &req, httplib::Resp
         response["status"] = "invalid";
         response["message"] = "Invalid request parameters: Only name &/or type";
         res.set_content(response.dump(), "application/json");
-        return;
+        CO_RETURN;
     }
 
-    std::string name = req.get_param_value("name");
-    std::string type = req.get_param_value("type");
-    int id = std::stoi(req.matches[1]);
-    if (!db.location_exists(id))
+    const std::string &name = request_param(req, "name");
+    const std::string &type = request_param(req, "type");
+    if (!CO_AWAIT db_call([&]
+                          { return db.location_exists(id); }))
     {
         res.status = 404;
         response["status"] = "not found";
         response["message"] = "Location ID does not exist in locations table";
         res.set_content(response.dump(), "application/json");
-        return;
+        CO_RETURN;
     }
 
-    auto updated = db.update_location(id, name, type);
+    auto updated = CO_AWAIT db_call([&]
+                                    { return db.update_location(id, name, type); });
 
     if (updated)
     {
@@ -132,21 +137,22 @@ void LocationHandler::update_location(const httplib::Request &req, httplib::Resp
     res.set_content(response.dump(), "application/json");
 }
 
-void LocationHandler::delete_location(const httplib::Request &req, httplib::Response &res)
+Task<> LocationHandler::delete_location(const httplib::Request &req, httplib::Response &res, int id)
 {
-    json response;
+    RequestJson response;
 
-    int id = std::stoi(req.matches[1]);
-    if (!db.location_exists(id))
+    if (!CO_AWAIT db_call([&]
+                          { return db.location_exists(id); }))
     {
         res.status = 404;
         response["status"] = "not found";
         response["message"] = "Location ID does not exist in locations table";
         res.set_content(response.dump(), "application/json");
-        return;
+        CO_RETURN;
     }
 
-    auto deleted = db.delete_location(id);
+    auto deleted = CO_AWAIT db_call([&]
+                                    { return db.delete_location(id); });
 
     if (deleted)
     {
@@ -164,17 +170,17 @@ void LocationHandler::delete_location(const httplib::Request &req, httplib::Resp
     }
 }
 
-void LocationHandler::handle_requests(httplib::Server &svr)
+void LocationHandler::handle_requests(Router &router)
 {
-    svr.Get("/locations", [&](const httplib::Request &req, httplib::Response &res)
-            { list_locations(req, res); });
+    router.GetAsync("/locations", [&](const httplib::Request &req, httplib::Response &res, const Router::Params &) -> Task<>
+                    { RequestArena::Scope arena; RequestTimer timer(Route::LIST_LOCATIONS, res); CO_AWAIT list_locations(req, res); });
 
-    svr.Post("/locations", [&](const httplib::Request &req, httplib::Response &res)
-             { add_location(req, res); });
+    router.PostAsync("/locations", [&](const httplib::Request &req, httplib::Response &res, const Router::Params &) -> Task<>
+                     { RequestArena::Scope arena; RequestTimer timer(Route::ADD_LOCATION, res); CO_AWAIT add_location(req, res); });
 
-    svr.Patch(R"(/locations/(\d+))", [&](const httplib::Request &req, httplib::Response &res)
-              { update_location(req, res); });
+    router.PatchAsync("/locations/{id}", [&](const httplib::Request &req, httplib::Response &res, const Router::Params &params) -> Task<>
+                      { RequestArena::Scope arena; RequestTimer timer(Route::UPDATE_LOCATION, res); CO_AWAIT update_location(req, res, params.id(0)); });
 
-    svr.Delete(R"(/locations/(\d+))", [&](const httplib::Request &req, httplib::Response &res)
-               { delete_location(req, res); });
+    router.DeleteAsync("/locations/{id}", [&](const httplib::Request &req, httplib::Response &res, const Router::Params &params) -> Task<>
+                       { RequestArena::Scope arena; RequestTimer timer(Route::DELETE_LOCATION, res); CO_AWAIT delete_location(req, res, params.id(0)); });
 }
\ No newline at end of file
@@ -1,18 +1,19 @@
 #pragma once
 #include "DBHandler.h"
+#include "Router.h"
 
 class LocationHandler
 {
 public:
     explicit LocationHandler(DBHandler &dbHandler);
 
-    void handle_requests(httplib::Server &svr);
+    void handle_requests(Router &router);
 
 private:
     DBHandler &db;
 
-    void list_locations(const httplib::Request &req, httplib::Response &res);
-    void add_location(const httplib::Request &req, httplib::Response &res);
-    void update_location(const httplib::Request &req, httplib::Response &res);
-    void delete_location(const httplib::Request &req, httplib::Response &res);
+    Task<> list_locations(const httplib::Request &req, httplib::Response &res);
+    Task<> add_location(const httplib::Request &req, httplib::Response &res);
+    Task<> update_location(const httplib::Request &req, httplib::Response &res, int id);
+    Task<> delete_location(const httplib::Request &req, httplib::Response &res, int id);
 };
\ No newline at end of file
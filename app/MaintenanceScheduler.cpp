@@ -0,0 +1,249 @@
+#include "MaintenanceScheduler.h"
+#include <ctime>
+
+namespace
+{
+    const char *TASK_NAMES[] = {"checkpoint", "optimize", "incremental_vacuum"};
+
+    std::string format_time(int64_t milliseconds)
+    {
+        time_t seconds = milliseconds / 1000;
+        std::tm tm;
+        gmtime_r(&seconds, &tm);
+        char buf[32];
+        strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%SZ", &tm);
+        return buf;
+    }
+}
+
+MaintenanceScheduler::MaintenanceScheduler(DBHandler &dbHandler, const MaintenanceSettings &settings)
+    : db(dbHandler), settings(settings), stopping(false), window_requests_per_s(0), window_latency_ms(0), baseline_latency_ms(0),
+      backoff_s(0), backoffs(0)
+{
+    tasks[CHECKPOINT].interval_s = settings.checkpoint_interval_s;
+    tasks[OPTIMIZE].interval_s = settings.optimize_interval_s;
+    tasks[VACUUM].interval_s = settings.vacuum_interval_s;
+}
+
+MaintenanceScheduler::~MaintenanceScheduler()
+{
+    stop();
+}
+
+// Every task is due at the first quiet window after start.
+void MaintenanceScheduler::start()
+{
+    auto now = std::chrono::steady_clock::now();
+    for (auto &task : tasks)
+    {
+        task.due = now;
+    }
+    last_load = Metrics::instance().get_request_load();
+    last_sample = now;
+    resume_at = now;
+    thread = std::thread(&MaintenanceScheduler::run, this);
+}
+
+void MaintenanceScheduler::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wakeup.notify_all();
+    if (thread.joinable())
+    {
+        thread.join();
+    }
+}
+
+json MaintenanceScheduler::get_status()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto now = std::chrono::steady_clock::now();
+    json status;
+    status["enabled"] = thread.joinable();
+    status["requests_per_s"] = window_requests_per_s;
+    status["latency_ms"] = window_latency_ms;
+    status["baseline_latency_ms"] = baseline_latency_ms;
+    status["backing_off_s"] = now < resume_at ? std::chrono::duration_cast<std::chrono::seconds>(resume_at - now).count() : 0;
+    status["backoffs"] = backoffs;
+
+    for (int i = 0; i < TASK_COUNT; i++)
+    {
+        const TaskState &task = tasks[i];
+        json info = {
+            {"interval_s", task.interval_s},
+            {"runs", task.runs},
+            {"interrupted", task.interrupted},
+            {"last_run", task.runs ? json(format_time(task.last_run_ms)) : json(nullptr)},
+            {"last_duration_ms", task.last_duration_ms},
+            {"last_completed", task.last_completed},
+            {"last_failed", task.last_failed},
+            {"next_run_in_s", task.due > now ? std::chrono::duration_cast<std::chrono::seconds>(task.due - now).count() : 0}};
+        if (task.runs && i == CHECKPOINT)
+        {
+            info["wal"] = task.last_result.applicable;
+            info["wal_frames"] = task.last_result.pages;
+            info["frames_not_checkpointed"] = task.last_result.remaining;
+            info["truncate_busy"] = task.last_result.busy;
+        }
+        else if (task.runs && i == VACUUM)
+        {
+            info["incremental_auto_vacuum"] = task.last_result.applicable;
+            info["pages_freed"] = task.last_result.pages;
+            info["freelist_pages"] = task.last_result.remaining;
+        }
+        status["tasks"][TASK_NAMES[i]] = info;
+    }
+    return status;
+}
+
+// private methods
+// One task at most per tick, and only after a quiet one, so maintenance never runs back to back under load.
+void MaintenanceScheduler::run()
+{
+    while (wait(std::chrono::milliseconds(settings.tick_ms)))
+    {
+        if (!sample_load())
+        {
+            continue;
+        }
+        int due = TASK_COUNT;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto now = std::chrono::steady_clock::now();
+            for (int i = 0; i < TASK_COUNT && due == TASK_COUNT; i++)
+            {
+                due = tasks[i].due <= now ? i : TASK_COUNT;
+            }
+        }
+        if (due != TASK_COUNT)
+        {
+            run_task(static_cast<Task>(due));
+        }
+    }
+}
+
+// Sleeps unless stop() is called meanwhile; returns false when stopping.
+bool MaintenanceScheduler::wait(std::chrono::milliseconds duration)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    return !wakeup.wait_for(lock, duration, [this]
+                            { return stopping; });
+}
+
+// Measures the window since the previous sample and returns whether maintenance may run now: low request rate,
+// nothing in flight and no backoff pending. A window whose latency rises well above the baseline starts a backoff,
+// or doubles the current one.
+bool MaintenanceScheduler::sample_load()
+{
+    RequestLoad load = Metrics::instance().get_request_load();
+    auto now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(mutex);
+    double seconds = std::chrono::duration<double>(now - last_sample).count();
+    uint64_t requests = load.requests - last_load.requests;
+    window_requests_per_s = seconds > 0 ? requests / seconds : 0;
+    window_latency_ms = requests ? (load.latency_ns - last_load.latency_ns) / 1e6 / requests : 0;
+    last_load = load;
+    last_sample = now;
+    if (requests == 0)
+    {
+        return now >= resume_at && load.in_flight == 0;
+    }
+
+    bool rising = baseline_latency_ms > 0 && window_latency_ms > baseline_latency_ms * settings.latency_rise;
+    baseline_latency_ms = baseline_latency_ms > 0 ? baseline_latency_ms * 0.9 + window_latency_ms * 0.1 : window_latency_ms;
+    if (rising)
+    {
+        backoff_s = std::min(std::max(backoff_s * 2, 1), settings.max_backoff_s);
+        resume_at = now + std::chrono::seconds(backoff_s);
+        backoffs++;
+        return false;
+    }
+    return now >= resume_at && window_requests_per_s <= settings.idle_requests_per_s && load.in_flight == 0;
+}
+
+// Works through the registry files step by step, re-checking the load before every step after the first. An
+// interrupted task stays due and continues at the next quiet window; vacuum keeps the pages it already freed.
+void MaintenanceScheduler::run_task(Task task)
+{
+    int64_t started_at = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    std::chrono::steady_clock::duration working{0}; // time spent in steps, excluding the gaps between them
+    MaintenanceResult total;
+    total.applicable = false;
+    bool failed = false;
+    bool interrupted = false;
+    bool first = true;
+    for (DBHandler *file : db.registry_files())
+    {
+        MaintenanceResult result;
+        result.applicable = false;
+        bool more = true;
+        for (int index = 0; more && !failed && !interrupted; index++)
+        {
+            if (!first && !(wait(std::chrono::milliseconds(settings.step_gap_ms)) && sample_load()))
+            {
+                interrupted = true;
+                break;
+            }
+            first = false;
+            auto step_start = std::chrono::steady_clock::now();
+            more = step(task, *file, index, result, failed);
+            working += std::chrono::steady_clock::now() - step_start;
+        }
+        total.applicable = total.applicable || result.applicable;
+        total.busy = total.busy || result.busy;
+        total.pages += result.pages;
+        total.remaining += result.remaining;
+        if (failed || interrupted)
+        {
+            break;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    TaskState &state = tasks[task];
+    state.runs++;
+    state.interrupted += interrupted;
+    state.last_run_ms = started_at;
+    state.last_duration_ms = std::chrono::duration<double, std::milli>(working).count();
+    state.last_completed = !failed && !interrupted;
+    state.last_failed = failed;
+    state.last_result = total;
+    if (!interrupted)
+    {
+        state.due = std::chrono::steady_clock::now() + std::chrono::seconds(state.interval_s);
+        backoff_s = 0;
+    }
+}
+
+// Runs step `index` of `task` on one registry file and folds its outcome into `result`. Returns whether the file
+// needs another step; `failed` is set when SQLite reported an error.
+bool MaintenanceScheduler::step(Task task, DBHandler &file, int index, MaintenanceResult &result, bool &failed)
+{
+    MaintenanceResult current;
+    switch (task)
+    {
+    case CHECKPOINT:
+        // A passive pass first. Only when it emptied a large WAL does a truncating pass give the file's space back.
+        failed = !file.checkpoint(index > 0, current);
+        if (index == 0)
+        {
+            result = current;
+            return !failed && current.applicable && current.remaining == 0 && current.pages >= settings.truncate_wal_frames;
+        }
+        result.busy = current.busy;
+        result.remaining = current.remaining;
+        return false;
+    case OPTIMIZE:
+        failed = !file.optimize(settings.analysis_limit);
+        return false;
+    default:
+        failed = !file.incremental_vacuum(settings.vacuum_step_pages, current);
+        result.applicable = current.applicable;
+        result.pages += current.pages;
+        result.remaining = current.remaining;
+        return !failed && current.pages > 0 && current.remaining > 0;
+    }
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include "DBHandler.h"
+#include "Metrics.h"
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+struct MaintenanceSettings
+{
+    int tick_ms = 1000;             // how often request load is sampled and due tasks considered
+    double idle_requests_per_s = 20; // a tick at or below this request rate counts as a low-traffic window
+    double latency_rise = 2.0;       // a window whose average latency exceeds the baseline by this factor backs off
+    int max_backoff_s = 300;         // backoff doubles per latency rise up to this
+    int step_gap_ms = 20;            // pause between steps, so requests waiting on the writer get in
+    int checkpoint_interval_s = 30;
+    int truncate_wal_frames = 4096;  // a checkpointed WAL of at least this many frames is truncated to zero bytes
+    int optimize_interval_s = 3600;
+    int analysis_limit = 1000;
+    int vacuum_interval_s = 300;
+    int vacuum_step_pages = 256;
+};
+
+// Runs SQLite maintenance from a background thread when the server is quiet: WAL checkpoints, ANALYZE / PRAGMA
+// optimize and incremental vacuum. Each task works in small steps, one registry file (or one batch of freelist
+// pages) at a time, and checks the request load between steps; it stops early and backs off when traffic or
+// request latency rises. Tasks that never find a quiet window are not forced: SQLite's own autocheckpoint
+// still keeps the WAL bounded meanwhile.
+class MaintenanceScheduler
+{
+public:
+    MaintenanceScheduler(DBHandler &dbHandler, const MaintenanceSettings &settings);
+    ~MaintenanceScheduler();
+
+    void start();
+    void stop();
+
+    // Last run, duration and outcome of every task, and the current load and backoff, for GET /admin/maintenance.
+    json get_status();
+
+private:
+    enum Task
+    {
+        CHECKPOINT,
+        OPTIMIZE,
+        VACUUM,
+        TASK_COUNT
+    };
+
+    struct TaskState
+    {
+        int interval_s = 0;
+        std::chrono::steady_clock::time_point due;
+        int64_t last_run_ms = 0; // wall clock, milliseconds since the Unix epoch; 0 before the first run
+        double last_duration_ms = 0;
+        bool last_completed = false;
+        bool last_failed = false;
+        uint64_t runs = 0;
+        uint64_t interrupted = 0;
+        MaintenanceResult last_result;
+    };
+
+    DBHandler &db;
+    MaintenanceSettings settings;
+    std::thread thread;
+    std::mutex mutex; // guards everything below
+    std::condition_variable wakeup;
+    bool stopping;
+    TaskState tasks[TASK_COUNT];
+    RequestLoad last_load;
+    std::chrono::steady_clock::time_point last_sample;
+    double window_requests_per_s;
+    double window_latency_ms;
+    double baseline_latency_ms; // slow moving average of the window latency, so a lasting change becomes the new normal
+    int backoff_s;
+    std::chrono::steady_clock::time_point resume_at;
+    uint64_t backoffs;
+
+    void run();
+    bool wait(std::chrono::milliseconds duration);
+    bool sample_load();
+    void run_task(Task task);
+    bool step(Task task, DBHandler &file, int index, MaintenanceResult &result, bool &failed);
+};
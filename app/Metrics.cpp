@@ -0,0 +1,378 @@
+#include "Metrics.h"
+#include "httplib.h"
+
+namespace
+{
+    const uint64_t BUCKET_BOUNDS_NS[Histogram::BUCKET_COUNT] = {
+        50000, 100000, 250000, 500000,
+        1000000, 2500000, 5000000, 10000000, 25000000, 50000000, 100000000, 250000000, 500000000,
+        1000000000, 2500000000ULL, 5000000000ULL, 10000000000ULL};
+
+    const int STATUS_CODES[] = {200, 400, 404, 409, 500, 503};
+
+    const char *ROUTE_METHODS[ROUTE_COUNT] = {"GET", "GET", "POST", "PATCH", "DELETE", "POST", "POST", "GET", "GET", "POST", "PATCH", "DELETE"};
+    const char *ROUTE_PATHS[ROUTE_COUNT] = {"/devices", "/devices/filter", "/devices", "/devices/{serial_number}",
+                                            "/devices/{serial_number}", "/devices/lookup",
+                                            "/devices/relocate", "/devices/{serial_number}/history", "/locations", "/locations",
+                                            "/locations/{id}", "/locations/{id}"};
+
+    void append_double(std::string &out, double value)
+    {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%.9g", value);
+        out += buf;
+    }
+}
+
+// Histogram
+Histogram::Histogram() : count(0), sum_ns(0)
+{
+    for (auto &bucket : buckets)
+    {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+}
+
+void Histogram::observe(uint64_t duration_ns)
+{
+    int i = 0;
+    while (i < BUCKET_COUNT && duration_ns > BUCKET_BOUNDS_NS[i])
+    {
+        i++;
+    }
+    buckets[i].fetch_add(1, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+    sum_ns.fetch_add(duration_ns, std::memory_order_relaxed);
+}
+
+void Histogram::render(std::string &out, const std::string &name, const std::string &labels) const
+{
+    std::string prefix = labels.empty() ? "" : labels + ",";
+    uint64_t cumulative = 0;
+    for (int i = 0; i <= BUCKET_COUNT; i++)
+    {
+        cumulative += buckets[i].load(std::memory_order_relaxed);
+        out += name + "_bucket{" + prefix + "le=\"";
+        if (i < BUCKET_COUNT)
+        {
+            append_double(out, BUCKET_BOUNDS_NS[i] / 1e9);
+        }
+        else
+        {
+            out += "+Inf";
+        }
+        out += "\"} " + std::to_string(cumulative) + "\n";
+    }
+    std::string braced = labels.empty() ? "" : "{" + labels + "}";
+    out += name + "_sum" + braced + " ";
+    append_double(out, sum_ns.load(std::memory_order_relaxed) / 1e9);
+    out += "\n";
+    out += name + "_count" + braced + " " + std::to_string(count.load(std::memory_order_relaxed)) + "\n";
+}
+
+uint64_t Histogram::get_count() const
+{
+    return count.load(std::memory_order_relaxed);
+}
+
+uint64_t Histogram::get_sum_ns() const
+{
+    return sum_ns.load(std::memory_order_relaxed);
+}
+
+// Metrics
+Metrics::RouteStats::RouteStats()
+{
+    for (auto &status : statuses)
+    {
+        status.store(0, std::memory_order_relaxed);
+    }
+}
+
+Metrics &Metrics::instance()
+{
+    static Metrics metrics;
+    return metrics;
+}
+
+void Metrics::request_started()
+{
+    in_flight.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Metrics::request_finished(Route route, int status, uint64_t duration_ns)
+{
+    in_flight.fetch_sub(1, std::memory_order_relaxed);
+    RouteStats &stats = routes[route];
+    stats.requests.fetch_add(1, std::memory_order_relaxed);
+    stats.statuses[status_slot(status)].fetch_add(1, std::memory_order_relaxed);
+    stats.latency.observe(duration_ns);
+}
+
+void Metrics::observe_statement(uint64_t duration_ns)
+{
+    statements.observe(duration_ns);
+}
+
+RequestLoad Metrics::get_request_load() const
+{
+    RequestLoad load;
+    for (const auto &stats : routes)
+    {
+        load.requests += stats.latency.get_count();
+        load.latency_ns += stats.latency.get_sum_ns();
+    }
+    load.in_flight = in_flight.load(std::memory_order_relaxed);
+    return load;
+}
+
+void Metrics::serial_filter_changed(int64_t items_delta, int64_t memory_bytes_delta)
+{
+    filter_items.fetch_add(items_delta, std::memory_order_relaxed);
+    filter_memory_bytes.fetch_add(memory_bytes_delta, std::memory_order_relaxed);
+}
+
+void Metrics::serial_filter_lookup(bool definite_miss)
+{
+    (definite_miss ? filter_definite_misses : filter_maybes).fetch_add(1, std::memory_order_relaxed);
+}
+
+void Metrics::serial_filter_false_positive()
+{
+    filter_false_positives.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Metrics::string_pool_grew(size_t bytes)
+{
+    string_pool_values.fetch_add(1, std::memory_order_relaxed);
+    string_pool_bytes.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void Metrics::request_arena_reset(size_t bytes, size_t upstream_allocations)
+{
+    arena_requests.fetch_add(1, std::memory_order_relaxed);
+    arena_bytes.fetch_add(bytes, std::memory_order_relaxed);
+    arena_upstream_allocations.fetch_add(upstream_allocations, std::memory_order_relaxed);
+}
+
+void Metrics::observe_queue_wait(uint64_t duration_ns)
+{
+    queue_wait.observe(duration_ns);
+}
+
+void Metrics::admission_rejected(const std::string &priority)
+{
+    auto &counter = priority == "mutation" ? rejected_mutations : priority == "read" ? rejected_reads : rejected_full_reads;
+    counter.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Metrics::set_admission_limit(int limit)
+{
+    admission_limit.store(limit, std::memory_order_relaxed);
+}
+
+void Metrics::event_loop_connection_opened()
+{
+    event_loop_accepted.fetch_add(1, std::memory_order_relaxed);
+    event_loop_connections.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Metrics::event_loop_connection_closed()
+{
+    event_loop_connections.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void Metrics::replication_published(uint64_t seq)
+{
+    replication_published_seq.store(seq, std::memory_order_relaxed);
+}
+
+void Metrics::replication_stream_opened()
+{
+    replication_streams.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Metrics::replication_stream_closed()
+{
+    replication_streams.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void Metrics::replication_applied(uint64_t applied_seq, uint64_t primary_seq, double lag_seconds)
+{
+    replication_applied_seq.store(applied_seq, std::memory_order_relaxed);
+    replication_primary_seq.store(primary_seq, std::memory_order_relaxed);
+    replication_lag_ms.store(static_cast<int64_t>(lag_seconds * 1e3), std::memory_order_relaxed);
+}
+
+void Metrics::set_replication_connected(bool connected)
+{
+    replication_connected.store(connected, std::memory_order_relaxed);
+}
+
+void Metrics::set_replication_stopped()
+{
+    replication_stopped.store(true, std::memory_order_relaxed);
+}
+
+int Metrics::status_slot(int status)
+{
+    for (int i = 0; i < STATUS_SLOTS - 1; i++)
+    {
+        if (STATUS_CODES[i] == status)
+        {
+            return i;
+        }
+    }
+    return STATUS_SLOTS - 1;
+}
+
+std::string Metrics::render() const
+{
+    std::string out;
+
+    out += "# HELP registry_http_requests_total Requests handled per route.\n";
+    out += "# TYPE registry_http_requests_total counter\n";
+    for (int r = 0; r < ROUTE_COUNT; r++)
+    {
+        out += "registry_http_requests_total{method=\"" + std::string(ROUTE_METHODS[r]) + "\",path=\"" + ROUTE_PATHS[r] + "\"} " +
+               std::to_string(routes[r].requests.load(std::memory_order_relaxed)) + "\n";
+    }
+
+    out += "# HELP registry_http_responses_total Responses per route and status code.\n";
+    out += "# TYPE registry_http_responses_total counter\n";
+    for (int r = 0; r < ROUTE_COUNT; r++)
+    {
+        for (int s = 0; s < STATUS_SLOTS; s++)
+        {
+            uint64_t value = routes[r].statuses[s].load(std::memory_order_relaxed);
+            if (value == 0)
+            {
+                continue;
+            }
+            std::string code = s < STATUS_SLOTS - 1 ? std::to_string(STATUS_CODES[s]) : "other";
+            out += "registry_http_responses_total{method=\"" + std::string(ROUTE_METHODS[r]) + "\",path=\"" + ROUTE_PATHS[r] +
+                   "\",code=\"" + code + "\"} " + std::to_string(value) + "\n";
+        }
+    }
+
+    out += "# HELP registry_http_request_duration_seconds Request latency per route.\n";
+    out += "# TYPE registry_http_request_duration_seconds histogram\n";
+    for (int r = 0; r < ROUTE_COUNT; r++)
+    {
+        routes[r].latency.render(out, "registry_http_request_duration_seconds",
+                                 "method=\"" + std::string(ROUTE_METHODS[r]) + "\",path=\"" + ROUTE_PATHS[r] + "\"");
+    }
+
+    out += "# HELP registry_http_requests_in_flight Requests currently being handled.\n";
+    out += "# TYPE registry_http_requests_in_flight gauge\n";
+    out += "registry_http_requests_in_flight " + std::to_string(in_flight.load(std::memory_order_relaxed)) + "\n";
+
+    out += "# HELP registry_sqlite_statement_duration_seconds Execution time of SQLite statements.\n";
+    out += "# TYPE registry_sqlite_statement_duration_seconds histogram\n";
+    statements.render(out, "registry_sqlite_statement_duration_seconds", "");
+
+    uint64_t definite_misses = filter_definite_misses.load(std::memory_order_relaxed);
+    uint64_t false_positives = filter_false_positives.load(std::memory_order_relaxed);
+    int64_t items = filter_items.load(std::memory_order_relaxed);
+    int64_t memory_bytes = filter_memory_bytes.load(std::memory_order_relaxed);
+    out += "# HELP registry_serial_filter_lookups_total Serial number existence checks answered by the filter.\n";
+    out += "# TYPE registry_serial_filter_lookups_total counter\n";
+    out += "registry_serial_filter_lookups_total{result=\"definite_miss\"} " + std::to_string(definite_misses) + "\n";
+    out += "registry_serial_filter_lookups_total{result=\"maybe\"} " + std::to_string(filter_maybes.load(std::memory_order_relaxed)) + "\n";
+    out += "# HELP registry_serial_filter_false_positives_total Filter hits that SQLite did not find.\n";
+    out += "# TYPE registry_serial_filter_false_positives_total counter\n";
+    out += "registry_serial_filter_false_positives_total " + std::to_string(false_positives) + "\n";
+    out += "# HELP registry_serial_filter_false_positive_rate Observed share of absent serials the filter could not rule out.\n";
+    out += "# TYPE registry_serial_filter_false_positive_rate gauge\n";
+    out += "registry_serial_filter_false_positive_rate ";
+    append_double(out, definite_misses + false_positives ? static_cast<double>(false_positives) / (definite_misses + false_positives) : 0.0);
+    out += "\n";
+    out += "# HELP registry_serial_filter_expected_false_positive_rate False-positive rate predicted from the filter load.\n";
+    out += "# TYPE registry_serial_filter_expected_false_positive_rate gauge\n";
+    out += "registry_serial_filter_expected_false_positive_rate ";
+    append_double(out, memory_bytes > 0 ? 8.0 * items / (memory_bytes / 2) / 65535.0 : 0.0);
+    out += "\n";
+    out += "# HELP registry_serial_filter_items Serial numbers held by the filter.\n";
+    out += "# TYPE registry_serial_filter_items gauge\n";
+    out += "registry_serial_filter_items " + std::to_string(items) + "\n";
+    out += "# HELP registry_serial_filter_memory_bytes Memory used by the filter.\n";
+    out += "# TYPE registry_serial_filter_memory_bytes gauge\n";
+    out += "registry_serial_filter_memory_bytes " + std::to_string(memory_bytes) + "\n";
+
+    out += "# HELP registry_string_pool_values Distinct device attribute values held by the string pool.\n";
+    out += "# TYPE registry_string_pool_values gauge\n";
+    out += "registry_string_pool_values " + std::to_string(string_pool_values.load(std::memory_order_relaxed)) + "\n";
+    out += "# HELP registry_string_pool_memory_bytes Approximate memory used by the pooled strings.\n";
+    out += "# TYPE registry_string_pool_memory_bytes gauge\n";
+    out += "registry_string_pool_memory_bytes " + std::to_string(string_pool_bytes.load(std::memory_order_relaxed)) + "\n";
+
+    out += "# HELP registry_request_arena_requests_total Requests handled with a per-thread request arena.\n";
+    out += "# TYPE registry_request_arena_requests_total counter\n";
+    out += "registry_request_arena_requests_total " + std::to_string(arena_requests.load(std::memory_order_relaxed)) + "\n";
+    out += "# HELP registry_request_arena_bytes_total Bytes allocated from request arenas instead of the heap.\n";
+    out += "# TYPE registry_request_arena_bytes_total counter\n";
+    out += "registry_request_arena_bytes_total " + std::to_string(arena_bytes.load(std::memory_order_relaxed)) + "\n";
+    out += "# HELP registry_request_arena_upstream_allocations_total Heap allocations made by request arenas that outgrew their buffer.\n";
+    out += "# TYPE registry_request_arena_upstream_allocations_total counter\n";
+    out += "registry_request_arena_upstream_allocations_total " + std::to_string(arena_upstream_allocations.load(std::memory_order_relaxed)) + "\n";
+
+    out += "# HELP registry_http_queue_wait_seconds Time accepted connections wait for a worker thread.\n";
+    out += "# TYPE registry_http_queue_wait_seconds histogram\n";
+    queue_wait.render(out, "registry_http_queue_wait_seconds", "");
+    out += "# HELP registry_admission_rejected_total Requests shed with 503 by priority class.\n";
+    out += "# TYPE registry_admission_rejected_total counter\n";
+    out += "registry_admission_rejected_total{priority=\"full_read\"} " + std::to_string(rejected_full_reads.load(std::memory_order_relaxed)) + "\n";
+    out += "registry_admission_rejected_total{priority=\"read\"} " + std::to_string(rejected_reads.load(std::memory_order_relaxed)) + "\n";
+    out += "registry_admission_rejected_total{priority=\"mutation\"} " + std::to_string(rejected_mutations.load(std::memory_order_relaxed)) + "\n";
+    out += "# HELP registry_admission_limit Current admission limit on admitted plus queued requests.\n";
+    out += "# TYPE registry_admission_limit gauge\n";
+    out += "registry_admission_limit " + std::to_string(admission_limit.load(std::memory_order_relaxed)) + "\n";
+
+    out += "# HELP registry_event_loop_connections_total Connections accepted by the event-loop front end.\n";
+    out += "# TYPE registry_event_loop_connections_total counter\n";
+    out += "registry_event_loop_connections_total " + std::to_string(event_loop_accepted.load(std::memory_order_relaxed)) + "\n";
+    out += "# HELP registry_event_loop_connections Connections currently open on the event-loop front end, idle ones included.\n";
+    out += "# TYPE registry_event_loop_connections gauge\n";
+    out += "registry_event_loop_connections " + std::to_string(event_loop_connections.load(std::memory_order_relaxed)) + "\n";
+
+    uint64_t applied_seq = replication_applied_seq.load(std::memory_order_relaxed);
+    uint64_t primary_seq = replication_primary_seq.load(std::memory_order_relaxed);
+    out += "# HELP registry_replication_published_seq Sequence number of the last mutation published to followers.\n";
+    out += "# TYPE registry_replication_published_seq gauge\n";
+    out += "registry_replication_published_seq " + std::to_string(replication_published_seq.load(std::memory_order_relaxed)) + "\n";
+    out += "# HELP registry_replication_streams Followers currently streaming from this primary.\n";
+    out += "# TYPE registry_replication_streams gauge\n";
+    out += "registry_replication_streams " + std::to_string(replication_streams.load(std::memory_order_relaxed)) + "\n";
+    out += "# HELP registry_replication_applied_seq Sequence number of the last mutation this follower applied.\n";
+    out += "# TYPE registry_replication_applied_seq gauge\n";
+    out += "registry_replication_applied_seq " + std::to_string(applied_seq) + "\n";
+    out += "# HELP registry_replication_lag_mutations Mutations the primary has published that this follower has not applied.\n";
+    out += "# TYPE registry_replication_lag_mutations gauge\n";
+    out += "registry_replication_lag_mutations " + std::to_string(primary_seq > applied_seq ? primary_seq - applied_seq : 0) + "\n";
+    out += "# HELP registry_replication_lag_seconds Age of the newest applied mutation while behind the primary, 0 when caught up.\n";
+    out += "# TYPE registry_replication_lag_seconds gauge\n";
+    out += "registry_replication_lag_seconds ";
+    append_double(out, replication_lag_ms.load(std::memory_order_relaxed) / 1e3);
+    out += "\n";
+    out += "# HELP registry_replication_connected Whether this follower has an open stream to the primary.\n";
+    out += "# TYPE registry_replication_connected gauge\n";
+    out += "registry_replication_connected " + std::to_string(replication_connected.load(std::memory_order_relaxed) ? 1 : 0) + "\n";
+    out += "# HELP registry_replication_stopped Whether this follower stopped applying mutations and needs a restart to load a new snapshot.\n";
+    out += "# TYPE registry_replication_stopped gauge\n";
+    out += "registry_replication_stopped " + std::to_string(replication_stopped.load(std::memory_order_relaxed) ? 1 : 0) + "\n";
+
+    return out;
+}
+
+// RequestTimer
+RequestTimer::RequestTimer(Route route, const httplib::Response &res)
+    : route(route), res(res), start(std::chrono::steady_clock::now())
+{
+    Metrics::instance().request_started();
+}
+
+RequestTimer::~RequestTimer()
+{
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+    Metrics::instance().request_finished(route, res.status, elapsed.count());
+}
@@ -0,0 +1,159 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace httplib
+{
+    struct Response;
+}
+
+// Instrumented routes. Keep ROUTE_COUNT last.
+enum Route
+{
+    LIST_DEVICES,
+    FILTER_DEVICES,
+    ADD_DEVICE,
+    UPDATE_DEVICE,
+    DELETE_DEVICE,
+    LOOKUP_DEVICES,
+    RELOCATE_DEVICES,
+    DEVICE_HISTORY,
+    LIST_LOCATIONS,
+    ADD_LOCATION,
+    UPDATE_LOCATION,
+    DELETE_LOCATION,
+    ROUTE_COUNT
+};
+
+// Latency histogram with fixed buckets. Recording only touches relaxed atomics.
+class Histogram
+{
+public:
+    static const int BUCKET_COUNT = 17;
+
+    Histogram();
+    void observe(uint64_t duration_ns);
+    void render(std::string &out, const std::string &name, const std::string &labels) const;
+    uint64_t get_count() const;
+    uint64_t get_sum_ns() const;
+
+private:
+    std::atomic<uint64_t> buckets[BUCKET_COUNT + 1]; // last bucket is +Inf
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> sum_ns;
+};
+
+// Totals over every instrumented route since start; differences between two samples give a window's rate and latency.
+struct RequestLoad
+{
+    uint64_t requests = 0;
+    uint64_t latency_ns = 0;
+    int64_t in_flight = 0;
+};
+
+// Process-wide metrics registry, exported in Prometheus text format by AdminHandler.
+class Metrics
+{
+public:
+    static Metrics &instance();
+
+    void request_started();
+    void request_finished(Route route, int status, uint64_t duration_ns);
+    void observe_statement(uint64_t duration_ns);
+    RequestLoad get_request_load() const;
+
+    // SerialFilter
+    void serial_filter_changed(int64_t items_delta, int64_t memory_bytes_delta);
+    void serial_filter_lookup(bool definite_miss);
+    void serial_filter_false_positive();
+
+    // StringPool
+    void string_pool_grew(size_t bytes);
+
+    // RequestArena
+    void request_arena_reset(size_t bytes, size_t upstream_allocations);
+
+    // AdmissionController
+    void observe_queue_wait(uint64_t duration_ns);
+    void admission_rejected(const std::string &priority);
+    void set_admission_limit(int limit);
+
+    // EventLoopServer
+    void event_loop_connection_opened();
+    void event_loop_connection_closed();
+
+    // Replication
+    void replication_published(uint64_t seq);
+    void replication_stream_opened();
+    void replication_stream_closed();
+    void replication_applied(uint64_t applied_seq, uint64_t primary_seq, double lag_seconds);
+    void set_replication_connected(bool connected);
+    void set_replication_stopped();
+
+    std::string render() const;
+
+private:
+    static const int STATUS_SLOTS = 7;
+
+    // Each route's counters fill four whole cache lines (256 bytes, padding included), so concurrent requests on
+    // different routes never write to the same line. Requests on one route still share its lines.
+    struct alignas(64) RouteStats
+    {
+        std::atomic<uint64_t> requests{0};
+        std::atomic<uint64_t> statuses[STATUS_SLOTS];
+        Histogram latency;
+        RouteStats();
+    };
+
+    Metrics() = default;
+    static int status_slot(int status);
+
+    RouteStats routes[ROUTE_COUNT];
+    alignas(64) std::atomic<int64_t> in_flight{0};
+    alignas(64) Histogram statements;
+
+    alignas(64) std::atomic<uint64_t> filter_definite_misses{0};
+    std::atomic<uint64_t> filter_maybes{0};
+    std::atomic<uint64_t> filter_false_positives{0};
+    std::atomic<int64_t> filter_items{0};
+    std::atomic<int64_t> filter_memory_bytes{0};
+
+    std::atomic<uint64_t> string_pool_values{0};
+    std::atomic<uint64_t> string_pool_bytes{0};
+
+    alignas(64) std::atomic<uint64_t> arena_requests{0};
+    std::atomic<uint64_t> arena_bytes{0};
+    std::atomic<uint64_t> arena_upstream_allocations{0};
+
+    alignas(64) Histogram queue_wait;
+    std::atomic<uint64_t> rejected_full_reads{0};
+    std::atomic<uint64_t> rejected_reads{0};
+    std::atomic<uint64_t> rejected_mutations{0};
+    std::atomic<int> admission_limit{0};
+
+    alignas(64) std::atomic<uint64_t> event_loop_accepted{0};
+    std::atomic<int64_t> event_loop_connections{0};
+
+    alignas(64) std::atomic<uint64_t> replication_published_seq{0};
+    std::atomic<int> replication_streams{0};
+    std::atomic<uint64_t> replication_applied_seq{0};
+    std::atomic<uint64_t> replication_primary_seq{0};
+    std::atomic<int64_t> replication_lag_ms{0};
+    std::atomic<bool> replication_connected{false};
+    std::atomic<bool> replication_stopped{false};
+};
+
+// Records one request against a route: in-flight gauge on construction, latency and status on destruction.
+class RequestTimer
+{
+public:
+    RequestTimer(Route route, const httplib::Response &res);
+    ~RequestTimer();
+
+private:
+    Route route;
+    const httplib::Response &res;
+    std::chrono::steady_clock::time_point start;
+};
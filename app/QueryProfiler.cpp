@@ -0,0 +1,161 @@
+#include "QueryProfiler.h"
+#include <algorithm>
+#include <functional>
+#include <iostream>
+
+QueryProfiler::QueryProfiler(const std::string &db_path) : db_path(db_path), threshold_ns(100000000), explain_db(nullptr) {}
+
+QueryProfiler::~QueryProfiler()
+{
+    if (explain_db)
+    {
+        sqlite3_close(explain_db);
+    }
+}
+
+void QueryProfiler::set_threshold_ms(double threshold_ms)
+{
+    threshold_ns.store(static_cast<uint64_t>(threshold_ms * 1e6), std::memory_order_relaxed);
+}
+
+double QueryProfiler::get_threshold_ms() const
+{
+    return threshold_ns.load(std::memory_order_relaxed) / 1e6;
+}
+
+// Called from the profile trace callback, while the statement is still valid.
+void QueryProfiler::record(sqlite3_stmt *stmt, uint64_t duration_ns)
+{
+    const char *sql_text = sqlite3_sql(stmt);
+    if (sql_text == nullptr)
+    {
+        return;
+    }
+    std::string sql(sql_text);
+    int fullscan_steps = sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_FULLSCAN_STEP, 1);
+    int sorts = sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_SORT, 1);
+    int autoindexes = sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_AUTOINDEX, 1);
+    int vm_steps = sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_VM_STEP, 1);
+    bool slow = duration_ns >= threshold_ns.load(std::memory_order_relaxed);
+
+    Shard &shard = shards[std::hash<std::string>()(sql) % SHARD_COUNT];
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.statements.find(sql);
+        if (it == shard.statements.end())
+        {
+            if (shard.statements.size() >= MAX_STATEMENTS_PER_SHARD)
+            {
+                it = shard.statements.emplace("<other>", StatementStats()).first;
+                it->second.sql = "<other>";
+            }
+            else
+            {
+                it = shard.statements.emplace(sql, StatementStats()).first;
+                it->second.sql = sql;
+            }
+        }
+        StatementStats &stats = it->second;
+        stats.calls++;
+        stats.slow_calls += slow ? 1 : 0;
+        stats.total_ns += duration_ns;
+        stats.max_ns = std::max(stats.max_ns, duration_ns);
+        stats.fullscan_steps += fullscan_steps;
+        stats.sorts += sorts;
+        stats.autoindexes += autoindexes;
+        stats.vm_steps += vm_steps;
+    }
+
+    if (!slow)
+    {
+        return;
+    }
+
+    SlowQuery query;
+    char *expanded = sqlite3_expanded_sql(stmt);
+    query.sql = expanded ? expanded : sql;
+    sqlite3_free(expanded);
+    query.duration_ns = duration_ns;
+    query.fullscan_steps = fullscan_steps;
+    query.sorts = sorts;
+    query.autoindexes = autoindexes;
+    query.vm_steps = vm_steps;
+
+    std::lock_guard<std::mutex> lock(slow_mutex);
+    query.plan = explain_query_plan(sql);
+
+    std::cerr << "Slow query (" << duration_ns / 1e6 << " ms, fullscan_steps=" << fullscan_steps << ", sorts=" << sorts
+              << ", autoindexes=" << autoindexes << ", vm_steps=" << vm_steps << "): " << query.sql << std::endl;
+    for (const auto &line : query.plan)
+    {
+        std::cerr << "    " << line << std::endl;
+    }
+
+    slow_queries.push_back(query);
+    if (slow_queries.size() > MAX_SLOW_QUERIES)
+    {
+        slow_queries.pop_front();
+    }
+}
+
+std::vector<StatementStats> QueryProfiler::get_statement_stats()
+{
+    std::vector<StatementStats> result;
+    for (auto &shard : shards)
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        for (const auto &entry : shard.statements)
+        {
+            result.push_back(entry.second);
+        }
+    }
+    std::sort(result.begin(), result.end(), [](const StatementStats &a, const StatementStats &b)
+              { return a.total_ns > b.total_ns; });
+    return result;
+}
+
+std::vector<SlowQuery> QueryProfiler::get_slow_queries()
+{
+    std::lock_guard<std::mutex> lock(slow_mutex);
+    return std::vector<SlowQuery>(slow_queries.rbegin(), slow_queries.rend());
+}
+
+// Must be called with slow_mutex held.
+std::vector<std::string> QueryProfiler::explain_query_plan(const std::string &sql)
+{
+    std::vector<std::string> plan;
+    if (!explain_db)
+    {
+        if (sqlite3_open_v2(db_path.c_str(), &explain_db, SQLITE_OPEN_READONLY, NULL) != SQLITE_OK)
+        {
+            sqlite3_close(explain_db);
+            explain_db = nullptr;
+            plan.push_back("query plan unavailable: cannot open database");
+            return plan;
+        }
+        sqlite3_busy_timeout(explain_db, 100);
+    }
+
+    std::string explain_sql = "EXPLAIN QUERY PLAN " + sql;
+    sqlite3_stmt *stmt;
+    int rc = sqlite3_prepare_v2(explain_db, explain_sql.c_str(), -1, &stmt, NULL);
+    if (rc != SQLITE_OK)
+    {
+        plan.push_back(std::string("query plan unavailable: ") + sqlite3_errmsg(explain_db));
+        return plan;
+    }
+
+    // Rows are (id, parent, notused, detail); indent each detail under its parent.
+    std::unordered_map<int, int> depth;
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        int id = sqlite3_column_int(stmt, 0);
+        int parent = sqlite3_column_int(stmt, 1);
+        depth[id] = depth.count(parent) ? depth[parent] + 1 : 0;
+        const char *detail = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 3));
+        plan.push_back(std::string(depth[id] * 2, ' ') + (detail ? detail : ""));
+    }
+
+    sqlite3_finalize(stmt);
+    return plan;
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include <sqlite3.h>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Aggregated execution statistics of one SQL text.
+struct StatementStats
+{
+    std::string sql;
+    uint64_t calls = 0;
+    uint64_t slow_calls = 0;
+    uint64_t total_ns = 0;
+    uint64_t max_ns = 0;
+    uint64_t fullscan_steps = 0;
+    uint64_t sorts = 0;
+    uint64_t autoindexes = 0;
+    uint64_t vm_steps = 0;
+};
+
+// One execution that exceeded the slow-query threshold.
+struct SlowQuery
+{
+    std::string sql;
+    uint64_t duration_ns = 0;
+    int fullscan_steps = 0;
+    int sorts = 0;
+    int autoindexes = 0;
+    int vm_steps = 0;
+    std::vector<std::string> plan;
+};
+
+// Collects sqlite3_trace_v2 profile events and sqlite3_stmt_status counters for a DBHandler connection.
+class QueryProfiler
+{
+public:
+    explicit QueryProfiler(const std::string &db_path);
+    ~QueryProfiler();
+
+    void set_threshold_ms(double threshold_ms);
+    double get_threshold_ms() const;
+
+    void record(sqlite3_stmt *stmt, uint64_t duration_ns);
+
+    std::vector<StatementStats> get_statement_stats();
+    std::vector<SlowQuery> get_slow_queries();
+
+private:
+    static const int SHARD_COUNT = 16;
+    static const size_t MAX_STATEMENTS_PER_SHARD = 256;
+    static const size_t MAX_SLOW_QUERIES = 64;
+
+    struct Shard
+    {
+        std::mutex mutex;
+        std::unordered_map<std::string, StatementStats> statements;
+    };
+
+    std::string db_path;
+    std::atomic<uint64_t> threshold_ns;
+    Shard shards[SHARD_COUNT];
+
+    std::mutex slow_mutex;
+    std::deque<SlowQuery> slow_queries;
+    sqlite3 *explain_db; // separate connection so EXPLAIN never runs inside the traced one
+
+    std::vector<std::string> explain_query_plan(const std::string &sql);
+};
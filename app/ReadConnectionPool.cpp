@@ -0,0 +1,101 @@
+#include "ReadConnectionPool.h"
+#include <iostream>
+
+// Transaction
+ReadConnectionPool::Transaction::Transaction(ReadConnectionPool *pool, sqlite3 *connection) : pool(pool), conn(connection)
+{
+    if (conn && sqlite3_exec(conn, "BEGIN", NULL, NULL, NULL) != SQLITE_OK)
+    {
+        std::cerr << "Error starting read transaction: " << sqlite3_errmsg(conn) << std::endl;
+    }
+}
+
+ReadConnectionPool::Transaction::Transaction(Transaction &&other) : pool(other.pool), conn(other.conn)
+{
+    other.conn = nullptr;
+}
+
+ReadConnectionPool::Transaction::~Transaction()
+{
+    if (conn)
+    {
+        sqlite3_exec(conn, "COMMIT", NULL, NULL, NULL);
+        pool->release(conn);
+    }
+}
+
+sqlite3 *ReadConnectionPool::Transaction::connection() const
+{
+    return conn;
+}
+
+// ReadConnectionPool
+ReadConnectionPool::ReadConnectionPool() {}
+
+ReadConnectionPool::~ReadConnectionPool()
+{
+    close();
+}
+
+bool ReadConnectionPool::open(const std::string &db_path, int size, int (*trace)(unsigned, void *, void *, void *), void *context)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    for (int i = 0; i < size; i++)
+    {
+        sqlite3 *connection;
+        // Each connection serves one read at a time, so SQLite's own per-connection mutex is not needed.
+        if (sqlite3_open_v2(db_path.c_str(), &connection, SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX, NULL) != SQLITE_OK)
+        {
+            std::cerr << "Error opening read connection: " << sqlite3_errmsg(connection) << std::endl;
+            sqlite3_close(connection);
+            return false;
+        }
+        sqlite3_busy_timeout(connection, 5000);
+        sqlite3_trace_v2(connection, SQLITE_TRACE_PROFILE, trace, context);
+        connections.push_back(connection);
+        idle.push_back(connection);
+    }
+    return true;
+}
+
+// Callers must have finished every Transaction.
+void ReadConnectionPool::close()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    for (sqlite3 *connection : connections)
+    {
+        sqlite3_close(connection);
+    }
+    connections.clear();
+    idle.clear();
+}
+
+size_t ReadConnectionPool::size() const
+{
+    return connections.size();
+}
+
+ReadConnectionPool::Transaction ReadConnectionPool::begin()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    if (connections.empty())
+    {
+        return Transaction(this, nullptr);
+    }
+    available.wait(lock, [this]
+                   { return !idle.empty(); });
+    sqlite3 *connection = idle.back();
+    idle.pop_back();
+    lock.unlock();
+    return Transaction(this, connection);
+}
+
+// private methods
+void ReadConnectionPool::release(sqlite3 *connection)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        idle.push_back(connection);
+    }
+    available.notify_one();
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <sqlite3.h>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Read-only connections to a WAL-mode registry, kept apart from the writer connection. A read holds one
+// connection inside a single read transaction, so it sees one snapshot however long it runs, and under
+// WAL neither side waits for the other.
+class ReadConnectionPool
+{
+public:
+    // A pooled connection with an open read transaction. Committing and returning the connection
+    // happen on destruction. connection() is null when the pool has no connections.
+    class Transaction
+    {
+    public:
+        Transaction(ReadConnectionPool *pool, sqlite3 *connection);
+        Transaction(Transaction &&other);
+        ~Transaction();
+        sqlite3 *connection() const;
+
+    private:
+        ReadConnectionPool *pool;
+        sqlite3 *conn;
+    };
+
+    ReadConnectionPool();
+    ~ReadConnectionPool();
+
+    // `trace` and `context` are installed with sqlite3_trace_v2 on every connection.
+    bool open(const std::string &db_path, int size, int (*trace)(unsigned, void *, void *, void *), void *context);
+    void close();
+    size_t size() const;
+
+    // Blocks until a connection is free.
+    Transaction begin();
+
+private:
+    std::mutex mutex;
+    std::condition_variable available;
+    std::vector<sqlite3 *> connections;
+    std::vector<sqlite3 *> idle;
+
+    void release(sqlite3 *connection);
+};
@@ -0,0 +1,236 @@
+#include "ReplicationFollower.h"
+#include "Metrics.h"
+#include "ShardedDBHandler.h"
+#include <cstdio>
+#include <fstream>
+
+ReplicationFollower::ReplicationFollower(const std::string &primary)
+    : host(primary), port(8080), applied_seq(0), primary_seq(0), applied_ts_ms(0), running(false), diverged(false)
+{
+    size_t colon = primary.rfind(':');
+    if (colon != std::string::npos)
+    {
+        host = primary.substr(0, colon);
+        port = std::atoi(primary.c_str() + colon + 1);
+    }
+}
+
+ReplicationFollower::~ReplicationFollower()
+{
+    stop();
+}
+
+// Any registry files left from an earlier run are discarded: the snapshot is the follower's starting point.
+bool ReplicationFollower::load_snapshot(const std::string &db_path, int shards)
+{
+    for (const char *suffix : {"", "-wal", "-shm"})
+    {
+        std::remove((db_path + suffix).c_str());
+        for (int i = 0; i < shards && shards > 1; i++)
+        {
+            std::remove((ShardedDBHandler::shard_path(db_path, i) + suffix).c_str());
+        }
+    }
+
+    std::string download_path = db_path + ".download";
+    std::ofstream file(download_path, std::ios::binary | std::ios::trunc);
+    httplib::Client cli(host, port);
+    auto result = cli.Get(
+        "/replication/snapshot", httplib::Headers(),
+        [&](const httplib::Response &response)
+        {
+            epoch = response.get_header_value("X-Replication-Epoch");
+            applied_seq = std::strtoull(response.get_header_value("X-Replication-Seq").c_str(), nullptr, 10);
+            return response.status == 200;
+        },
+        [&](const char *data, size_t length)
+        {
+            file.write(data, length);
+            return file.good();
+        });
+    file.close();
+
+    if (!result || result->status != 200 || epoch.empty())
+    {
+        std::cerr << "Failed to load snapshot from " << host << ":" << port << std::endl;
+        std::remove(download_path.c_str());
+        return false;
+    }
+    if (std::rename(download_path.c_str(), db_path.c_str()) != 0)
+    {
+        std::cerr << "Failed to move snapshot to " << db_path << std::endl;
+        return false;
+    }
+    primary_seq = applied_seq;
+    applied_ts_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    Metrics::instance().replication_applied(applied_seq, primary_seq, 0);
+    std::cout << "Loaded snapshot at seq " << applied_seq << " from " << host << ":" << port << "." << std::endl;
+    return true;
+}
+
+void ReplicationFollower::start(DBHandler &db)
+{
+    running = true;
+    thread = std::thread([this, &db]
+                         { run(db); });
+}
+
+void ReplicationFollower::stop()
+{
+    running = false;
+    if (thread.joinable())
+    {
+        thread.join();
+    }
+}
+
+// private methods
+void ReplicationFollower::run(DBHandler &db)
+{
+    while (running)
+    {
+        httplib::Client cli(host, port);
+        cli.set_read_timeout(5, 0); // heartbeats arrive every second
+        std::string buffer;
+        int status = 0;
+        bool in_sync = true;
+        std::string path = "/replication/stream?after_seq=" + std::to_string(applied_seq) + "&epoch=" + epoch;
+        cli.Get(
+            path, httplib::Headers(),
+            [&](const httplib::Response &response)
+            {
+                status = response.status;
+                Metrics::instance().set_replication_connected(status == 200);
+                return status == 200;
+            },
+            [&](const char *data, size_t length)
+            {
+                buffer.append(data, length);
+                size_t start = 0;
+                size_t end;
+                while (in_sync && (end = buffer.find('\n', start)) != std::string::npos)
+                {
+                    in_sync = handle_record(db, buffer.substr(start, end - start));
+                    start = end + 1;
+                }
+                buffer.erase(0, start);
+                return in_sync && running.load();
+            });
+        Metrics::instance().set_replication_connected(false);
+
+        if (status == 409 || diverged)
+        {
+            if (status == 409)
+            {
+                std::cerr << "Primary no longer holds the mutations after seq " << applied_seq;
+            }
+            else
+            {
+                std::cerr << "Follower diverged from the primary at seq " << applied_seq + 1;
+            }
+            std::cerr << "; restart the follower to load a new snapshot" << std::endl;
+            Metrics::instance().set_replication_stopped();
+            running = false;
+            return;
+        }
+        for (int i = 0; i < 10 && running; i++)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+    }
+}
+
+bool ReplicationFollower::handle_record(DBHandler &db, const std::string &line)
+{
+    json record = json::parse(line, nullptr, false);
+    if (record.is_discarded() || !record.contains("seq"))
+    {
+        std::cerr << "Malformed replication record: " << line << std::endl;
+        return false;
+    }
+
+    uint64_t seq = record["seq"].get<uint64_t>();
+    if (record["op"] == "heartbeat")
+    {
+        primary_seq = std::max(primary_seq, seq);
+    }
+    else if (seq != applied_seq + 1)
+    {
+        std::cerr << "Replication stream jumped from seq " << applied_seq << " to " << seq << std::endl;
+        return false;
+    }
+    else
+    {
+        // The snapshot and the stream are both taken in commit order on the primary, so every record applies here
+        // unless the copies already differ. Going on past one would keep serving data the primary does not have.
+        if (!apply(db, record))
+        {
+            std::cerr << "Failed to apply replication record: " << line << std::endl;
+            diverged = true;
+            return false;
+        }
+        applied_seq = seq;
+        applied_ts_ms = record["ts"].get<int64_t>();
+        primary_seq = std::max(primary_seq, seq);
+    }
+
+    // Behind the primary, the lag is the age of the newest mutation applied so far.
+    double lag_seconds = 0;
+    if (applied_seq < primary_seq)
+    {
+        auto now = std::chrono::system_clock::now().time_since_epoch();
+        lag_seconds = std::max<int64_t>(0, std::chrono::duration_cast<std::chrono::milliseconds>(now).count() - applied_ts_ms) / 1e3;
+    }
+    Metrics::instance().replication_applied(applied_seq, primary_seq, lag_seconds);
+    return true;
+}
+
+bool ReplicationFollower::apply(DBHandler &db, const json &record)
+{
+    auto text = [](const json &fields, const char *key)
+    { return fields[key].get<std::string>(); };
+    std::string op = text(record, "op");
+    if (op == "add_device")
+    {
+        const json &fields = record["device"];
+        Device device;
+        device.serial_number = text(fields, "serial_number");
+        device.name = text(fields, "name");
+        device.type = text(fields, "type");
+        device.creation_date = text(fields, "creation_date");
+        device.location_id = fields["location_id"].get<int>();
+        return db.add_device(device);
+    }
+    if (op == "update_device")
+    {
+        return db.update_device(text(record, "serial_number"), text(record, "name"), text(record, "type"), text(record, "creation_date"),
+                                text(record, "location_id"));
+    }
+    if (op == "delete_device")
+    {
+        return db.delete_device(text(record, "serial_number"));
+    }
+    if (op == "relocate_devices")
+    {
+        return db.relocate_devices(record["serial_numbers"].get<std::vector<std::string>>(), record["to_location_id"].get<int>()) >= 0;
+    }
+    if (op == "add_location")
+    {
+        const json &fields = record["location"];
+        Location location;
+        location.id = fields["id"].get<int>();
+        location.name = text(fields, "name");
+        location.type = text(fields, "type");
+        return db.add_location(location);
+    }
+    if (op == "update_location")
+    {
+        return db.update_location(record["id"].get<int>(), text(record, "name"), text(record, "type"));
+    }
+    if (op == "delete_location")
+    {
+        return db.delete_location(record["id"].get<int>());
+    }
+    std::cerr << "Unknown replication op: " << op << std::endl;
+    return false;
+}
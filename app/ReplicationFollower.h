@@ -0,0 +1,35 @@
+#pragma once
+#include "DBHandler.h"
+#include <atomic>
+#include <thread>
+
+// Follower side of replication. load_snapshot() replaces the local registry with the primary's snapshot
+// before it is opened; start() then streams the primary's mutations and applies them through DBHandler,
+// reconnecting when the stream drops. If the primary restarted or trimmed its log past the follower's
+// position, or a mutation fails to apply here, the follower stops applying and must be restarted to load a
+// new snapshot.
+class ReplicationFollower
+{
+public:
+    explicit ReplicationFollower(const std::string &primary); // host:port
+    ~ReplicationFollower();
+
+    bool load_snapshot(const std::string &db_path, int shards);
+    void start(DBHandler &db);
+    void stop();
+
+private:
+    std::string host;
+    int port;
+    std::string epoch;
+    uint64_t applied_seq;
+    uint64_t primary_seq;  // highest sequence number the primary has reported
+    int64_t applied_ts_ms; // primary commit time of the last applied mutation
+    std::atomic<bool> running;
+    bool diverged; // a mutation failed to apply, so the local registry no longer matches the primary's
+    std::thread thread;
+
+    void run(DBHandler &db);
+    bool handle_record(DBHandler &db, const std::string &line);
+    static bool apply(DBHandler &db, const json &record);
+};
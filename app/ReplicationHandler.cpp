@@ -0,0 +1,124 @@
+#include "ReplicationHandler.h"
+#include "Metrics.h"
+#include <cstdio>
+#include <fstream>
+
+ReplicationHandler::ReplicationHandler(DBHandler &dbHandler, ReplicationLog &log, const std::string &snapshot_prefix)
+    : db(dbHandler), log(log), snapshot_prefix(snapshot_prefix), snapshot_count(0) {}
+
+void ReplicationHandler::get_snapshot(const httplib::Request &req, httplib::Response &res)
+{
+    json response;
+
+    std::string path = snapshot_prefix + "-" + std::to_string(snapshot_count.fetch_add(1)) + ".db";
+    std::remove(path.c_str());
+    uint64_t seq = 0;
+    if (!db.snapshot(path, [&]
+                     { seq = log.last_seq(); }))
+    {
+        std::remove(path.c_str());
+        res.status = 500;
+        response["status"] = "error";
+        response["message"] = "Failed to write snapshot in DBHandler";
+        res.set_content(response.dump(), "application/json");
+        return;
+    }
+
+    auto file = std::make_shared<std::ifstream>(path, std::ios::binary);
+    file->seekg(0, std::ios::end);
+    size_t size = file->tellg();
+    file->seekg(0);
+
+    res.status = 200;
+    res.set_header("X-Replication-Epoch", log.epoch());
+    res.set_header("X-Replication-Seq", std::to_string(seq));
+    res.set_content_provider(
+        size, "application/octet-stream",
+        [file](size_t offset, size_t length, httplib::DataSink &sink)
+        {
+            char buf[65536];
+            file->seekg(offset);
+            file->read(buf, std::min(length, sizeof(buf)));
+            return file->gcount() > 0 && sink.write(buf, file->gcount());
+        },
+        [file, path](bool success)
+        {
+            file->close();
+            std::remove(path.c_str());
+        });
+}
+
+// Newline-delimited JSON records after `after_seq`, then new ones as they commit. A heartbeat carrying the
+// primary's last sequence number goes out whenever nothing was committed for HEARTBEAT_MS.
+void ReplicationHandler::get_stream(const httplib::Request &req, httplib::Response &res)
+{
+    json response;
+
+    uint64_t after_seq;
+    try
+    {
+        after_seq = std::stoull(req.get_param_value("after_seq"));
+    }
+    catch (...)
+    {
+        res.status = 400;
+        response["status"] = "invalid";
+        response["message"] = "Invalid after_seq";
+        res.set_content(response.dump(), "application/json");
+        return;
+    }
+
+    std::vector<std::string> lines;
+    if (req.get_param_value("epoch") != log.epoch() || !log.read_after(after_seq, lines, std::chrono::milliseconds(0)))
+    {
+        res.status = 409;
+        response["status"] = "conflict";
+        response["message"] = "Replication log does not continue from after_seq; load a new snapshot";
+        res.set_content(response.dump(), "application/json");
+        return;
+    }
+
+    Metrics::instance().replication_stream_opened();
+    res.status = 200;
+    res.set_chunked_content_provider(
+        "application/x-ndjson",
+        [this, after_seq](size_t offset, httplib::DataSink &sink) mutable
+        {
+            std::vector<std::string> lines;
+            if (!log.read_after(after_seq, lines, std::chrono::milliseconds(HEARTBEAT_MS)))
+            {
+                return false; // the follower fell out of the log
+            }
+            if (lines.empty())
+            {
+                auto now = std::chrono::system_clock::now().time_since_epoch();
+                json heartbeat = {{"op", "heartbeat"},
+                                  {"seq", log.last_seq()},
+                                  {"ts", std::chrono::duration_cast<std::chrono::milliseconds>(now).count()}};
+                lines.push_back(heartbeat.dump() + "\n");
+            }
+            else
+            {
+                after_seq += lines.size();
+            }
+            for (const auto &line : lines)
+            {
+                if (!sink.write(line.data(), line.size()))
+                {
+                    return false;
+                }
+            }
+            return true;
+        },
+        [](bool success)
+        { Metrics::instance().replication_stream_closed(); });
+}
+
+void ReplicationHandler::handle_requests(httplib::Server &svr)
+{
+    svr.Get("/replication/snapshot", [&](const httplib::Request &req, httplib::Response &res)
+            { get_snapshot(req, res); });
+
+    svr.Get("/replication/stream", [&](const httplib::Request &req, httplib::Response &res)
+            { get_stream(req, res); });
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include "DBHandler.h"
+#include "ReplicationLog.h"
+#include <atomic>
+
+// Primary side of replication: a snapshot to seed followers and the stream of mutations committed since.
+class ReplicationHandler
+{
+public:
+    ReplicationHandler(DBHandler &dbHandler, ReplicationLog &log, const std::string &snapshot_prefix);
+
+    void handle_requests(httplib::Server &svr);
+
+private:
+    static constexpr int HEARTBEAT_MS = 1000;
+
+    DBHandler &db;
+    ReplicationLog &log;
+    std::string snapshot_prefix; // snapshots are written next to the registry, then streamed and removed
+    std::atomic<uint64_t> snapshot_count;
+
+    void get_snapshot(const httplib::Request &req, httplib::Response &res);
+    void get_stream(const httplib::Request &req, httplib::Response &res);
+};
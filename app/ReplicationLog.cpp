@@ -0,0 +1,58 @@
+#include "ReplicationLog.h"
+#include "Metrics.h"
+
+ReplicationLog::ReplicationLog(size_t capacity) : first_seq(1), next_seq(1), capacity(std::max<size_t>(capacity, 1))
+{
+    auto now = std::chrono::system_clock::now().time_since_epoch();
+    epoch_id = std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(now).count());
+}
+
+void ReplicationLog::append(json mutation)
+{
+    auto now = std::chrono::system_clock::now().time_since_epoch();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        uint64_t seq = next_seq++;
+        mutation["seq"] = seq;
+        mutation["ts"] = std::chrono::duration_cast<std::chrono::milliseconds>(now).count();
+        records.push_back(mutation.dump() + "\n");
+        if (records.size() > capacity)
+        {
+            records.pop_front();
+            first_seq++;
+        }
+        Metrics::instance().replication_published(seq);
+    }
+    appended.notify_all();
+}
+
+uint64_t ReplicationLog::last_seq() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return next_seq - 1;
+}
+
+const std::string &ReplicationLog::epoch() const
+{
+    return epoch_id;
+}
+
+bool ReplicationLog::read_after(uint64_t after_seq, std::vector<std::string> &lines, std::chrono::milliseconds timeout)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    if (after_seq + 1 < first_seq || after_seq >= next_seq)
+    {
+        return false;
+    }
+    appended.wait_for(lock, timeout, [&]
+                      { return after_seq + 1 < next_seq; });
+    if (after_seq + 1 < first_seq)
+    {
+        return false; // trimmed while waiting
+    }
+    for (uint64_t seq = after_seq + 1; seq < next_seq && lines.size() < MAX_READ; seq++)
+    {
+        lines.push_back(records[seq - first_seq]);
+    }
+    return true;
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include "json.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+using json = nlohmann::json;
+
+// In-memory log of the most recent committed mutations, numbered from 1 in commit order. Followers
+// stream it from /replication/stream. The epoch changes on every start, so a follower can tell that
+// sequence numbers from an earlier run of the primary no longer apply.
+class ReplicationLog
+{
+public:
+    explicit ReplicationLog(size_t capacity);
+
+    // Stamps the mutation with its sequence number and commit time and stores it as one JSON line.
+    void append(json mutation);
+
+    uint64_t last_seq() const;
+    const std::string &epoch() const;
+
+    // Copies the records after `after_seq` into `lines`, waiting up to `timeout` for the first one.
+    // Returns false when the log no longer holds (or never held) the record after `after_seq`.
+    bool read_after(uint64_t after_seq, std::vector<std::string> &lines, std::chrono::milliseconds timeout);
+
+private:
+    static const size_t MAX_READ = 1024;
+
+    mutable std::mutex mutex;
+    std::condition_variable appended;
+    std::deque<std::string> records;
+    uint64_t first_seq; // sequence number of records.front()
+    uint64_t next_seq;
+    size_t capacity;
+    std::string epoch_id;
+};
@@ -0,0 +1,174 @@
+#include "RequestArena.h"
+#include "Metrics.h"
+#include "RequestLocal.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+namespace
+{
+    const size_t INITIAL_BUFFER_BYTES = 16 * 1024;
+    const size_t MAX_BUFFER_BYTES = 1024 * 1024;
+
+    std::atomic<bool> enabled(true);
+
+    // Heap chunks the arena takes once a request outgrows its buffer.
+    class Upstream : public std::pmr::memory_resource
+    {
+    public:
+        size_t allocations = 0;
+        size_t bytes = 0;
+
+    private:
+        void *do_allocate(size_t size, size_t alignment) override
+        {
+            allocations++;
+            bytes += size;
+            return std::pmr::new_delete_resource()->allocate(size, alignment);
+        }
+
+        void do_deallocate(void *ptr, size_t size, size_t alignment) override
+        {
+            std::pmr::new_delete_resource()->deallocate(ptr, size, alignment);
+        }
+
+        bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override
+        {
+            return this == &other;
+        }
+    };
+
+    class Arena : public std::pmr::memory_resource
+    {
+    public:
+        Arena() : capacity(INITIAL_BUFFER_BYTES), used(0)
+        {
+            rebuild();
+        }
+
+        // A request that overflowed the buffer doubles it until the request would have fit, so the next one
+        // of the same size stays in the buffer.
+        void reset()
+        {
+            Metrics::instance().request_arena_reset(used, upstream.allocations);
+            if (upstream.allocations > 0 && capacity < MAX_BUFFER_BYTES)
+            {
+                while (capacity < used && capacity < MAX_BUFFER_BYTES)
+                {
+                    capacity *= 2;
+                }
+                rebuild();
+            }
+            else
+            {
+                arena->release();
+            }
+            used = 0;
+            upstream.allocations = 0;
+            upstream.bytes = 0;
+        }
+
+    private:
+        size_t capacity;
+        size_t used; // bytes handed out since the last reset
+        std::unique_ptr<std::byte[]> buffer;
+        Upstream upstream;
+        std::optional<std::pmr::monotonic_buffer_resource> arena;
+
+        void rebuild()
+        {
+            arena.reset(); // returns the upstream chunks before the buffer goes
+            buffer.reset(new std::byte[capacity]);
+            arena.emplace(buffer.get(), capacity, &upstream);
+        }
+
+        void *do_allocate(size_t size, size_t alignment) override
+        {
+            used += size;
+            return arena->allocate(size, alignment);
+        }
+
+        void do_deallocate(void *, size_t, size_t) override {}
+
+        bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override
+        {
+            return this == &other;
+        }
+    };
+
+    RequestLocal<Arena *> current;
+
+    // Arenas released on another thread than the one that took them (coroutine handlers) go back through here.
+    std::mutex pool_mutex;
+    std::vector<std::unique_ptr<Arena>> pool;
+
+    std::unique_ptr<Arena> &cached_arena()
+    {
+        thread_local std::unique_ptr<Arena> arena;
+        return arena;
+    }
+
+    Arena &thread_arena()
+    {
+        thread_local Arena arena;
+        return arena;
+    }
+
+    Arena *acquire()
+    {
+        std::unique_ptr<Arena> &cached = cached_arena();
+        if (cached)
+        {
+            return cached.release();
+        }
+        std::lock_guard<std::mutex> lock(pool_mutex);
+        if (pool.empty())
+        {
+            return new Arena();
+        }
+        Arena *arena = pool.back().release();
+        pool.pop_back();
+        return arena;
+    }
+
+    void release(Arena *arena)
+    {
+        arena->reset();
+        std::unique_ptr<Arena> &cached = cached_arena();
+        if (!cached)
+        {
+            cached.reset(arena);
+            return;
+        }
+        std::lock_guard<std::mutex> lock(pool_mutex);
+        pool.emplace_back(arena);
+    }
+}
+
+std::pmr::memory_resource *RequestArena::resource()
+{
+    if (!enabled.load(std::memory_order_relaxed))
+    {
+        return std::pmr::new_delete_resource();
+    }
+    Arena *arena = current.get();
+    return arena != nullptr ? arena : &thread_arena();
+}
+
+void RequestArena::set_enabled(bool value)
+{
+    enabled.store(value, std::memory_order_relaxed);
+}
+
+RequestArena::Scope::Scope() : previous(current.get())
+{
+    current.get() = acquire();
+}
+
+RequestArena::Scope::~Scope()
+{
+    release(current.get());
+    current.get() = static_cast<Arena *>(previous);
+}
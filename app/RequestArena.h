@@ -0,0 +1,73 @@
+#pragma once
+#include "httplib.h"
+#include "json.hpp"
+#include <cstdint>
+#include <map>
+#include <memory_resource>
+#include <string>
+#include <vector>
+
+// Monotonic arena for memory that only lives while one request is handled: response JSON, parsed request bodies
+// and scratch containers. Allocation is a pointer bump and freeing is a no-op; everything is released at once
+// when the route's Scope ends. A Scope takes an arena that starts with a 16 KB buffer and grows it (up to 1 MB)
+// after a request overflows it; arenas are recycled through a per-thread cache, so steady-state requests do not
+// reach malloc at all.
+//
+// The arena belongs to the request rather than the thread, so a coroutine handler keeps it when it resumes on
+// another thread (see RequestLocal). Outside a Scope, resource() falls back to a per-thread arena that is never
+// reset; nothing should allocate from it.
+//
+// Anything allocated here must be gone before the Scope ends; results that outlive the request (the response
+// body, values handed to DBHandler) stay on the regular heap.
+class RequestArena
+{
+public:
+    static std::pmr::memory_resource *resource(); // the current request's arena, or the heap when disabled
+    static void set_enabled(bool enabled);        // for benchmarks; switch only while no request is in flight
+
+    // Gives the request an arena for its lifetime. Handlers open one around each request.
+    class Scope
+    {
+    public:
+        Scope();
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+        ~Scope();
+
+    private:
+        void *previous; // the enclosing Scope's arena, if any
+    };
+};
+
+// Stateless allocator over RequestArena, so that types that default-construct their allocator (nlohmann's
+// basic_json) can use it.
+template <typename T>
+class ArenaAllocator
+{
+public:
+    using value_type = T;
+
+    ArenaAllocator() = default;
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U> &) {}
+
+    T *allocate(size_t n) { return static_cast<T *>(RequestArena::resource()->allocate(n * sizeof(T), alignof(T))); }
+    void deallocate(T *ptr, size_t n) { RequestArena::resource()->deallocate(ptr, n * sizeof(T), alignof(T)); }
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U> &) const { return true; }
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U> &) const { return false; }
+};
+
+// JSON whose objects, arrays and string values live in the request arena. Object keys and string contents still
+// use std::string, which keeps short ones inline.
+using RequestJson = nlohmann::basic_json<std::map, std::vector, std::string, bool, std::int64_t, std::uint64_t, double, ArenaAllocator>;
+
+// Parameter value without copying it out of the request; empty when absent.
+inline const std::string &request_param(const httplib::Request &req, const std::string &key)
+{
+    static const std::string empty;
+    auto it = req.params.find(key);
+    return it == req.params.end() ? empty : it->second;
+}
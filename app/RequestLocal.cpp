@@ -0,0 +1,45 @@
+#include "RequestLocal.h"
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+    thread_local RequestLocals::Saved thread_block{};
+
+    size_t &reserved()
+    {
+        static size_t bytes = 0;
+        return bytes;
+    }
+}
+
+RequestLocals::Saved RequestLocals::detach()
+{
+    Saved saved;
+    std::memcpy(saved.bytes, thread_block.bytes, reserved());
+    std::memset(thread_block.bytes, 0, reserved());
+    return saved;
+}
+
+void RequestLocals::attach(const Saved &saved)
+{
+    std::memcpy(thread_block.bytes, saved.bytes, reserved());
+}
+
+unsigned char *RequestLocals::block()
+{
+    return thread_block.bytes;
+}
+
+size_t RequestLocals::reserve(size_t size, size_t alignment)
+{
+    size_t offset = (reserved() + alignment - 1) / alignment * alignment;
+    if (offset + size > CAPACITY)
+    {
+        std::cerr << "RequestLocals::CAPACITY is too small for the request-local values" << std::endl;
+        std::abort();
+    }
+    reserved() = offset + size;
+    return offset;
+}
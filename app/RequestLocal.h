@@ -0,0 +1,43 @@
+#pragma once
+#include <cstddef>
+#include <type_traits>
+
+// State that belongs to the request being handled but is reached through the thread handling it: the current
+// request arena, admission bookkeeping between pre- and post-routing. A synchronous handler keeps its request on
+// one thread, so a thread_local would do. A coroutine handler suspends on one thread, other requests use that
+// thread meanwhile, and it resumes on another; the awaitables it suspends in detach() the request's values from
+// the suspending thread and attach() them on the resuming one.
+//
+// All values live in one small per-thread block, so moving a request's state is a copy of that block. Slots are
+// reserved during static initialisation and must hold trivially copyable types for which all-zero bytes is the
+// "no request" state.
+class RequestLocals
+{
+public:
+    static const size_t CAPACITY = 64;
+
+    struct Saved
+    {
+        alignas(std::max_align_t) unsigned char bytes[CAPACITY];
+    };
+
+    static Saved detach(); // leaves the calling thread with zeroed values
+    static void attach(const Saved &saved);
+
+    static unsigned char *block();
+    static size_t reserve(size_t size, size_t alignment);
+};
+
+template <typename T>
+class RequestLocal
+{
+    static_assert(std::is_trivially_copyable<T>::value, "request-local values are moved by copying bytes");
+
+public:
+    RequestLocal() : offset(RequestLocals::reserve(sizeof(T), alignof(T))) {}
+
+    T &get() const { return *reinterpret_cast<T *>(RequestLocals::block() + offset); }
+
+private:
+    size_t offset;
+};
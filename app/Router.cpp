@@ -0,0 +1,320 @@
+#include "Router.h"
+#include <charconv>
+#include <stdexcept>
+
+Router::Router() : max_depth(0), method_used() {}
+
+Router::~Router() = default;
+
+void Router::Get(const std::string &pattern, Handler handler)
+{
+    add(GET, pattern).handlers[GET] = std::move(handler);
+}
+
+void Router::Post(const std::string &pattern, Handler handler)
+{
+    add(POST, pattern).handlers[POST] = std::move(handler);
+}
+
+void Router::Patch(const std::string &pattern, Handler handler)
+{
+    add(PATCH, pattern).handlers[PATCH] = std::move(handler);
+}
+
+void Router::Delete(const std::string &pattern, Handler handler)
+{
+    add(DELETE, pattern).handlers[DELETE] = std::move(handler);
+}
+
+void Router::GetAsync(const std::string &pattern, AsyncHandler handler)
+{
+    add_async(GET, pattern, std::move(handler));
+}
+
+void Router::PostAsync(const std::string &pattern, AsyncHandler handler)
+{
+    add_async(POST, pattern, std::move(handler));
+}
+
+void Router::PatchAsync(const std::string &pattern, AsyncHandler handler)
+{
+    add_async(PATCH, pattern, std::move(handler));
+}
+
+void Router::DeleteAsync(const std::string &pattern, AsyncHandler handler)
+{
+    add_async(DELETE, pattern, std::move(handler));
+}
+
+void Router::install(httplib::Server &svr)
+{
+    // "/:p0" matches one segment, "/:p0/:p1" two, and so on; which one matched does not matter. httplib tries
+    // them in order, so the deepest (the routes with captures) go first.
+    for (size_t depth = max_depth; depth >= 1; depth--)
+    {
+        std::string pattern;
+        for (size_t i = 0; i < depth; i++)
+        {
+            pattern += "/:p" + std::to_string(i);
+        }
+        auto fallback = [this](const httplib::Request &req, httplib::Response &res)
+        {
+            if (!route(req, res))
+            {
+                res.status = 404;
+            }
+        };
+        if (method_used[POST])
+        {
+            svr.Post(pattern, fallback);
+        }
+        if (method_used[PATCH])
+        {
+            svr.Patch(pattern, fallback);
+        }
+        if (method_used[DELETE])
+        {
+            svr.Delete(pattern, fallback);
+        }
+    }
+}
+
+httplib::Server::HandlerResponse Router::dispatch(const httplib::Request &req, httplib::Response &res) const
+{
+    if ((req.method == "GET" || req.method == "HEAD") && route(req, res))
+    {
+        return httplib::Server::HandlerResponse::Handled;
+    }
+    return httplib::Server::HandlerResponse::Unhandled;
+}
+
+bool Router::route(const httplib::Request &req, httplib::Response &res) const
+{
+    Method method;
+    Params params;
+    const Node *node = find(req, method, params);
+    if (node == nullptr)
+    {
+        return false;
+    }
+#ifdef REGISTRY_COROUTINES
+    if (node->async_handlers[method])
+    {
+        node->async_handlers[method](req, res, params).run_inline();
+        return true;
+    }
+#endif
+    node->handlers[method](req, res, params);
+    return true;
+}
+
+#ifdef REGISTRY_COROUTINES
+Task<bool> Router::route_async(const httplib::Request &req, httplib::Response &res) const
+{
+    Method method;
+    Params params;
+    const Node *node = find(req, method, params);
+    if (node == nullptr)
+    {
+        co_return false;
+    }
+    if (node->async_handlers[method])
+    {
+        co_await node->async_handlers[method](req, res, params);
+    }
+    else
+    {
+        node->handlers[method](req, res, params);
+    }
+    co_return true;
+}
+#else
+bool Router::route_async(const httplib::Request &req, httplib::Response &res) const
+{
+    return route(req, res);
+}
+#endif
+
+// private methods
+bool Router::Node::has_handler(Method method) const
+{
+#ifdef REGISTRY_COROUTINES
+    if (async_handlers[method])
+    {
+        return true;
+    }
+#endif
+    return static_cast<bool>(handlers[method]);
+}
+
+// The node for `pattern`, created as needed, once the method is known to be free there.
+Router::Node &Router::add(Method method, const std::string &pattern)
+{
+    if (pattern.empty() || pattern[0] != '/')
+    {
+        throw std::invalid_argument("Route pattern must start with '/': " + pattern);
+    }
+    Node *node = &root;
+    size_t depth = 0;
+    size_t captures = 0;
+    size_t start = 1;
+    while (start <= pattern.size())
+    {
+        size_t end = pattern.find('/', start);
+        if (end == std::string::npos)
+        {
+            end = pattern.size();
+        }
+        std::string segment = pattern.substr(start, end - start);
+        std::unique_ptr<Node> *child = nullptr;
+        if (segment == "{serial}" || segment == "{id}")
+        {
+            if (++captures > MAX_CAPTURES)
+            {
+                throw std::invalid_argument("Too many captures in route pattern: " + pattern);
+            }
+            child = segment == "{serial}" ? &node->serial : &node->id;
+        }
+        else
+        {
+            for (auto &literal : node->literals)
+            {
+                if (literal.first == segment)
+                {
+                    child = &literal.second;
+                    break;
+                }
+            }
+            if (child == nullptr)
+            {
+                node->literals.emplace_back(segment, nullptr);
+                child = &node->literals.back().second;
+            }
+        }
+        if (!*child)
+        {
+            *child = std::make_unique<Node>();
+        }
+        node = child->get();
+        depth++;
+        start = end + 1;
+    }
+    if (node->has_handler(method))
+    {
+        throw std::invalid_argument("Route registered twice: " + pattern);
+    }
+    method_used[method] = true;
+    if (depth > max_depth)
+    {
+        max_depth = depth;
+    }
+    return *node;
+}
+
+void Router::add_async(Method method, const std::string &pattern, AsyncHandler handler)
+{
+#ifdef REGISTRY_COROUTINES
+    add(method, pattern).async_handlers[method] = std::move(handler);
+#else
+    add(method, pattern).handlers[method] = std::move(handler);
+#endif
+}
+
+// `path` is the unmatched rest of the request path: empty, or starting with the '/' before the next segment.
+const Router::Node *Router::match(const Node &node, std::string_view path, Method method, Params &params, size_t captures) const
+{
+    if (path.empty())
+    {
+        return node.has_handler(method) ? &node : nullptr;
+    }
+    size_t end = path.find('/', 1);
+    if (end == std::string_view::npos)
+    {
+        end = path.size();
+    }
+    std::string_view segment = path.substr(1, end - 1);
+    std::string_view rest = path.substr(end);
+
+    for (const auto &literal : node.literals)
+    {
+        if (literal.first == segment)
+        {
+            if (const Node *found = match(*literal.second, rest, method, params, captures))
+            {
+                return found;
+            }
+            break;
+        }
+    }
+    if (node.serial && !segment.empty())
+    {
+        params.captures[captures].text = segment;
+        if (const Node *found = match(*node.serial, rest, method, params, captures + 1))
+        {
+            return found;
+        }
+    }
+    int id;
+    if (node.id && parse_id(segment, id))
+    {
+        params.captures[captures].text = segment;
+        params.captures[captures].id = id;
+        if (const Node *found = match(*node.id, rest, method, params, captures + 1))
+        {
+            return found;
+        }
+    }
+    return nullptr;
+}
+
+const Router::Node *Router::find(const httplib::Request &req, Method &method, Params &params) const
+{
+    if (!parse_method(req.method, method) || req.path.empty() || req.path[0] != '/')
+    {
+        return nullptr;
+    }
+    return match(root, req.path, method, params, 0);
+}
+
+// HEAD runs the GET handler; httplib drops the body.
+bool Router::parse_method(const std::string &name, Method &method)
+{
+    if (name == "GET" || name == "HEAD")
+    {
+        method = GET;
+    }
+    else if (name == "POST")
+    {
+        method = POST;
+    }
+    else if (name == "PATCH")
+    {
+        method = PATCH;
+    }
+    else if (name == "DELETE")
+    {
+        method = DELETE;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+bool Router::parse_id(std::string_view text, int &id)
+{
+    if (text.empty())
+    {
+        return false;
+    }
+    for (char c : text)
+    {
+        if (c < '0' || c > '9')
+        {
+            return false;
+        }
+    }
+    auto result = std::from_chars(text.data(), text.data() + text.size(), id);
+    return result.ec == std::errc();
+}
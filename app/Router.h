@@ -0,0 +1,113 @@
+#pragma once
+#include "Async.h"
+#include "httplib.h"
+#include <array>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Dispatches device and location routes through a path trie compiled at startup instead of httplib's list of
+// std::regex patterns. Patterns are '/'-separated segments; a segment is either literal text or a typed capture:
+//   {serial}  any non-empty segment
+//   {id}      a decimal integer that fits in an int
+// Literal segments win over captures, so "/devices/filter" and "/devices/{serial}" can coexist; a request that
+// matches the literal path but has no handler for its method falls back to the capture.
+//
+// GET and HEAD requests are answered from httplib's pre-routing hook, before any regex is tried. httplib only
+// reads request bodies (and form parameters) after that hook, so methods that carry a body are dispatched from
+// catch-all routes install() registers for each path depth, which httplib matches without regex. The router owns
+// those methods: paths it does not know get a 404 there rather than reaching routes registered later.
+//
+// Handlers registered with the *Async methods return Task<> (see Async.h). route() runs them to completion on the
+// calling thread; route_async() lets a coroutine front end await them.
+class Router
+{
+public:
+    static const size_t MAX_CAPTURES = 4;
+
+    class Params
+    {
+    public:
+        std::string_view text(size_t index) const { return captures[index].text; }
+        int id(size_t index) const { return captures[index].id; }
+
+    private:
+        friend class Router;
+
+        struct Capture
+        {
+            std::string_view text;
+            int id = 0;
+        };
+        std::array<Capture, MAX_CAPTURES> captures;
+    };
+
+    using Handler = std::function<void(const httplib::Request &, httplib::Response &, const Params &)>;
+    using AsyncHandler = std::function<Task<>(const httplib::Request &, httplib::Response &, const Params &)>;
+
+    Router();
+    ~Router();
+
+    void Get(const std::string &pattern, Handler handler);
+    void Post(const std::string &pattern, Handler handler);
+    void Patch(const std::string &pattern, Handler handler);
+    void Delete(const std::string &pattern, Handler handler);
+    void GetAsync(const std::string &pattern, AsyncHandler handler);
+    void PostAsync(const std::string &pattern, AsyncHandler handler);
+    void PatchAsync(const std::string &pattern, AsyncHandler handler);
+    void DeleteAsync(const std::string &pattern, AsyncHandler handler);
+
+    // Registers the catch-all routes for methods with a body. Call after every route has been added.
+    void install(httplib::Server &svr);
+
+    // Pre-routing stage: handles GET and HEAD requests for known paths.
+    httplib::Server::HandlerResponse dispatch(const httplib::Request &req, httplib::Response &res) const;
+
+    // Runs the handler for the request's method and path; false when there is none.
+    bool route(const httplib::Request &req, httplib::Response &res) const;
+    Task<bool> route_async(const httplib::Request &req, httplib::Response &res) const;
+
+private:
+    enum Method
+    {
+        GET,
+        POST,
+        PATCH,
+        DELETE,
+        METHOD_COUNT
+    };
+
+    enum class Segment
+    {
+        LITERAL,
+        SERIAL,
+        ID
+    };
+
+    struct Node
+    {
+        std::vector<std::pair<std::string, std::unique_ptr<Node>>> literals;
+        std::unique_ptr<Node> serial;
+        std::unique_ptr<Node> id;
+        std::array<Handler, METHOD_COUNT> handlers;
+#ifdef REGISTRY_COROUTINES
+        std::array<AsyncHandler, METHOD_COUNT> async_handlers;
+#endif
+
+        bool has_handler(Method method) const;
+    };
+
+    Node root;
+    size_t max_depth; // segments in the longest pattern
+    std::array<bool, METHOD_COUNT> method_used;
+
+    Node &add(Method method, const std::string &pattern);
+    void add_async(Method method, const std::string &pattern, AsyncHandler handler);
+    const Node *match(const Node &node, std::string_view path, Method method, Params &params, size_t captures) const;
+    const Node *find(const httplib::Request &req, Method &method, Params &params) const;
+    static bool parse_method(const std::string &name, Method &method);
+    static bool parse_id(std::string_view text, int &id);
+};
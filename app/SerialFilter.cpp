@@ -0,0 +1,245 @@
+#include "SerialFilter.h"
+#include "Metrics.h"
+#include "TextKernels.h"
+#include <mutex>
+
+SerialFilter::SerialFilter() : bucket_mask(0), item_count(0), victim_fingerprint(0), victim_bucket(0), ready(false) {}
+
+SerialFilter::~SerialFilter()
+{
+    Metrics::instance().serial_filter_changed(-static_cast<int64_t>(item_count), -static_cast<int64_t>(memory_bytes()));
+}
+
+void SerialFilter::reset(size_t expected_items)
+{
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    ready.store(false);
+    int64_t old_items = item_count;
+    int64_t old_bytes = slots.size() * sizeof(uint16_t);
+
+    // Buckets are a power of two so alt_bucket() is an involution; keep the load below 85%.
+    size_t buckets = 1024;
+    while (buckets * SLOTS_PER_BUCKET * 0.85 < expected_items)
+    {
+        buckets *= 2;
+    }
+    std::vector<uint16_t>(buckets * SLOTS_PER_BUCKET, 0).swap(slots);
+    bucket_mask = buckets - 1;
+    item_count = 0;
+    victim_fingerprint = 0;
+
+    Metrics::instance().serial_filter_changed(-old_items, static_cast<int64_t>(slots.size() * sizeof(uint16_t)) - old_bytes);
+}
+
+void SerialFilter::mark_ready()
+{
+    ready.store(true);
+}
+
+bool SerialFilter::add(const std::string &serial_number)
+{
+    uint64_t h = hash(serial_number);
+    uint16_t fp = fingerprint(h);
+
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    size_t bucket = h & bucket_mask;
+    if (victim_fingerprint != 0)
+    {
+        return false;
+    }
+    item_count++;
+    Metrics::instance().serial_filter_changed(1, 0);
+    if (insert_into(bucket, fp) || insert_into(alt_bucket(bucket, fp), fp))
+    {
+        return true;
+    }
+
+    // Both buckets are full: evict fingerprints to their alternate buckets until one finds room.
+    size_t current = (h >> 32) & 1 ? alt_bucket(bucket, fp) : bucket;
+    for (int kick = 0; kick < MAX_KICKS; kick++)
+    {
+        uint16_t &slot = slots[current * SLOTS_PER_BUCKET + kick % SLOTS_PER_BUCKET];
+        std::swap(fp, slot);
+        current = alt_bucket(current, fp);
+        if (insert_into(current, fp))
+        {
+            return true;
+        }
+    }
+    // Keep the homeless fingerprint so lookups stay free of false negatives; the next add reports full.
+    victim_fingerprint = fp;
+    victim_bucket = current;
+    return true;
+}
+
+void SerialFilter::remove(const std::string &serial_number)
+{
+    uint64_t h = hash(serial_number);
+    uint16_t fp = fingerprint(h);
+
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    size_t bucket = h & bucket_mask;
+    if (remove_from(bucket, fp) || remove_from(alt_bucket(bucket, fp), fp))
+    {
+        item_count--;
+        Metrics::instance().serial_filter_changed(-1, 0);
+        if (victim_fingerprint != 0 && insert_into(victim_bucket, victim_fingerprint))
+        {
+            victim_fingerprint = 0;
+        }
+    }
+    else if (victim_fingerprint == fp && (victim_bucket == bucket || victim_bucket == alt_bucket(bucket, fp)))
+    {
+        victim_fingerprint = 0;
+        item_count--;
+        Metrics::instance().serial_filter_changed(-1, 0);
+    }
+}
+
+bool SerialFilter::might_contain(const std::string &serial_number) const
+{
+    if (!ready.load(std::memory_order_acquire))
+    {
+        return true;
+    }
+    uint64_t h = hash(serial_number);
+    uint16_t fp = fingerprint(h);
+
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    size_t bucket = h & bucket_mask;
+    size_t alt = alt_bucket(bucket, fp);
+    if (bucket_contains(bucket, fp) || bucket_contains(alt, fp))
+    {
+        return true;
+    }
+    return victim_fingerprint == fp && (victim_bucket == bucket || victim_bucket == alt);
+}
+
+void SerialFilter::save(WarmStartWriter &out) const
+{
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    out.put(static_cast<uint8_t>(ready.load()));
+    out.put(static_cast<uint64_t>(bucket_mask));
+    out.put(static_cast<uint64_t>(item_count));
+    out.put(victim_fingerprint);
+    out.put(static_cast<uint64_t>(victim_bucket));
+    out.put_array(slots.data(), slots.size());
+}
+
+bool SerialFilter::restore(WarmStartReader &in)
+{
+    uint8_t was_ready = 0;
+    uint64_t saved_mask = 0;
+    uint64_t saved_items = 0;
+    uint16_t saved_victim = 0;
+    uint64_t saved_victim_bucket = 0;
+    in.get(was_ready);
+    in.get(saved_mask);
+    in.get(saved_items);
+    in.get(saved_victim);
+    in.get(saved_victim_bucket);
+    std::vector<uint16_t> saved_slots;
+    bool valid = in.ok() && was_ready && saved_mask < (uint64_t(1) << 40) && (saved_mask & (saved_mask + 1)) == 0 &&
+                 saved_victim_bucket <= saved_mask && in.get_array(saved_slots, (saved_mask + 1) * SLOTS_PER_BUCKET);
+    if (!valid)
+    {
+        return false;
+    }
+
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    int64_t old_items = item_count;
+    int64_t old_bytes = slots.size() * sizeof(uint16_t);
+    slots.swap(saved_slots);
+    bucket_mask = saved_mask;
+    item_count = saved_items;
+    victim_fingerprint = saved_victim;
+    victim_bucket = saved_victim_bucket;
+    ready.store(true);
+
+    Metrics::instance().serial_filter_changed(static_cast<int64_t>(item_count) - old_items,
+                                              static_cast<int64_t>(slots.size() * sizeof(uint16_t)) - old_bytes);
+    return true;
+}
+
+size_t SerialFilter::size() const
+{
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    return item_count;
+}
+
+size_t SerialFilter::capacity() const
+{
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    return slots.size();
+}
+
+size_t SerialFilter::memory_bytes() const
+{
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    return slots.size() * sizeof(uint16_t);
+}
+
+// Each lookup compares against 2 * SLOTS_PER_BUCKET fingerprints of 16 bits, weighted by the load factor.
+double SerialFilter::expected_false_positive_rate() const
+{
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    if (slots.empty())
+    {
+        return 0.0;
+    }
+    double load = static_cast<double>(item_count) / slots.size();
+    return 2.0 * SLOTS_PER_BUCKET * load / 65535.0;
+}
+
+// private methods
+// Case-insensitive like COLLATE NOCASE. Warm-start files hold the fingerprints, see FORMAT_VERSION in WarmStart.cpp.
+uint64_t SerialFilter::hash(const std::string &serial_number)
+{
+    return TextKernels::hash_nocase(serial_number.data(), serial_number.size());
+}
+
+uint16_t SerialFilter::fingerprint(uint64_t hash)
+{
+    uint16_t fp = static_cast<uint16_t>(hash >> 48);
+    return fp == 0 ? 1 : fp;
+}
+
+size_t SerialFilter::alt_bucket(size_t bucket, uint16_t fingerprint) const
+{
+    return (bucket ^ (fingerprint * 0x5bd1e995ULL)) & bucket_mask;
+}
+
+bool SerialFilter::insert_into(size_t bucket, uint16_t fingerprint)
+{
+    for (int i = 0; i < SLOTS_PER_BUCKET; i++)
+    {
+        uint16_t &slot = slots[bucket * SLOTS_PER_BUCKET + i];
+        if (slot == 0)
+        {
+            slot = fingerprint;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool SerialFilter::remove_from(size_t bucket, uint16_t fingerprint)
+{
+    for (int i = 0; i < SLOTS_PER_BUCKET; i++)
+    {
+        uint16_t &slot = slots[bucket * SLOTS_PER_BUCKET + i];
+        if (slot == fingerprint)
+        {
+            slot = 0;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool SerialFilter::bucket_contains(size_t bucket, uint16_t fingerprint) const
+{
+    const uint16_t *bucket_slots = &slots[bucket * SLOTS_PER_BUCKET];
+    return bucket_slots[0] == fingerprint || bucket_slots[1] == fingerprint || bucket_slots[2] == fingerprint ||
+           bucket_slots[3] == fingerprint;
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include "WarmStart.h"
+#include <atomic>
+#include <cstdint>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+
+// Case-insensitive cuckoo filter over serial numbers. might_contain() never returns a false negative
+// for a serial that was added and not removed, so a negative answer can skip SQLite entirely.
+// Unlike a Bloom filter it supports exact removal, which keeps it current across delete_device.
+class SerialFilter
+{
+public:
+    SerialFilter();
+    ~SerialFilter();
+
+    // Empties the filter and sizes it for `expected_items`. It answers "maybe" until mark_ready().
+    void reset(size_t expected_items);
+    void mark_ready();
+
+    bool add(const std::string &serial_number); // false when the filter is full and must be rebuilt larger
+    void remove(const std::string &serial_number);
+    bool might_contain(const std::string &serial_number) const;
+
+    // Image for the warm-start file. restore() leaves the filter untouched and returns false if the image is
+    // malformed or was saved while the filter was not ready.
+    void save(WarmStartWriter &out) const;
+    bool restore(WarmStartReader &in);
+
+    size_t size() const;
+    size_t capacity() const;
+    size_t memory_bytes() const;
+    double expected_false_positive_rate() const;
+
+private:
+    static const int SLOTS_PER_BUCKET = 4;
+    static const int MAX_KICKS = 500;
+
+    mutable std::shared_mutex mutex;
+    std::vector<uint16_t> slots; // 0 marks an empty slot
+    size_t bucket_mask;
+    size_t item_count;
+    uint16_t victim_fingerprint; // fingerprint that could not be placed after MAX_KICKS, 0 if none
+    size_t victim_bucket;
+    std::atomic<bool> ready;
+
+    static uint64_t hash(const std::string &serial_number);
+    static uint16_t fingerprint(uint64_t hash);
+    size_t alt_bucket(size_t bucket, uint16_t fingerprint) const;
+    bool insert_into(size_t bucket, uint16_t fingerprint);
+    bool remove_from(size_t bucket, uint16_t fingerprint);
+    bool bucket_contains(size_t bucket, uint16_t fingerprint) const;
+};
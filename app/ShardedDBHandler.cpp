@@ -0,0 +1,703 @@
+#include "ShardedDBHandler.h"
+#include "TextKernels.h"
+#include <cstdio>
+#include <fstream>
+#include <future>
+
+namespace
+{
+    void shard_function(sqlite3_context *context, int, sqlite3_value **argv)
+    {
+        const unsigned char *serial_number = sqlite3_value_text(argv[0]);
+        size_t shard_count = *static_cast<size_t *>(sqlite3_user_data(context));
+        std::string serial(serial_number ? reinterpret_cast<const char *>(serial_number) : "");
+        sqlite3_result_int64(context, ShardedDBHandler::shard_of(serial, shard_count));
+    }
+
+    // Whether a comes before b in `order`: by the sort key under its column's collation, then by serial number,
+    // as the shards' sort indexes order them.
+    bool sorts_before(const Device &a, const Device &b, const DeviceOrder &order)
+    {
+        int compared = 0;
+        if (order.sort == SORT_NAME)
+        {
+            compared = TextKernels::compare_nocase(a.name, b.name);
+        }
+        else if (order.sort == SORT_CREATION_DATE)
+        {
+            compared = a.creation_date.compare(b.creation_date);
+        }
+        if (compared == 0)
+        {
+            compared = TextKernels::compare_nocase(a.serial_number, b.serial_number);
+        }
+        return order.descending ? compared > 0 : compared < 0;
+    }
+
+    DeviceRow row_of(const Device &device)
+    {
+        return {device.serial_number, device.name, device.type.str(), device.creation_date, device.location_id,
+                device.location_name.str(), device.location_type.str()};
+    }
+
+    void append_devices(std::vector<Device> &devices, std::vector<std::vector<Device>> &&parts)
+    {
+        size_t total = devices.size();
+        for (const auto &part : parts)
+        {
+            total += part.size();
+        }
+        devices.reserve(total);
+        for (auto &part : parts)
+        {
+            std::move(part.begin(), part.end(), std::back_inserter(devices));
+        }
+    }
+}
+
+ShardedDBHandler::ShardedDBHandler(const std::string &db_path, int shard_count, int read_connections, bool columnar_snapshot,
+                                   bool warm_start)
+    : DBHandler(shard_path(db_path, 0)), source_path(db_path)
+{
+    // Every shard reports to this handler's profiler, which explains slow statements against shard 0;
+    // all shards have the same schema.
+    for (int i = 0; i < shard_count; i++)
+    {
+        shards.push_back(std::make_unique<DBHandler>(shard_path(db_path, i), read_connections, columnar_snapshot, warm_start));
+        shards.back()->trace_owner = this;
+    }
+}
+
+ShardedDBHandler::~ShardedDBHandler()
+{
+    close_connection();
+}
+
+bool ShardedDBHandler::open_connection()
+{
+    size_t existing = 0;
+    for (size_t i = 0; i < shards.size(); i++)
+    {
+        existing += std::ifstream(shard_path(source_path, i)).good();
+    }
+    if (existing == 0 && !create_shards())
+    {
+        return false;
+    }
+    if (existing != 0 && existing != shards.size())
+    {
+        std::cerr << "Found " << existing << " of " << shards.size() << " shard files for " << source_path << std::endl;
+        return false;
+    }
+
+    for (size_t i = 0; i < shards.size(); i++)
+    {
+        if (!shards[i]->open_connection() || !check_shard(i))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void ShardedDBHandler::close_connection()
+{
+    for (auto &shard : shards)
+    {
+        shard->close_connection();
+    }
+}
+
+// Runs `operation` on every shard concurrently and returns the results in shard order.
+template <typename Result, typename Operation>
+std::vector<Result> ShardedDBHandler::fan_out(Operation operation)
+{
+    std::vector<std::future<Result>> futures;
+    for (auto &shard : shards)
+    {
+        futures.push_back(std::async(std::launch::async, operation, std::ref(*shard)));
+    }
+    std::vector<Result> results;
+    for (auto &future : futures)
+    {
+        results.push_back(future.get());
+    }
+    return results;
+}
+
+// Makes one visitor per shard, then visits the shards concurrently, each with its own visitor.
+template <typename Visit>
+size_t ShardedDBHandler::visit_parts(const DevicePartVisitors &visitors, Visit visit)
+{
+    std::vector<DeviceVisitor> parts;
+    for (size_t i = 0; i < shards.size(); i++)
+    {
+        parts.push_back(visitors(i, shards.size()));
+    }
+    std::vector<std::future<size_t>> futures;
+    for (size_t i = 0; i < shards.size(); i++)
+    {
+        futures.push_back(std::async(std::launch::async, [&visit, &parts, this, i]
+                                     { return visit(*shards[i], parts[i]); }));
+    }
+    size_t rows = 0;
+    for (auto &future : futures)
+    {
+        rows += future.get();
+    }
+    return rows;
+}
+
+// Sorted listings: every shard collects its first order.limit rows (all of them without a limit) in order, in
+// parallel, and the visitor gets the merge of those lists, cut to the limit.
+template <typename Visit>
+size_t ShardedDBHandler::visit_merged(const DeviceOrder &order, const DeviceVisitor &visitor, Visit visit)
+{
+    std::vector<std::vector<Device>> parts = fan_out<std::vector<Device>>([&visit](DBHandler &shard)
+                                                                          {
+                                                                              std::vector<Device> devices;
+                                                                              visit(shard, [&devices](const DeviceRow &row)
+                                                                                    { devices.push_back(row.to_device()); });
+                                                                              return devices; });
+    std::vector<size_t> next(parts.size(), 0);
+    size_t rows = 0;
+    while (order.limit == 0 || rows < order.limit)
+    {
+        size_t first = parts.size();
+        for (size_t i = 0; i < parts.size(); i++)
+        {
+            if (next[i] < parts[i].size() && (first == parts.size() || sorts_before(parts[i][next[i]], parts[first][next[first]], order)))
+            {
+                first = i;
+            }
+        }
+        if (first == parts.size())
+        {
+            break;
+        }
+        visitor(row_of(parts[first][next[first]++]));
+        rows++;
+    }
+    return rows;
+}
+
+// DEVICES TABLE OPERATIONS
+// 1. List all devices: every shard in parallel, concatenated in shard order.
+std::vector<Device> ShardedDBHandler::get_devices()
+{
+    std::vector<Device> devices;
+    append_devices(devices, fan_out<std::vector<Device>>([](DBHandler &shard)
+                                                         { return shard.get_devices(); }));
+    return devices;
+}
+
+// 2. Filter by metadata. A serial number pins the filter to one shard.
+std::vector<Device> ShardedDBHandler::filter_devices(const std::string &serial_number, const std::string &name, const std::string &type,
+                                                     const std::string &creation_date, const std::string &location_id, const std::string &start_date,
+                                                     const std::string &end_date, const std::string &location_name, const std::string &location_type)
+{
+    if (!serial_number.empty())
+    {
+        return shard_for(serial_number).filter_devices(serial_number, name, type, creation_date, location_id, start_date, end_date, location_name, location_type);
+    }
+
+    std::vector<Device> devices;
+    append_devices(devices, fan_out<std::vector<Device>>([&](DBHandler &shard)
+                                                         { return shard.filter_devices(serial_number, name, type, creation_date, location_id, start_date,
+                                                                                       end_date, location_name, location_type); }));
+    return devices;
+}
+
+// Visitors see one shard after another: rows reach the visitor from a single thread, in shard order. A limit is
+// shared, each shard being asked only for the rows still missing. Sorted listings are merged (see visit_merged).
+size_t ShardedDBHandler::visit_devices(const DeviceVisitor &visitor, const DeviceOrder &order)
+{
+    if (order.sort != SORT_NONE)
+    {
+        return visit_merged(order, visitor, [&order](DBHandler &shard, const DeviceVisitor &collect)
+                            { return shard.visit_devices(collect, order); });
+    }
+
+    size_t rows = 0;
+    for (size_t i = 0; i < shards.size() && (order.limit == 0 || rows < order.limit); i++)
+    {
+        DeviceOrder remaining = order;
+        remaining.limit = order.limit == 0 ? 0 : order.limit - rows;
+        rows += shards[i]->visit_devices(visitor, remaining);
+    }
+    return rows;
+}
+
+size_t ShardedDBHandler::visit_filtered_devices(const std::string &serial_number, const std::string &name, const std::string &type,
+                                                const std::string &creation_date, const std::string &location_id, const std::string &start_date,
+                                                const std::string &end_date, const std::string &location_name, const std::string &location_type,
+                                                const DeviceVisitor &visitor, const DeviceOrder &order)
+{
+    if (!serial_number.empty())
+    {
+        return shard_for(serial_number).visit_filtered_devices(serial_number, name, type, creation_date, location_id, start_date, end_date,
+                                                               location_name, location_type, visitor, order);
+    }
+    if (order.sort != SORT_NONE)
+    {
+        return visit_merged(order, visitor, [&](DBHandler &shard, const DeviceVisitor &collect)
+                            { return shard.visit_filtered_devices(serial_number, name, type, creation_date, location_id, start_date, end_date,
+                                                                  location_name, location_type, collect, order); });
+    }
+
+    size_t rows = 0;
+    for (size_t i = 0; i < shards.size() && (order.limit == 0 || rows < order.limit); i++)
+    {
+        DeviceOrder remaining = order;
+        remaining.limit = order.limit == 0 ? 0 : order.limit - rows;
+        rows += shards[i]->visit_filtered_devices(serial_number, name, type, creation_date, location_id, start_date, end_date, location_name,
+                                                  location_type, visitor, remaining);
+    }
+    return rows;
+}
+
+// Listings in storage order without a limit visit every shard in parallel, shard i as part i. Sorted or limited
+// ones are a single part (see visit_devices).
+size_t ShardedDBHandler::visit_device_parts(const DevicePartVisitors &visitors, const DeviceOrder &order)
+{
+    if (order.sort != SORT_NONE || order.limit > 0)
+    {
+        return visit_devices(visitors(0, 1), order);
+    }
+    return visit_parts(visitors, [](DBHandler &shard, const DeviceVisitor &visitor)
+                       { return shard.visit_devices(visitor); });
+}
+
+size_t ShardedDBHandler::visit_filtered_device_parts(const std::string &serial_number, const std::string &name, const std::string &type,
+                                                     const std::string &creation_date, const std::string &location_id, const std::string &start_date,
+                                                     const std::string &end_date, const std::string &location_name, const std::string &location_type,
+                                                     const DevicePartVisitors &visitors, const DeviceOrder &order)
+{
+    if (!serial_number.empty() || order.sort != SORT_NONE || order.limit > 0)
+    {
+        return visit_filtered_devices(serial_number, name, type, creation_date, location_id, start_date, end_date, location_name, location_type,
+                                      visitors(0, 1), order);
+    }
+    return visit_parts(visitors, [&](DBHandler &shard, const DeviceVisitor &visitor)
+                       { return shard.visit_filtered_devices(serial_number, name, type, creation_date, location_id, start_date, end_date,
+                                                             location_name, location_type, visitor); });
+}
+
+// 3. Add new device
+bool ShardedDBHandler::add_device(const Device &device)
+{
+    return shard_for(device.serial_number).add_device(device);
+}
+
+// 4. Update a device
+bool ShardedDBHandler::update_device(const std::string &serial_number, const std::string &name, const std::string &type,
+                                     const std::string &creation_date, const std::string &location_id)
+{
+    return shard_for(serial_number).update_device(serial_number, name, type, creation_date, location_id);
+}
+
+// 5. Delete a device
+bool ShardedDBHandler::delete_device(const std::string &serial_number)
+{
+    return shard_for(serial_number).delete_device(serial_number);
+}
+
+// 6. Look up a batch of devices: each shard resolves its own serials, in parallel.
+std::vector<Device> ShardedDBHandler::lookup_devices(const std::vector<std::string> &serial_numbers)
+{
+    auto parts = partition(serial_numbers);
+    std::vector<std::future<std::vector<Device>>> futures;
+    for (size_t i = 0; i < shards.size(); i++)
+    {
+        if (!parts[i].empty())
+        {
+            futures.push_back(std::async(std::launch::async, [this, &parts, i]
+                                         { return shards[i]->lookup_devices(parts[i]); }));
+        }
+    }
+    std::vector<std::vector<Device>> results;
+    for (auto &future : futures)
+    {
+        results.push_back(future.get());
+    }
+
+    std::vector<Device> devices;
+    append_devices(devices, std::move(results));
+    return devices;
+}
+
+// 7. Move every device matching the filters. Each shard commits its own UPDATE, so the move is atomic per shard only.
+int ShardedDBHandler::relocate_devices(const std::string &serial_number, const std::string &type, const std::string &start_date,
+                                       const std::string &end_date, const std::string &location_name, const std::string &location_type,
+                                       const std::string &location_id, int target_location_id)
+{
+    if (!serial_number.empty())
+    {
+        return shard_for(serial_number).relocate_devices(serial_number, type, start_date, end_date, location_name, location_type, location_id, target_location_id);
+    }
+
+    int relocated = 0;
+    for (int count : fan_out<int>([&](DBHandler &shard)
+                                  { return shard.relocate_devices(serial_number, type, start_date, end_date, location_name, location_type,
+                                                                  location_id, target_location_id); }))
+    {
+        if (count < 0)
+        {
+            return -1;
+        }
+        relocated += count;
+    }
+    return relocated;
+}
+
+// 8. Move a list of devices, one transaction per shard.
+int ShardedDBHandler::relocate_devices(const std::vector<std::string> &serial_numbers, int target_location_id)
+{
+    auto parts = partition(serial_numbers);
+    int relocated = 0;
+    for (size_t i = 0; i < shards.size(); i++)
+    {
+        if (parts[i].empty())
+        {
+            continue;
+        }
+        int count = shards[i]->relocate_devices(parts[i], target_location_id);
+        if (count < 0)
+        {
+            return -1;
+        }
+        relocated += count;
+    }
+    return relocated;
+}
+
+// 9. A device's history lives in the shard its serial number hashes to.
+std::vector<DeviceVersion> ShardedDBHandler::get_device_history(const std::string &serial_number)
+{
+    return shard_for(serial_number).get_device_history(serial_number);
+}
+
+// 10. Version of a device at a point in time
+bool ShardedDBHandler::get_device_as_of(const std::string &serial_number, int64_t as_of, DeviceVersion &version)
+{
+    return shard_for(serial_number).get_device_as_of(serial_number, as_of, version);
+}
+
+// LOCATIONS TABLE OPERATIONS
+// Locations are replicated: reads use shard 0, writes are applied to every shard under location_mutex.
+// 1. List all locations
+std::vector<Location> ShardedDBHandler::get_locations()
+{
+    return shards[0]->get_locations();
+}
+
+// 2. Add new location: shard 0 assigns the id, the other shards reuse it.
+bool ShardedDBHandler::add_location(const Location &location)
+{
+    std::lock_guard<std::mutex> lock(location_mutex);
+    if (!shards[0]->add_location(location))
+    {
+        return false;
+    }
+    Location replica = location;
+    if (replica.id == -1)
+    {
+        // Device tables are WITHOUT ROWID, so the last rowid on shard 0 is still the new location's.
+        replica.id = static_cast<int>(sqlite3_last_insert_rowid(shards[0]->db));
+    }
+    for (size_t i = 1; i < shards.size(); i++)
+    {
+        if (!shards[i]->add_location(replica))
+        {
+            std::cerr << "Failed to replicate location " << replica.id << " to shard " << i << std::endl;
+            return false;
+        }
+    }
+    publish({{"op", "add_location"}, {"location", {{"id", replica.id}, {"name", replica.name}, {"type", replica.type}}}});
+    return true;
+}
+
+// 3. Update a location
+bool ShardedDBHandler::update_location(const int id, const std::string &name, const std::string &type)
+{
+    std::lock_guard<std::mutex> lock(location_mutex);
+    for (size_t i = 0; i < shards.size(); i++)
+    {
+        if (!shards[i]->update_location(id, name, type))
+        {
+            std::cerr << "Failed to update location " << id << " on shard " << i << std::endl;
+            return false;
+        }
+    }
+    publish({{"op", "update_location"}, {"id", id}, {"name", name}, {"type", type}});
+    return true;
+}
+
+// 4. Delete a location and, on each shard, the devices at it.
+bool ShardedDBHandler::delete_location(const int id)
+{
+    std::lock_guard<std::mutex> lock(location_mutex);
+    bool deleted = true;
+    for (bool shard_deleted : fan_out<bool>([id](DBHandler &shard)
+                                            { return shard.delete_location(id); }))
+    {
+        deleted = deleted && shard_deleted;
+    }
+    if (deleted)
+    {
+        publish({{"op", "delete_location"}, {"id", id}});
+    }
+    return deleted;
+}
+
+// HELPER METHODS
+// public methods
+bool ShardedDBHandler::serial_num_exists(std::string &serial_num)
+{
+    return shard_for(serial_num).serial_num_exists(serial_num);
+}
+
+bool ShardedDBHandler::location_exists(int location_id)
+{
+    return shards[0]->location_exists(location_id);
+}
+
+// Device mutations are published by the shard that commits them, location mutations once by this handler.
+void ShardedDBHandler::set_mutation_listener(MutationListener listener)
+{
+    {
+        std::lock_guard<std::mutex> lock(location_mutex);
+        mutation_listener = listener;
+    }
+    for (auto &shard : shards)
+    {
+        shard->set_mutation_listener([listener](const json &mutation)
+                                     {
+                                         if (listener && mutation["op"].get<std::string>().find("_location") == std::string::npos)
+                                         {
+                                             listener(mutation);
+                                         } });
+    }
+}
+
+// Merges the shards into one single-file registry while all writes are held, so any follower can load it.
+bool ShardedDBHandler::snapshot(const std::string &path, const std::function<void()> &at_snapshot)
+{
+    std::lock_guard<std::mutex> lock(location_mutex);
+    std::vector<std::unique_lock<std::mutex>> shard_locks;
+    for (auto &shard : shards)
+    {
+        shard_locks.emplace_back(shard->write_mutex);
+    }
+
+    sqlite3_stmt *stmt;
+    int rc = sqlite3_prepare_v2(shards[0]->db, "VACUUM INTO ?", -1, &stmt, NULL);
+    if (rc != SQLITE_OK)
+    {
+        std::cerr << "Error preparing SQL statement: " << sqlite3_errmsg(shards[0]->db) << std::endl;
+        return false;
+    }
+    sqlite3_bind_text(stmt, 1, path.c_str(), -1, SQLITE_STATIC);
+    rc = sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+
+    if (rc != SQLITE_DONE)
+    {
+        std::cerr << "Error writing snapshot: " << sqlite3_errmsg(shards[0]->db) << std::endl;
+        return false;
+    }
+
+    sqlite3 *snapshot_db;
+    // The merged devices keep the history their shards recorded, so the history triggers go until the file is
+    // next opened as a registry, when migrate_schema adds them back.
+    bool merged = sqlite3_open(path.c_str(), &snapshot_db) == SQLITE_OK &&
+                  sqlite3_exec(snapshot_db, "DROP TABLE shard_info; DROP TRIGGER IF EXISTS devices_history_insert;"
+                                            "DROP TRIGGER IF EXISTS devices_history_update; DROP TRIGGER IF EXISTS devices_history_rename;"
+                                            "DROP TRIGGER IF EXISTS devices_history_delete",
+                               NULL, NULL, NULL) == SQLITE_OK;
+    for (size_t i = 1; merged && i < shards.size(); i++)
+    {
+        std::string shard_file = shard_path(source_path, i);
+        merged = sqlite3_prepare_v2(snapshot_db, "ATTACH DATABASE ? AS shard", -1, &stmt, NULL) == SQLITE_OK;
+        if (merged)
+        {
+            sqlite3_bind_text(stmt, 1, shard_file.c_str(), -1, SQLITE_STATIC);
+            merged = sqlite3_step(stmt) == SQLITE_DONE;
+            sqlite3_finalize(stmt);
+        }
+        merged = merged && sqlite3_exec(snapshot_db, "INSERT INTO devices SELECT * FROM shard.devices;"
+                                                     "INSERT INTO device_history (serial_number, changed_at, op, name, type, creation_date, location_id, "
+                                                     "location_name, location_type) SELECT serial_number, changed_at, op, name, type, creation_date, "
+                                                     "location_id, location_name, location_type FROM shard.device_history;"
+                                                     "DETACH DATABASE shard",
+                                        NULL, NULL, NULL) == SQLITE_OK;
+    }
+    if (!merged)
+    {
+        std::cerr << "Error writing snapshot: " << sqlite3_errmsg(snapshot_db) << std::endl;
+    }
+    sqlite3_close(snapshot_db);
+
+    if (merged)
+    {
+        at_snapshot();
+    }
+    return merged;
+}
+
+// Each shard has its own warm-start file and token.
+bool ShardedDBHandler::save_warm_start()
+{
+    bool saved = true;
+    for (bool shard_saved : fan_out<bool>([](DBHandler &shard)
+                                          { return shard.save_warm_start(); }))
+    {
+        saved = saved && shard_saved;
+    }
+    return saved;
+}
+
+std::vector<DBHandler *> ShardedDBHandler::registry_files()
+{
+    std::vector<DBHandler *> files;
+    for (auto &shard : shards)
+    {
+        files.push_back(shard.get());
+    }
+    return files;
+}
+
+// FNV-1a over the ASCII-lowercased serial, mapped onto the shards by multiply-shift. SerialFilter hashes the
+// same bytes differently, so each shard's filter still spreads its serials over all of its buckets.
+size_t ShardedDBHandler::shard_of(const std::string &serial_number, size_t shard_count)
+{
+    uint32_t hash = 2166136261u;
+    for (unsigned char c : serial_number)
+    {
+        hash ^= c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c;
+        hash *= 16777619u;
+    }
+    return (static_cast<uint64_t>(hash) * shard_count) >> 32;
+}
+
+std::string ShardedDBHandler::shard_path(const std::string &db_path, size_t shard)
+{
+    size_t dot = db_path.rfind('.');
+    size_t slash = db_path.rfind('/');
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+    {
+        dot = db_path.size();
+    }
+    return db_path.substr(0, dot) + ".shard" + std::to_string(shard) + db_path.substr(dot);
+}
+
+// private methods
+DBHandler &ShardedDBHandler::shard_for(const std::string &serial_number)
+{
+    return *shards[shard_of(serial_number, shards.size())];
+}
+
+// Partitions the single-file registry at source_path: schema and locations are copied to every shard,
+// each device goes to the shard its serial number hashes to.
+bool ShardedDBHandler::create_shards()
+{
+    if (!std::ifstream(source_path).good())
+    {
+        std::cerr << "Cannot create shards: " << source_path << " does not exist" << std::endl;
+        return false;
+    }
+
+    size_t shard_count = shards.size();
+    for (size_t i = 0; i < shard_count; i++)
+    {
+        std::string path = shard_path(source_path, i);
+        sqlite3 *shard_db;
+        bool created = sqlite3_open(path.c_str(), &shard_db) == SQLITE_OK;
+        sqlite3_create_function(shard_db, "registry_shard", 1, SQLITE_UTF8 | SQLITE_DETERMINISTIC, &shard_count, &shard_function, NULL, NULL);
+
+        sqlite3_stmt *stmt;
+        if (created && sqlite3_prepare_v2(shard_db, "ATTACH DATABASE ? AS source", -1, &stmt, NULL) == SQLITE_OK)
+        {
+            sqlite3_bind_text(stmt, 1, source_path.c_str(), -1, SQLITE_STATIC);
+            created = sqlite3_step(stmt) == SQLITE_DONE;
+            sqlite3_finalize(stmt);
+        }
+        // A new file can still take incremental auto-vacuum (see MaintenanceScheduler); it must be set before the first table.
+        created = created && sqlite3_exec(shard_db, "PRAGMA auto_vacuum = INCREMENTAL;BEGIN", NULL, NULL, NULL) == SQLITE_OK;
+
+        // Tables first so that indexes find them. Triggers are left to migrate_schema when the shard opens, so the
+        // copied devices do not get a second add entry in device_history.
+        std::vector<std::string> schema;
+        bool has_history = false;
+        if (created && sqlite3_prepare_v2(shard_db, "SELECT sql, name FROM source.sqlite_master WHERE sql IS NOT NULL AND name NOT LIKE 'sqlite_%' "
+                                                    "AND type != 'trigger' ORDER BY type != 'table'",
+                                          -1, &stmt, NULL) == SQLITE_OK)
+        {
+            while (sqlite3_step(stmt) == SQLITE_ROW)
+            {
+                schema.push_back(reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0)));
+                has_history = has_history || std::string(reinterpret_cast<const char *>(sqlite3_column_text(stmt, 1))) == "device_history";
+            }
+            sqlite3_finalize(stmt);
+        }
+        for (const auto &sql : schema)
+        {
+            created = created && sqlite3_exec(shard_db, sql.c_str(), NULL, NULL, NULL) == SQLITE_OK;
+        }
+
+        std::string shard_filter = "WHERE registry_shard(serial_number) = " + std::to_string(i) + ";";
+        std::string copy = "INSERT INTO locations SELECT * FROM source.locations;"
+                           "INSERT INTO devices SELECT * FROM source.devices " + shard_filter +
+                           (has_history ? "INSERT INTO device_history SELECT * FROM source.device_history " + shard_filter : "") +
+                           "CREATE TABLE shard_info (shard_index INTEGER NOT NULL, shard_count INTEGER NOT NULL);"
+                           "INSERT INTO shard_info VALUES (" + std::to_string(i) + ", " + std::to_string(shard_count) + ");"
+                           "COMMIT;";
+        created = created && sqlite3_exec(shard_db, copy.c_str(), NULL, NULL, NULL) == SQLITE_OK;
+        if (!created)
+        {
+            std::cerr << "Error creating shard " << path << ": " << sqlite3_errmsg(shard_db) << std::endl;
+        }
+        sqlite3_close(shard_db);
+
+        if (!created)
+        {
+            for (size_t j = 0; j <= i; j++)
+            {
+                std::remove(shard_path(source_path, j).c_str());
+            }
+            return false;
+        }
+    }
+    std::cerr << "Partitioned " << source_path << " into " << shard_count << " shards." << std::endl;
+    return true;
+}
+
+// Refuses shard files that were partitioned for a different shard count, which would route serials to the wrong file.
+bool ShardedDBHandler::check_shard(size_t shard)
+{
+    sqlite3_stmt *stmt;
+    int rc = sqlite3_prepare_v2(shards[shard]->db, "SELECT shard_index, shard_count FROM shard_info", -1, &stmt, NULL);
+    if (rc != SQLITE_OK)
+    {
+        std::cerr << "Error preparing SQL statement: " << sqlite3_errmsg(shards[shard]->db) << std::endl;
+        return false;
+    }
+    bool valid = sqlite3_step(stmt) == SQLITE_ROW && static_cast<size_t>(sqlite3_column_int64(stmt, 0)) == shard &&
+                 static_cast<size_t>(sqlite3_column_int64(stmt, 1)) == shards.size();
+    sqlite3_finalize(stmt);
+    if (!valid)
+    {
+        std::cerr << shard_path(source_path, shard) << " does not belong to a registry with " << shards.size() << " shards" << std::endl;
+    }
+    return valid;
+}
+
+std::vector<std::vector<std::string>> ShardedDBHandler::partition(const std::vector<std::string> &serial_numbers)
+{
+    std::vector<std::vector<std::string>> parts(shards.size());
+    for (const auto &serial_number : serial_numbers)
+    {
+        parts[shard_of(serial_number, shards.size())].push_back(serial_number);
+    }
+    return parts;
+}
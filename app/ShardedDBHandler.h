@@ -0,0 +1,79 @@
+#pragma once
+#include "DBHandler.h"
+#include <memory>
+
+// Spreads devices over `shard_count` SQLite files by a hash of the case-folded serial number, so writes to
+// different shards run on separate connections and locks. Every shard holds a full copy of the locations table.
+// Point operations go to one shard; listing, filtering and relocation fan out to all shards in parallel.
+//
+// Shard k of registry.db lives in registry.shard<k>.db. When no shard file exists yet, open_connection()
+// partitions the single-file registry at db_path into them.
+class ShardedDBHandler : public DBHandler
+{
+public:
+    ShardedDBHandler(const std::string &db_path, int shard_count, int read_connections = 0, bool columnar_snapshot = false,
+                     bool warm_start = false);
+    ~ShardedDBHandler() override;
+    bool open_connection() override;
+    void close_connection() override;
+
+    // DEVICES TABLE OPERATIONS
+    std::vector<Device> get_devices() override;
+    std::vector<Device> filter_devices(const std::string &serial_number, const std::string &name, const std::string &type,
+                                       const std::string &creation_date, const std::string &location_id, const std::string &start_date,
+                                       const std::string &end_date, const std::string &location_name, const std::string &location_type) override;
+    size_t visit_devices(const DeviceVisitor &visitor, const DeviceOrder &order = DeviceOrder()) override;
+    size_t visit_filtered_devices(const std::string &serial_number, const std::string &name, const std::string &type,
+                                  const std::string &creation_date, const std::string &location_id, const std::string &start_date,
+                                  const std::string &end_date, const std::string &location_name, const std::string &location_type,
+                                  const DeviceVisitor &visitor, const DeviceOrder &order = DeviceOrder()) override;
+    size_t visit_device_parts(const DevicePartVisitors &visitors, const DeviceOrder &order = DeviceOrder()) override;
+    size_t visit_filtered_device_parts(const std::string &serial_number, const std::string &name, const std::string &type,
+                                       const std::string &creation_date, const std::string &location_id, const std::string &start_date,
+                                       const std::string &end_date, const std::string &location_name, const std::string &location_type,
+                                       const DevicePartVisitors &visitors, const DeviceOrder &order = DeviceOrder()) override;
+    bool add_device(const Device &device) override;
+    bool update_device(const std::string &serial_number, const std::string &name, const std::string &type,
+                       const std::string &creation_date, const std::string &location_id) override;
+    bool delete_device(const std::string &serial_number) override;
+    std::vector<Device> lookup_devices(const std::vector<std::string> &serial_numbers) override;
+    int relocate_devices(const std::string &serial_number, const std::string &type, const std::string &start_date,
+                         const std::string &end_date, const std::string &location_name, const std::string &location_type,
+                         const std::string &location_id, int target_location_id) override;
+    int relocate_devices(const std::vector<std::string> &serial_numbers, int target_location_id) override;
+    std::vector<DeviceVersion> get_device_history(const std::string &serial_number) override;
+    bool get_device_as_of(const std::string &serial_number, int64_t as_of, DeviceVersion &version) override;
+
+    // LOCATIONS TABLE OPERATIONS
+    std::vector<Location> get_locations() override;
+    bool add_location(const Location &location) override;
+    bool update_location(const int id, const std::string &name, const std::string &type) override;
+    bool delete_location(const int id) override;
+
+    // Helper methods
+    bool serial_num_exists(std::string &serial_num) override;
+    bool location_exists(int location_id) override;
+    void set_mutation_listener(MutationListener listener) override;
+    bool snapshot(const std::string &path, const std::function<void()> &at_snapshot) override;
+    bool save_warm_start() override;
+    std::vector<DBHandler *> registry_files() override;
+
+    static size_t shard_of(const std::string &serial_number, size_t shard_count);
+    static std::string shard_path(const std::string &db_path, size_t shard);
+
+private:
+    std::string source_path;
+    std::vector<std::unique_ptr<DBHandler>> shards;
+    std::mutex location_mutex; // keeps location writes in the same order on every shard
+
+    DBHandler &shard_for(const std::string &serial_number);
+    bool create_shards();
+    bool check_shard(size_t shard);
+    std::vector<std::vector<std::string>> partition(const std::vector<std::string> &serial_numbers);
+    template <typename Result, typename Operation>
+    std::vector<Result> fan_out(Operation operation);
+    template <typename Visit>
+    size_t visit_parts(const DevicePartVisitors &visitors, Visit visit);
+    template <typename Visit>
+    size_t visit_merged(const DeviceOrder &order, const DeviceVisitor &visitor, Visit visit);
+};
@@ -0,0 +1,81 @@
+#include "StringPool.h"
+#include "Metrics.h"
+#include <mutex>
+
+namespace
+{
+    const std::string &empty_string()
+    {
+        static const std::string empty;
+        return empty;
+    }
+}
+
+InternedString::InternedString() : value(&empty_string()) {}
+
+InternedString::InternedString(const std::string &value) : InternedString(StringPool::instance().intern(value)) {}
+
+InternedString::InternedString(const char *value) : InternedString(StringPool::instance().intern(value)) {}
+
+StringPool &StringPool::instance()
+{
+    static StringPool pool;
+    return pool;
+}
+
+StringPool::StringPool() : bytes(0)
+{
+    index.emplace(std::string_view(), &empty_string());
+}
+
+// Each thread first checks its own copy of the index, which needs no lock because pooled strings are never
+// released. The shared index is consulted on a local miss; a new value re-checks under the exclusive lock.
+InternedString StringPool::intern(std::string_view value)
+{
+    thread_local std::unordered_map<std::string_view, const std::string *> local_index;
+    auto local = local_index.find(value);
+    if (local != local_index.end())
+    {
+        return InternedString(local->second);
+    }
+    InternedString interned = intern_shared(value);
+    local_index.emplace(std::string_view(interned.str()), &interned.str());
+    return interned;
+}
+
+InternedString StringPool::intern_shared(std::string_view value)
+{
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        auto it = index.find(value);
+        if (it != index.end())
+        {
+            return InternedString(it->second);
+        }
+    }
+
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    auto it = index.find(value);
+    if (it != index.end())
+    {
+        return InternedString(it->second);
+    }
+    const std::string &pooled = strings.emplace_back(value);
+    index.emplace(std::string_view(pooled), &pooled);
+    size_t added = sizeof(std::string) + pooled.size();
+    bytes += added;
+    Metrics::instance().string_pool_grew(added);
+    return InternedString(&pooled);
+}
+
+size_t StringPool::size() const
+{
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    return strings.size();
+}
+
+size_t StringPool::memory_bytes() const
+{
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    return bytes;
+}
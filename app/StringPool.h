@@ -0,0 +1,62 @@
+#pragma once
+#include "json.hpp"
+#include <cstdint>
+#include <deque>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// Handle to a string held once by StringPool. Copies are a pointer copy, and two handles are equal exactly
+// when they point at the same pooled string, so equality never compares characters.
+class InternedString
+{
+public:
+    InternedString();
+    InternedString(const std::string &value); // interns value
+    InternedString(const char *value);
+
+    const std::string &str() const { return *value; }
+    const char *c_str() const { return value->c_str(); }
+    size_t size() const { return value->size(); }
+    bool empty() const { return value->empty(); }
+    operator const std::string &() const { return *value; }
+
+    bool operator==(const InternedString &other) const { return value == other.value; }
+    bool operator!=(const InternedString &other) const { return value != other.value; }
+
+private:
+    friend class StringPool;
+    explicit InternedString(const std::string *value) : value(value) {}
+
+    const std::string *value;
+};
+
+template <typename BasicJsonType>
+void to_json(BasicJsonType &j, const InternedString &value)
+{
+    j = value.str();
+}
+
+// Process-wide pool for low-cardinality device attributes (type, location name and type). Strings are never
+// released, so the pool holds one copy of every distinct value seen since startup; it is not meant for
+// unique values such as serial numbers or device names.
+class StringPool
+{
+public:
+    static StringPool &instance();
+
+    InternedString intern(std::string_view value);
+
+    size_t size() const;
+    size_t memory_bytes() const;
+
+private:
+    StringPool();
+    InternedString intern_shared(std::string_view value);
+
+    mutable std::shared_mutex mutex;
+    std::deque<std::string> strings; // deque keeps element addresses stable as it grows
+    std::unordered_map<std::string_view, const std::string *> index; // keys view into `strings`
+    size_t bytes;
+};
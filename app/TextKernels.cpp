@@ -0,0 +1,285 @@
+#include "TextKernels.h"
+#include "CpuFeatures.h"
+#include <algorithm>
+#include <cstring>
+
+#ifdef REGISTRY_X86
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    const uint64_t ONES = 0x0101010101010101ULL;
+    const uint64_t HIGH_BITS = 0x8080808080808080ULL;
+
+    uint64_t load_word(const char *text, size_t size, uint8_t padding)
+    {
+        uint64_t word = padding * ONES;
+        std::memcpy(&word, text, size < 8 ? size : 8);
+        return word;
+    }
+
+    // Sets the high bit of each byte of `word` (all bytes below 0x80) that is >= `low`; adding 0x80 - low
+    // cannot carry into the next byte.
+    uint64_t at_least(uint64_t word, uint8_t low)
+    {
+        return word + (0x80 - low) * ONES;
+    }
+
+    uint64_t fold_word(uint64_t word)
+    {
+        uint64_t heptets = word & ~HIGH_BITS;
+        uint64_t upper = ~word & (at_least(heptets, 'A') ^ at_least(heptets, 'Z' + 1)) & HIGH_BITS;
+        return word | (upper >> 2); // 0x80 >> 2 is the case bit
+    }
+
+    bool alphanumeric_word(uint64_t word)
+    {
+        uint64_t heptets = word & ~HIGH_BITS;
+        uint64_t lower = heptets | 0x20 * ONES;
+        uint64_t digit = at_least(heptets, '0') & ~at_least(heptets, '9' + 1);
+        uint64_t letter = at_least(lower, 'a') & ~at_least(lower, 'z' + 1);
+        return (~word & (digit | letter) & HIGH_BITS) == HIGH_BITS;
+    }
+
+    uint64_t mix(uint64_t hash, uint64_t word)
+    {
+        hash ^= word * 0x87c37b91114253d5ULL;
+        hash = (hash << 31) | (hash >> 33);
+        return hash * 0x4cf5ad432745937fULL;
+    }
+
+    uint64_t finish(uint64_t hash, size_t size)
+    {
+        hash ^= size;
+        hash ^= hash >> 33;
+        hash *= 0xff51afd7ed558ccdULL;
+        hash ^= hash >> 33;
+        hash *= 0xc4ceb9fe1a85ec53ULL;
+        hash ^= hash >> 33;
+        return hash;
+    }
+
+    // Scalar versions treat each 8 bytes as one word; the tail is padded with a byte that does not change
+    // the answer.
+    bool is_alphanumeric_scalar(const char *text, size_t size)
+    {
+        for (size_t i = 0; i < size; i += 8)
+        {
+            if (!alphanumeric_word(load_word(text + i, size - i, '0')))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void fold_case_scalar(const char *text, size_t size, char *out)
+    {
+        for (size_t i = 0; i < size; i += 8)
+        {
+            size_t n = size - i < 8 ? size - i : 8;
+            uint64_t word = fold_word(load_word(text + i, n, 0));
+            std::memcpy(out + i, &word, n);
+        }
+    }
+
+    bool equal_nocase_scalar(const char *a, const char *b, size_t size)
+    {
+        for (size_t i = 0; i < size; i += 8)
+        {
+            if (fold_word(load_word(a + i, size - i, 0)) != fold_word(load_word(b + i, size - i, 0)))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    uint64_t hash_nocase_scalar(const char *text, size_t size)
+    {
+        uint64_t hash = 0;
+        for (size_t i = 0; i < size; i += 8)
+        {
+            hash = mix(hash, fold_word(load_word(text + i, size - i, 0)));
+        }
+        return finish(hash, size);
+    }
+
+#ifdef REGISTRY_X86
+    // 32 bytes per step; the last size % 32 bytes go through the scalar word path. Signed byte compares leave
+    // bytes >= 0x80 (negative) out of every ASCII range.
+    __attribute__((target("avx2"))) __m256i in_range(__m256i bytes, char low, char high)
+    {
+        return _mm256_and_si256(_mm256_cmpgt_epi8(bytes, _mm256_set1_epi8(low - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8(high + 1), bytes));
+    }
+
+    __attribute__((target("avx2"))) __m256i fold_block(__m256i bytes)
+    {
+        __m256i upper = in_range(bytes, 'A', 'Z');
+        return _mm256_or_si256(bytes, _mm256_and_si256(upper, _mm256_set1_epi8(0x20)));
+    }
+
+    __attribute__((target("avx2"))) __m256i load_block(const char *text)
+    {
+        return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(text));
+    }
+
+    __attribute__((target("avx2"))) bool is_alphanumeric_avx2(const char *text, size_t size)
+    {
+        size_t i = 0;
+        for (; i + 32 <= size; i += 32)
+        {
+            __m256i bytes = load_block(text + i);
+            __m256i lower = _mm256_or_si256(bytes, _mm256_set1_epi8(0x20));
+            __m256i ok = _mm256_or_si256(in_range(bytes, '0', '9'), in_range(lower, 'a', 'z'));
+            if (_mm256_movemask_epi8(ok) != -1)
+            {
+                return false;
+            }
+        }
+        return is_alphanumeric_scalar(text + i, size - i);
+    }
+
+    __attribute__((target("avx2"))) void fold_case_avx2(const char *text, size_t size, char *out)
+    {
+        size_t i = 0;
+        for (; i + 32 <= size; i += 32)
+        {
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), fold_block(load_block(text + i)));
+        }
+        fold_case_scalar(text + i, size - i, out + i);
+    }
+
+    __attribute__((target("avx2"))) bool equal_nocase_avx2(const char *a, const char *b, size_t size)
+    {
+        size_t i = 0;
+        for (; i + 32 <= size; i += 32)
+        {
+            __m256i same = _mm256_cmpeq_epi8(fold_block(load_block(a + i)), fold_block(load_block(b + i)));
+            if (_mm256_movemask_epi8(same) != -1)
+            {
+                return false;
+            }
+        }
+        return equal_nocase_scalar(a + i, b + i, size - i);
+    }
+
+    // Folds 32 bytes at a time and mixes the four words in the same order as the scalar version.
+    __attribute__((target("avx2"))) uint64_t hash_nocase_avx2(const char *text, size_t size)
+    {
+        uint64_t hash = 0;
+        size_t i = 0;
+        alignas(32) uint64_t words[4];
+        for (; i + 32 <= size; i += 32)
+        {
+            _mm256_store_si256(reinterpret_cast<__m256i *>(words), fold_block(load_block(text + i)));
+            for (uint64_t word : words)
+            {
+                hash = mix(hash, word);
+            }
+        }
+        for (; i < size; i += 8)
+        {
+            hash = mix(hash, fold_word(load_word(text + i, size - i, 0)));
+        }
+        return finish(hash, size);
+    }
+#endif
+
+    struct Implementation
+    {
+        const char *name;
+        decltype(&is_alphanumeric_scalar) is_alphanumeric;
+        decltype(&fold_case_scalar) fold_case;
+        decltype(&equal_nocase_scalar) equal_nocase;
+        decltype(&hash_nocase_scalar) hash_nocase;
+    };
+
+    const Implementation SCALAR = {"scalar", &is_alphanumeric_scalar, &fold_case_scalar, &equal_nocase_scalar, &hash_nocase_scalar};
+#ifdef REGISTRY_X86
+    const Implementation AVX2 = {"avx2", &is_alphanumeric_avx2, &fold_case_avx2, &equal_nocase_avx2, &hash_nocase_avx2};
+#endif
+
+    const Implementation *detect()
+    {
+#ifdef REGISTRY_X86
+        if (cpu_has_avx2())
+        {
+            return &AVX2;
+        }
+#endif
+        return &SCALAR;
+    }
+
+    const Implementation *active = detect();
+}
+
+bool TextKernels::is_alphanumeric(const char *text, size_t size)
+{
+    return active->is_alphanumeric(text, size);
+}
+
+void TextKernels::fold_case(const char *text, size_t size, char *out)
+{
+    active->fold_case(text, size, out);
+}
+
+std::string TextKernels::fold_case(const std::string &text)
+{
+    std::string folded(text.size(), '\0');
+    active->fold_case(text.data(), text.size(), &folded[0]);
+    return folded;
+}
+
+bool TextKernels::equal_nocase(const char *a, const char *b, size_t size)
+{
+    return active->equal_nocase(a, b, size);
+}
+
+bool TextKernels::equal_nocase(const std::string &a, const std::string &b)
+{
+    return a.size() == b.size() && active->equal_nocase(a.data(), b.data(), a.size());
+}
+
+int TextKernels::compare_nocase(const std::string &a, const std::string &b)
+{
+    size_t size = std::min(a.size(), b.size());
+    for (size_t i = 0; i < size; i++)
+    {
+        unsigned char x = a[i] >= 'A' && a[i] <= 'Z' ? a[i] + ('a' - 'A') : a[i];
+        unsigned char y = b[i] >= 'A' && b[i] <= 'Z' ? b[i] + ('a' - 'A') : b[i];
+        if (x != y)
+        {
+            return x < y ? -1 : 1;
+        }
+    }
+    return a.size() < b.size() ? -1 : a.size() > b.size() ? 1 : 0;
+}
+
+uint64_t TextKernels::hash_nocase(const char *text, size_t size)
+{
+    return active->hash_nocase(text, size);
+}
+
+const char *TextKernels::implementation()
+{
+    return active->name;
+}
+
+bool TextKernels::set_implementation(const std::string &name)
+{
+    if (name == "scalar")
+    {
+        active = &SCALAR;
+        return true;
+    }
+#ifdef REGISTRY_X86
+    if (name == "avx2" && cpu_has_avx2())
+    {
+        active = &AVX2;
+        return true;
+    }
+#endif
+    return false;
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Byte kernels for identifiers compared the way SQLite's NOCASE collation compares them: only ASCII A-Z and
+// a-z are folded, every other byte is matched exactly. None of them consult the C locale. AVX2 versions work
+// 32 bytes at a time and are picked at startup when the CPU has AVX2; the scalar versions work 8 bytes at a
+// time in a 64-bit word and are the fallback.
+namespace TextKernels
+{
+    // True when every byte is an ASCII letter or digit (and for the empty string).
+    bool is_alphanumeric(const char *text, size_t size);
+    // Writes text with A-Z lowercased to out, which may be text itself.
+    void fold_case(const char *text, size_t size, char *out);
+    std::string fold_case(const std::string &text);
+    bool equal_nocase(const char *a, const char *b, size_t size);
+    bool equal_nocase(const std::string &a, const std::string &b);
+    // Negative, zero or positive as a sorts before, with or after b under NOCASE. A plain byte loop, for merging
+    // already sorted results.
+    int compare_nocase(const std::string &a, const std::string &b);
+    // Equal for strings that are equal_nocase, and the same value whichever implementation is active.
+    uint64_t hash_nocase(const char *text, size_t size);
+
+    const char *implementation(); // "avx2" or "scalar"
+    bool set_implementation(const std::string &name); // for benchmarks; false if the CPU lacks it
+
+    // For unordered containers keyed by case-insensitive identifiers.
+    struct NocaseHash
+    {
+        size_t operator()(const std::string &text) const { return static_cast<size_t>(hash_nocase(text.data(), text.size())); }
+    };
+
+    struct NocaseEqual
+    {
+        bool operator()(const std::string &a, const std::string &b) const { return equal_nocase(a, b); }
+    };
+}
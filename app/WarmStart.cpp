@@ -0,0 +1,188 @@
+#include "WarmStart.h"
+#include <cstdio>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+    const uint64_t HEADER_MAGIC = 0x314d524157474552; // "REGWARM1"
+    const uint64_t TRAILER_MAGIC = 0x444e454d52415752; // "RWARMEND"
+    // Bump when the layout of any section changes, or TextKernels::hash_nocase does: the serial filter and the
+    // columnar serial index are both laid out by it.
+    const uint32_t FORMAT_VERSION = 1;
+}
+
+void WarmStartChecksum::add(const void *bytes, size_t count)
+{
+    const unsigned char *next = static_cast<const unsigned char *>(bytes);
+    total += count;
+    for (; count > 0 && pending_bytes > 0; count--)
+    {
+        pending[pending_bytes++] = *next++;
+        if (pending_bytes == sizeof(pending))
+        {
+            uint64_t word;
+            std::memcpy(&word, pending, sizeof(word));
+            hash = mix(hash, word);
+            pending_bytes = 0;
+        }
+    }
+    for (; count >= sizeof(uint64_t); count -= sizeof(uint64_t), next += sizeof(uint64_t))
+    {
+        uint64_t word;
+        std::memcpy(&word, next, sizeof(word));
+        hash = mix(hash, word);
+    }
+    for (; count > 0; count--)
+    {
+        pending[pending_bytes++] = *next++;
+    }
+}
+
+uint64_t WarmStartChecksum::value() const
+{
+    uint64_t word = 0;
+    std::memcpy(&word, pending, pending_bytes);
+    return mix(mix(hash, word), total);
+}
+
+// private methods
+uint64_t WarmStartChecksum::mix(uint64_t hash, uint64_t word)
+{
+    hash = (hash ^ word) * 0x9e3779b97f4a7c15;
+    return hash ^ (hash >> 32);
+}
+
+WarmStartWriter::WarmStartWriter(const std::string &path, uint64_t token)
+    : path(path), temp_path(path + ".tmp"), buffer(1 << 20), committed(false)
+{
+    out.rdbuf()->pubsetbuf(buffer.data(), buffer.size());
+    out.open(temp_path, std::ios::binary | std::ios::trunc);
+    put(HEADER_MAGIC);
+    put(FORMAT_VERSION);
+    put(uint32_t(0));
+    put(token);
+}
+
+WarmStartWriter::~WarmStartWriter()
+{
+    if (!committed)
+    {
+        out.close();
+        std::remove(temp_path.c_str());
+    }
+}
+
+void WarmStartWriter::put_string(const std::string &value)
+{
+    put(static_cast<uint32_t>(value.size()));
+    write(value.data(), value.size());
+}
+
+bool WarmStartWriter::commit()
+{
+    put(checksum.value());
+    put(TRAILER_MAGIC);
+    out.close();
+    if (out.fail() || std::rename(temp_path.c_str(), path.c_str()) != 0)
+    {
+        std::cerr << "Error writing warm-start file " << path << std::endl;
+        return false;
+    }
+    committed = true;
+    return true;
+}
+
+// private methods
+void WarmStartWriter::write(const void *bytes, size_t count)
+{
+    checksum.add(bytes, count);
+    out.write(static_cast<const char *>(bytes), count);
+}
+
+WarmStartReader::WarmStartReader(const std::string &path) : data(nullptr), mapped_size(0), size(0), offset(0), good(false), header_token(0)
+{
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+    {
+        void *mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped != MAP_FAILED)
+        {
+            madvise(mapped, st.st_size, MADV_SEQUENTIAL);
+            madvise(mapped, st.st_size, MADV_WILLNEED);
+            data = static_cast<const char *>(mapped);
+            mapped_size = size = st.st_size;
+        }
+    }
+    close(fd);
+    if (data == nullptr)
+    {
+        return;
+    }
+
+    // The image ends with the checksum of everything before it and the trailer magic.
+    uint64_t trailer[2] = {0, 0};
+    if (size < sizeof(trailer))
+    {
+        return;
+    }
+    size -= sizeof(trailer);
+    std::memcpy(trailer, data + size, sizeof(trailer));
+    WarmStartChecksum checksum;
+    checksum.add(data, size);
+    if (trailer[1] != TRAILER_MAGIC || trailer[0] != checksum.value())
+    {
+        return;
+    }
+
+    uint64_t magic = 0;
+    uint32_t version = 0;
+    uint32_t reserved = 0;
+    good = true;
+    get(magic);
+    get(version);
+    get(reserved);
+    get(header_token);
+    good = good && magic == HEADER_MAGIC && version == FORMAT_VERSION;
+}
+
+WarmStartReader::~WarmStartReader()
+{
+    if (data != nullptr)
+    {
+        munmap(const_cast<char *>(data), mapped_size);
+    }
+}
+
+bool WarmStartReader::get_string(std::string &value)
+{
+    uint32_t length = 0;
+    const char *bytes = get(length) ? static_cast<const char *>(take(length)) : nullptr;
+    if (bytes == nullptr)
+    {
+        return false;
+    }
+    value.assign(bytes, length);
+    return true;
+}
+
+// private methods
+const void *WarmStartReader::take(size_t bytes)
+{
+    if (!good || bytes > size - offset)
+    {
+        good = false;
+        return nullptr;
+    }
+    const void *start = data + offset;
+    offset += bytes;
+    return start;
+}
@@ -0,0 +1,103 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Binary image of a registry file's in-memory state (serial filter, columnar snapshot), so a restart can map it
+// back instead of rebuilding from SQLite. The header carries a random token that the saving DBHandler also stores
+// in the registry and takes out again before the next write; the image is used only while the two still match.
+// Values are in host byte order: the file only moves between runs on one machine.
+
+// 64-bit checksum of the image bytes, taken in 8-byte words however the bytes are split between add() calls.
+class WarmStartChecksum
+{
+public:
+    void add(const void *bytes, size_t count);
+    uint64_t value() const;
+
+private:
+    uint64_t hash = 0;
+    uint64_t total = 0;
+    unsigned char pending[8] = {}; // start of a word not yet complete
+    size_t pending_bytes = 0;
+
+    static uint64_t mix(uint64_t hash, uint64_t word);
+};
+
+// Writes `<path>.tmp` and renames it over `path` on commit(), so readers never see a partial image.
+class WarmStartWriter
+{
+public:
+    WarmStartWriter(const std::string &path, uint64_t token);
+    ~WarmStartWriter(); // removes the temporary file unless committed
+
+    template <typename T>
+    void put(const T &value) { write(&value, sizeof(T)); }
+    template <typename T>
+    void put_array(const T *values, size_t count) { write(values, count * sizeof(T)); }
+    void put_string(const std::string &value);
+
+    bool commit(); // appends the checksum
+
+private:
+    std::string path;
+    std::string temp_path;
+    std::vector<char> buffer;
+    std::ofstream out;
+    WarmStartChecksum checksum;
+    bool committed;
+
+    void write(const void *bytes, size_t count);
+};
+
+// Maps an image read-only, verifies its checksum and reads it front to back. Every read is bounds-checked; after
+// the first failed read ok() is false and further reads return nothing, so callers check once at the end of a section.
+class WarmStartReader
+{
+public:
+    explicit WarmStartReader(const std::string &path);
+    ~WarmStartReader();
+    WarmStartReader(const WarmStartReader &) = delete;
+    WarmStartReader &operator=(const WarmStartReader &) = delete;
+
+    bool is_open() const { return data != nullptr; }
+    uint64_t token() const { return header_token; }
+    bool ok() const { return good; }
+
+    template <typename T>
+    bool get(T &value)
+    {
+        const void *bytes = take(sizeof(T));
+        if (bytes != nullptr)
+        {
+            std::memcpy(&value, bytes, sizeof(T));
+        }
+        return bytes != nullptr;
+    }
+    template <typename T>
+    bool get_array(std::vector<T> &values, size_t count)
+    {
+        const void *bytes = count <= (size - offset) / sizeof(T) ? take(count * sizeof(T)) : nullptr;
+        if (bytes == nullptr)
+        {
+            good = false;
+            return false;
+        }
+        values.resize(count);
+        std::memcpy(values.data(), bytes, count * sizeof(T));
+        return true;
+    }
+    bool get_string(std::string &value);
+
+private:
+    const char *data;
+    size_t mapped_size;
+    size_t size; // mapped_size less the trailer
+    size_t offset;
+    bool good;
+    uint64_t header_token;
+
+    const void *take(size_t bytes);
+};
@@ -1,26 +1,144 @@
 #include "DBHandler.h"
+#include "ShardedDBHandler.h"
 #include "DeviceHandler.h"
 #include "LocationHandler.h"
+#include "AdminHandler.h"
+#include "AdmissionController.h"
+#include "MaintenanceScheduler.h"
+#include "ReplicationHandler.h"
+#include "ReplicationFollower.h"
+#include "EventLoopServer.h"
+#include "Config.h"
+#include <csignal>
+
+namespace
+{
+    // Every signal stops the server again, in case an earlier one arrived before it was listening.
+    void stop_on_signal(httplib::Server &svr, sigset_t signals)
+    {
+        int signal;
+        while (sigwait(&signals, &signal) == 0)
+        {
+            svr.stop();
+        }
+    }
+}
 
 int main()
 {
-    DBHandler dbHandler("registry.db");
-    if (!dbHandler.open_connection())
+    // SIGINT and SIGTERM are taken by a thread that stops the server, so the registry is closed, and its warm-start
+    // file written, on the way out. Blocked here, before any thread starts, so that every thread inherits the mask.
+    sigset_t stop_signals;
+    sigemptyset(&stop_signals);
+    sigaddset(&stop_signals, SIGINT);
+    sigaddset(&stop_signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stop_signals, nullptr);
+
+    Config config = load_config();
+
+    // A follower starts from the primary's snapshot, so it is fetched before the registry is opened.
+    bool follower = !config.replicate_from.empty();
+    ReplicationFollower replicationFollower(config.replicate_from);
+    if (follower && !replicationFollower.load_snapshot(config.db_path, config.shards))
+    {
+        std::cout << "Failed to load snapshot from primary" << std::endl;
+        return 1;
+    }
+
+    std::unique_ptr<DBHandler> dbHandler;
+    if (config.shards > 1)
+    {
+        dbHandler = std::make_unique<ShardedDBHandler>(config.db_path, config.shards, config.read_connections, config.columnar_snapshot != 0,
+                                                       config.warm_start != 0);
+    }
+    else
+    {
+        dbHandler = std::make_unique<DBHandler>(config.db_path, config.read_connections, config.columnar_snapshot != 0, config.warm_start != 0);
+    }
+    dbHandler->get_profiler().set_threshold_ms(config.slow_query_ms);
+    if (!dbHandler->open_connection())
     {
         std::cout << "Failed to connect to database" << std::endl;
         return 1;
     }
     std::cout << "Connected to database." << std::endl;
 
+    ReplicationLog replicationLog(config.replication_log);
+    if (!follower)
+    {
+        dbHandler->set_mutation_listener([&replicationLog](const json &mutation)
+                                         { replicationLog.append(mutation); });
+    }
+
     httplib::Server svr;
-    DeviceHandler deviceHandler(dbHandler);
-    LocationHandler locationHandler(dbHandler);
+    AdmissionSettings admissionSettings;
+    admissionSettings.max_limit = config.admission_limit;
+    admissionSettings.min_limit = config.admission_min_limit;
+    admissionSettings.target_latency_ms = config.target_latency_ms;
+    admissionSettings.read_only = follower;
+    AdmissionController admissionController(admissionSettings);
 
-    deviceHandler.handle_requests(svr);
-    locationHandler.handle_requests(svr);
+    MaintenanceSettings maintenanceSettings;
+    maintenanceSettings.idle_requests_per_s = config.maintenance_idle_rps;
+    MaintenanceScheduler maintenanceScheduler(*dbHandler, maintenanceSettings);
+    if (config.maintenance != 0)
+    {
+        maintenanceScheduler.start();
+    }
+
+    DeviceHandler deviceHandler(*dbHandler);
+    LocationHandler locationHandler(*dbHandler);
+    AdminHandler adminHandler(*dbHandler, maintenanceScheduler);
+    ReplicationHandler replicationHandler(*dbHandler, replicationLog, config.db_path + ".snapshot");
+
+    Router router;
+    deviceHandler.handle_requests(router);
+    locationHandler.handle_requests(router);
+    adminHandler.handle_requests(router);
+    router.install(svr);
+    admissionController.install(svr, [&router](const httplib::Request &req, httplib::Response &res)
+                                { return router.dispatch(req, res); });
+
+    // Replication streams stay on httplib; everything registered on the router is also served by the event loop.
+    EventLoopSettings eventLoopSettings;
+    eventLoopSettings.port = config.event_loop_port;
+    eventLoopSettings.idle_timeout_s = config.event_loop_idle_s;
+    EventLoopServer eventLoop(router, eventLoopSettings);
+    std::thread eventLoopThread;
+    if (config.event_loop_port > 0)
+    {
+#ifdef REGISTRY_COROUTINES
+        DbExecutor::instance().start(std::max(config.db_threads, 1));
+#endif
+        admissionController.install(eventLoop);
+        eventLoopThread = std::thread([&eventLoop]
+                                      { eventLoop.listen(); });
+    }
+
+    if (follower)
+    {
+        replicationFollower.start(*dbHandler);
+    }
+    else
+    {
+        replicationHandler.handle_requests(svr);
+    }
 
-    svr.listen("0.0.0.0", 8080);
+    std::thread(stop_on_signal, std::ref(svr), stop_signals).detach();
+
+    svr.listen("0.0.0.0", config.port);
+
+    eventLoop.stop();
+    if (eventLoopThread.joinable())
+    {
+        eventLoopThread.join();
+    }
+#ifdef REGISTRY_COROUTINES
+    DbExecutor::instance().stop(); // before eventLoop goes: the calls it runs hand their responses to it
+#endif
 
-    dbHandler.close_connection();
+    replicationFollower.stop();
+    maintenanceScheduler.stop();
+    dbHandler->close_connection();
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,36 @@
+#pragma once
+#include "../tools/RegistryGenerator.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Shared helpers for the benchmark binaries.
+
+inline std::string bench_serial(long i)
+{
+    return RegistryGenerator::serial_number(i);
+}
+
+// Writes a fresh registry with `devices` rows spread uniformly over `locations` locations and 16 types.
+inline bool create_registry(const std::string &path, long devices, int locations)
+{
+    GeneratorOptions options;
+    options.devices = devices;
+    options.locations = locations;
+    RegistryGenerator generator(options);
+    return generator.generate(path);
+}
+
+// Nearest-rank percentile of an already sorted sample.
+inline uint64_t percentile(const std::vector<uint64_t> &sorted, double p)
+{
+    if (sorted.empty())
+    {
+        return 0;
+    }
+    size_t rank = static_cast<size_t>(p * sorted.size());
+    return sorted[std::min(rank, sorted.size() - 1)];
+}
@@ -0,0 +1,631 @@
+// DBHandler microbenchmarks without the HTTP layer. Reports ns/op and heap allocations/op as JSON.
+//
+//   ./db_bench --sizes=10000,100000,1000000 --locations=50 --min-time=0.5
+#include "../app/DBHandler.h"
+#include "../app/DeviceHandler.h"
+#include "../app/FilterKernels.h"
+#include "../app/LocationHandler.h"
+#include "../app/RequestArena.h"
+#include "../app/Router.h"
+#include "../app/TextKernels.h"
+#include "BenchUtils.h"
+#include <atomic>
+#include <cctype>
+#include <map>
+#include <new>
+#include <thread>
+
+namespace
+{
+    std::atomic<uint64_t> allocation_count(0);
+    std::atomic<uint64_t> allocation_bytes(0);
+    // Allocations made by request handlers of the in-process server in run_handlers.
+    thread_local bool in_handler = false;
+    std::atomic<uint64_t> handler_allocation_count(0);
+    std::atomic<uint64_t> handler_allocation_bytes(0);
+
+    void count_allocation(std::size_t size)
+    {
+        allocation_count.fetch_add(1, std::memory_order_relaxed);
+        allocation_bytes.fetch_add(size, std::memory_order_relaxed);
+        if (in_handler)
+        {
+            handler_allocation_count.fetch_add(1, std::memory_order_relaxed);
+            handler_allocation_bytes.fetch_add(size, std::memory_order_relaxed);
+        }
+    }
+}
+
+void *operator new(std::size_t size)
+{
+    count_allocation(size);
+    void *ptr = std::malloc(size ? size : 1);
+    if (!ptr)
+    {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+// std::pmr::new_delete_resource allocates through the aligned forms.
+void *operator new(std::size_t size, std::align_val_t alignment)
+{
+    count_allocation(size);
+    size_t align = static_cast<size_t>(alignment);
+    void *ptr = std::aligned_alloc(align, (size + align - 1) / align * align);
+    if (!ptr)
+    {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void operator delete(void *ptr, std::align_val_t) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t, std::align_val_t) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void *ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+namespace
+{
+    struct Options
+    {
+        std::vector<long> sizes = {1000, 10000, 100000};
+        int locations = 20;
+        double min_time_s = 0.2;
+        long max_iterations = 1000000;
+        std::string db_path = "db_bench_registry.db";
+    };
+
+    // Runs op(i) until min_time_s has passed and appends the averaged result to `results`. With handler_only, only
+    // allocations made inside server request handlers are counted.
+    template <typename Op>
+    void measure(json &results, const Options &options, long size, const std::string &name, Op op, bool handler_only = false)
+    {
+        const auto &allocation_count = handler_only ? handler_allocation_count : ::allocation_count;
+        const auto &allocation_bytes = handler_only ? handler_allocation_bytes : ::allocation_bytes;
+        long iterations = 0;
+        uint64_t count_before = allocation_count.load();
+        uint64_t bytes_before = allocation_bytes.load();
+        auto start = std::chrono::steady_clock::now();
+        double elapsed_s = 0;
+        while (elapsed_s < options.min_time_s && iterations < options.max_iterations)
+        {
+            op(iterations++);
+            elapsed_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+        uint64_t allocations = allocation_count.load() - count_before;
+        uint64_t bytes = allocation_bytes.load() - bytes_before;
+
+        json result = {
+            {"size", size},
+            {"benchmark", name},
+            {"iterations", iterations},
+            {"ns_per_op", elapsed_s * 1e9 / iterations},
+            {"allocs_per_op", static_cast<double>(allocations) / iterations},
+            {"bytes_per_op", static_cast<double>(bytes) / iterations}};
+        std::cerr << name << " [" << size << "]: " << result["ns_per_op"].get<double>() << " ns/op, "
+                  << result["allocs_per_op"].get<double>() << " allocs/op" << std::endl;
+        results.push_back(result);
+    }
+
+    // Steps through every row of `sql`, touching each column, and returns the number of rows.
+    long scan_rows(sqlite3 *conn, const std::string &sql, const std::string &param)
+    {
+        sqlite3_stmt *stmt;
+        if (sqlite3_prepare_v2(conn, sql.c_str(), -1, &stmt, NULL) != SQLITE_OK)
+        {
+            std::cerr << "Error preparing SQL statement: " << sqlite3_errmsg(conn) << std::endl;
+            return 0;
+        }
+        if (!param.empty())
+        {
+            sqlite3_bind_text(stmt, 1, param.c_str(), -1, SQLITE_STATIC);
+        }
+        long rows = 0;
+        long bytes = 0;
+        while (sqlite3_step(stmt) == SQLITE_ROW)
+        {
+            for (int c = 0; c < sqlite3_column_count(stmt); c++)
+            {
+                sqlite3_column_text(stmt, c);
+                bytes += sqlite3_column_bytes(stmt, c);
+            }
+            rows++;
+        }
+        sqlite3_finalize(stmt);
+        return bytes > 0 ? rows : 0;
+    }
+
+    // Device reads used to join locations for the location name and type; they now read the copies kept on each device.
+    void compare_read_models(json &results, const Options &options, long size)
+    {
+        sqlite3 *conn;
+        if (sqlite3_open_v2(options.db_path.c_str(), &conn, SQLITE_OPEN_READONLY, NULL) != SQLITE_OK)
+        {
+            std::cerr << "Cannot open " << options.db_path << std::endl;
+            sqlite3_close(conn);
+            return;
+        }
+        const std::string join = "SELECT devices.serial_number, devices.name, devices.type, devices.creation_date, devices.location_id,"
+                                 " locations.name, locations.type FROM devices INNER JOIN locations ON devices.location_id = locations.id";
+        const std::string denormalized = "SELECT serial_number, name, type, creation_date, location_id, location_name, location_type FROM devices";
+        std::string location_name = "Location" + std::to_string(1 + size / 2 % options.locations);
+
+        measure(results, options, size, "read_model[join]", [&](long)
+                { scan_rows(conn, join, ""); });
+        measure(results, options, size, "read_model[denormalized]", [&](long)
+                { scan_rows(conn, denormalized, ""); });
+        measure(results, options, size, "read_model[join,location_name]", [&](long)
+                { scan_rows(conn, join + " WHERE locations.name = ?", location_name); });
+        measure(results, options, size, "read_model[denormalized,location_name]", [&](long)
+                { scan_rows(conn, denormalized + " WHERE location_name = ?", location_name); });
+        sqlite3_close(conn);
+    }
+
+    // filter_devices answered by ColumnarSnapshot, and the predicate kernels alone over `size` rows with each implementation.
+    void run_columnar(json &results, const Options &options, long size)
+    {
+        DBHandler db(options.db_path, 0, true);
+        db.get_profiler().set_threshold_ms(1e9);
+        if (!db.open_connection())
+        {
+            std::cerr << "Cannot open " << options.db_path << std::endl;
+            return;
+        }
+        std::string location = std::to_string(1 + size / 2 % options.locations);
+        measure(results, options, size, "columnar_filter[start_date,end_date:week]", [&](long)
+                { db.filter_devices("", "", "", "", "", "2020-03-01", "2020-03-07", "", ""); });
+        measure(results, options, size, "columnar_filter[type]", [&](long)
+                { db.filter_devices("", "", "Type3", "", "", "", "", "", ""); });
+        measure(results, options, size, "columnar_filter[type,location_id,start_date]", [&](long)
+                { db.filter_devices("", "", "Type3", "", location, "2024-01-01", "", "", ""); });
+        measure(results, options, size, "columnar_filter[location_name,location_type]", [&](long)
+                { db.filter_devices("", "", "", "", "", "", "", "Location" + location, "LocationType3"); });
+        db.close_connection();
+
+        size_t words = (size + 63) / 64;
+        std::vector<int32_t> dates(words * 64);
+        std::vector<uint32_t> codes(words * 64);
+        for (size_t i = 0; i < dates.size(); i++)
+        {
+            dates[i] = 20150101 + i * 7919 % 100000;
+            codes[i] = i * 31 % 16;
+        }
+        std::vector<uint64_t> bits(words);
+        std::string active = FilterKernels::implementation();
+        for (const char *implementation : {"scalar", "avx2"})
+        {
+            if (!FilterKernels::set_implementation(implementation))
+            {
+                continue;
+            }
+            measure(results, options, size, std::string("kernel[select_range,") + implementation + "]", [&](long)
+                    {
+                        std::fill(bits.begin(), bits.end(), ~uint64_t(0));
+                        FilterKernels::select_range(dates.data(), words, 20170101, 20191231, bits.data()); });
+            measure(results, options, size, std::string("kernel[select_equal,") + implementation + "]", [&](long)
+                    {
+                        std::fill(bits.begin(), bits.end(), ~uint64_t(0));
+                        FilterKernels::select_equal(codes.data(), words, {3}, bits.data()); });
+        }
+        FilterKernels::set_implementation(active);
+    }
+
+    // The byte-at-a-time loops TextKernels replaced, as a baseline.
+    bool reference_is_alphanumeric(const std::string &text)
+    {
+        for (char c : text)
+        {
+            if (!std::isalnum(static_cast<unsigned char>(c)))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    std::string reference_fold_case(const std::string &text)
+    {
+        std::string folded(text);
+        for (char &c : folded)
+        {
+            if (c >= 'A' && c <= 'Z')
+            {
+                c += 'a' - 'A';
+            }
+        }
+        return folded;
+    }
+
+    uint64_t reference_hash_nocase(const std::string &text)
+    {
+        uint64_t h = 14695981039346656037ULL;
+        for (char c : reference_fold_case(text))
+        {
+            h = (h ^ static_cast<unsigned char>(c)) * 1099511628211ULL;
+        }
+        return h;
+    }
+
+    // TextKernels on each implementation and the reference loops. `size` is the string length; one op runs the
+    // kernel over 1024 strings of that length (generated serial numbers, repeated to the length).
+    void run_text_kernels(json &results, const Options &options)
+    {
+        const int strings = 1024;
+        std::string active = TextKernels::implementation();
+        for (long length : {12L, 64L, 1024L})
+        {
+            std::vector<std::string> texts, upper;
+            for (int i = 0; i < strings; i++)
+            {
+                std::string text;
+                while (static_cast<long>(text.size()) < length)
+                {
+                    text += bench_serial(i * 7919L + text.size());
+                }
+                text.resize(length);
+                texts.push_back(text);
+                upper.push_back(text);
+                for (char &c : upper.back())
+                {
+                    c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+                }
+            }
+            std::vector<char> out(length);
+            volatile uint64_t sink = 0;
+
+            measure(results, options, length, "text[is_alphanumeric,reference]", [&](long)
+                    { for (const auto &text : texts) sink = sink + reference_is_alphanumeric(text); });
+            measure(results, options, length, "text[fold_case,reference]", [&](long)
+                    { for (const auto &text : texts) sink = sink + reference_fold_case(text).size(); });
+            measure(results, options, length, "text[equal_nocase,reference]", [&](long)
+                    { for (int i = 0; i < strings; i++) sink = sink + (reference_fold_case(texts[i]) == reference_fold_case(upper[i])); });
+            measure(results, options, length, "text[hash_nocase,reference]", [&](long)
+                    { for (const auto &text : texts) sink = sink + reference_hash_nocase(text); });
+            for (const char *implementation : {"scalar", "avx2"})
+            {
+                if (!TextKernels::set_implementation(implementation))
+                {
+                    continue;
+                }
+                std::string suffix = std::string(",") + implementation + "]";
+                measure(results, options, length, "text[is_alphanumeric" + suffix, [&](long)
+                        { for (const auto &text : texts) sink = sink + TextKernels::is_alphanumeric(text.data(), text.size()); });
+                measure(results, options, length, "text[fold_case" + suffix, [&](long)
+                        { for (const auto &text : texts) TextKernels::fold_case(text.data(), text.size(), out.data()); });
+                measure(results, options, length, "text[equal_nocase" + suffix, [&](long)
+                        { for (int i = 0; i < strings; i++) sink = sink + TextKernels::equal_nocase(texts[i], upper[i]); });
+                measure(results, options, length, "text[hash_nocase" + suffix, [&](long)
+                        { for (const auto &text : texts) sink = sink + TextKernels::hash_nocase(text.data(), text.size()); });
+            }
+        }
+        TextKernels::set_implementation(active);
+    }
+
+    // Cost of finding the handler for one request, with no-op handlers. "regex" is httplib's matcher list in the
+    // order main registered routes before the router; "trie" is Router plus whatever httplib still matches around
+    // it: the replication regexes for GET paths the trie does not know, and the catch-all path-parameter routes that
+    // hand requests with a body to the router. `size` is the number of routes on the router.
+    void run_routing(json &results, const Options &options)
+    {
+        using Matchers = std::vector<std::unique_ptr<httplib::detail::MatcherBase>>;
+        std::map<std::string, Matchers> regex_routes, trie_routes;
+        auto regex = [](Matchers &matchers, const std::string &pattern)
+        { matchers.push_back(std::make_unique<httplib::detail::RegexMatcher>(pattern)); };
+
+        for (const char *pattern : {"/devices", "/devices/filter", "/locations"})
+            regex(regex_routes["GET"], pattern);
+        for (const char *pattern : {"/devices/lookup", "/devices/relocate", "/devices", "/locations"})
+            regex(regex_routes["POST"], pattern);
+        for (const char *method : {"PATCH", "DELETE"})
+        {
+            regex(regex_routes[method], R"(/devices/([^/]+))");
+            regex(regex_routes[method], R"(/locations/(\d+))");
+        }
+        for (const char *pattern : {"/metrics", "/admin/queries"})
+            regex(regex_routes["GET"], pattern);
+        for (const char *pattern : {"/replication/snapshot", "/replication/stream"})
+        {
+            regex(regex_routes["GET"], pattern);
+            regex(trie_routes["GET"], pattern);
+        }
+        for (const char *method : {"POST", "PATCH", "DELETE"})
+        {
+            for (const char *pattern : {"/:p0/:p1", "/:p0"})
+                trie_routes[method].push_back(std::make_unique<httplib::detail::PathParamsMatcher>(pattern));
+        }
+
+        Router router;
+        auto noop = [](const httplib::Request &, httplib::Response &, const Router::Params &) {};
+        for (const char *pattern : {"/devices", "/devices/filter", "/locations", "/metrics", "/admin/queries"})
+            router.Get(pattern, noop);
+        for (const char *pattern : {"/devices/lookup", "/devices/relocate", "/devices", "/locations"})
+            router.Post(pattern, noop);
+        router.Patch("/devices/{serial}", noop);
+        router.Delete("/devices/{serial}", noop);
+        router.Patch("/locations/{id}", noop);
+        router.Delete("/locations/{id}", noop);
+        const long routes = 13;
+
+        auto first_match = [](Matchers &matchers, httplib::Request &req)
+        {
+            for (auto &matcher : matchers)
+            {
+                if (matcher->match(req))
+                {
+                    return true;
+                }
+            }
+            return false;
+        };
+        const std::pair<const char *, const char *> requests[] = {
+            {"GET", "/devices"}, {"GET", "/devices/filter"}, {"GET", "/locations"}, {"GET", "/metrics"},
+            {"POST", "/devices"}, {"POST", "/devices/lookup"}, {"PATCH", "/devices/SN00004096"},
+            {"DELETE", "/devices/SN00004096"}, {"PATCH", "/locations/42"}, {"DELETE", "/locations/42"}};
+        volatile bool sink = false;
+        for (const auto &request : requests)
+        {
+            httplib::Request req;
+            httplib::Response res;
+            req.method = request.first;
+            req.path = request.second;
+            std::string name = std::string("routing[") + request.first + " " + request.second;
+            measure(results, options, routes, name + ",regex]", [&](long)
+                    { sink = first_match(regex_routes[req.method], req); });
+            measure(results, options, routes, name + ",trie]", [&](long)
+                    {
+                        if (req.method == "GET")
+                        {
+                            sink = router.route(req, res) || first_match(trie_routes[req.method], req);
+                        }
+                        else
+                        {
+                            sink = first_match(trie_routes[req.method], req) && router.route(req, res);
+                        }
+                    });
+        }
+    }
+
+    // Device and location routes through an in-process server and keep-alive client, with the request arena off
+    // and on. allocs_per_op counts only the server thread's allocations from routing to the end of the handler,
+    // that is the handler's malloc calls per request; ns_per_op includes the HTTP round trip.
+    void run_handlers(json &results, const Options &options, long size)
+    {
+        DBHandler db(options.db_path);
+        db.get_profiler().set_threshold_ms(1e9);
+        if (!db.open_connection())
+        {
+            std::cerr << "Cannot open " << options.db_path << std::endl;
+            return;
+        }
+        DeviceHandler deviceHandler(db);
+        LocationHandler locationHandler(db);
+        httplib::Server svr;
+        svr.set_tcp_nodelay(true);
+        Router router;
+        deviceHandler.handle_requests(router);
+        locationHandler.handle_requests(router);
+        router.install(svr);
+        svr.set_pre_routing_handler([&router](const httplib::Request &req, httplib::Response &res)
+                                    { in_handler = true; return router.dispatch(req, res); });
+        svr.set_post_routing_handler([](const httplib::Request &, httplib::Response &)
+                                     { in_handler = false; });
+        int port = svr.bind_to_any_port("127.0.0.1");
+        std::thread server([&]
+                           { svr.listen_after_bind(); });
+        svr.wait_until_ready();
+
+        httplib::Client client("127.0.0.1", port);
+        client.set_keep_alive(true);
+        client.set_tcp_nodelay(true);
+        std::string location = std::to_string(1 + size / 2 % options.locations);
+        std::string narrow = "/devices/filter?type=Type3&location_id=" + location + "&start_date=2024-01-01";
+        json serials = json::array();
+        for (long i = 0; i < 100; i++)
+        {
+            serials.push_back(bench_serial(i * size / 100));
+        }
+        std::string lookup_body = serials.dump();
+        for (bool arena : {false, true})
+        {
+            RequestArena::set_enabled(arena);
+            std::string suffix = arena ? ",arena]" : ",heap]";
+            measure(results, options, size, "handler[list_devices" + suffix, [&](long)
+                    { client.Get("/devices"); }, true);
+            measure(results, options, size, "handler[filter_devices" + suffix, [&](long)
+                    { client.Get(narrow); }, true);
+            measure(results, options, size, "handler[lookup_devices:100" + suffix, [&](long)
+                    { client.Post("/devices/lookup", lookup_body, "application/json"); }, true);
+            measure(results, options, size, "handler[list_locations" + suffix, [&](long)
+                    { client.Get("/locations"); }, true);
+            measure(results, options, size, "handler[delete_device:missing" + suffix, [&](long)
+                    { client.Delete("/devices/missing0"); }, true);
+        }
+        RequestArena::set_enabled(true);
+        svr.stop();
+        server.join();
+        db.close_connection();
+    }
+
+    void run_size(json &results, const Options &options, long size)
+    {
+        if (!create_registry(options.db_path, size, options.locations))
+        {
+            return;
+        }
+        run_columnar(results, options, size);
+        run_handlers(results, options, size);
+
+        DBHandler db(options.db_path);
+        db.get_profiler().set_threshold_ms(1e9);
+        if (!db.open_connection())
+        {
+            std::cerr << "Cannot open " << options.db_path << std::endl;
+            return;
+        }
+
+        measure(results, options, size, "get_devices", [&](long)
+                { db.get_devices(); });
+        measure(results, options, size, "visit_devices", [&](long)
+                { db.visit_devices([](const DeviceRow &) {}); });
+
+        // Sorted listings walk a sort index, so a top-N query reads only the first rows of it.
+        const char *sort_names[] = {"", "serial_number", "name", "creation_date"};
+        for (DeviceSort sort : {SORT_SERIAL_NUMBER, SORT_NAME, SORT_CREATION_DATE})
+        {
+            DeviceOrder order;
+            order.sort = sort;
+            order.descending = true;
+            std::string name = std::string("visit_devices[sort=") + sort_names[sort] + ",desc";
+            measure(results, options, size, name + "]", [&](long)
+                    { db.visit_devices([](const DeviceRow &) {}, order); });
+            order.limit = 50;
+            measure(results, options, size, name + ",limit=50]", [&](long)
+                    { db.visit_devices([](const DeviceRow &) {}, order); });
+        }
+        DeviceOrder newest;
+        newest.sort = SORT_CREATION_DATE;
+        newest.descending = true;
+        newest.limit = 50;
+        std::string newest_location = std::to_string(1 + size / 2 % options.locations);
+        measure(results, options, size, "visit_filtered_devices[location_id,sort=creation_date,desc,limit=50]", [&](long)
+                { db.visit_filtered_devices("", "", "", "", newest_location, "", "", "", "", [](const DeviceRow &) {}, newest); });
+        compare_read_models(results, options, size);
+
+        // Every combination of the predicates filter_devices evaluates.
+        const char *filter_names[] = {"serial_number", "type", "start_date", "end_date", "location_name", "location_type", "location_id"};
+        const int filter_count = 7;
+        for (int mask = 1; mask < (1 << filter_count); mask++)
+        {
+            std::string name = "filter_devices[";
+            for (int f = 0; f < filter_count; f++)
+            {
+                if (mask & (1 << f))
+                {
+                    name += std::string(name.back() == '[' ? "" : ",") + filter_names[f];
+                }
+            }
+            name += "]";
+            std::string location = std::to_string(1 + size / 2 % options.locations);
+            std::string serial = mask & 1 ? bench_serial(size / 2) : "";
+            std::string type = mask & 2 ? "Type3" : "";
+            std::string start_date = mask & 4 ? "2018-01-01" : "";
+            std::string end_date = mask & 8 ? "2021-06-30" : "";
+            std::string location_name = mask & 16 ? "Location" + location : "";
+            std::string location_type = mask & 32 ? "LocationType3" : "";
+            std::string location_id = mask & 64 ? location : "";
+            measure(results, options, size, name, [&](long)
+                    { db.filter_devices(serial, "", type, "", location_id, start_date, end_date, location_name, location_type); });
+        }
+
+        long added = 0;
+        measure(results, options, size, "add_device", [&](long i)
+                {
+                    Device device;
+                    device.serial_number = "NEW" + std::to_string(i);
+                    device.name = "NewDevice";
+                    device.type = "NewType";
+                    device.creation_date = "2024-01-01";
+                    device.location_id = 1 + i % options.locations;
+                    db.add_device(device);
+                    added = i + 1; });
+
+        measure(results, options, size, "update_device", [&](long i)
+                { db.update_device("NEW" + std::to_string(i % added), "Renamed", "", "", std::to_string(1 + i % options.locations)); });
+
+        // Each NEW device now has an add entry and a few updates in device_history.
+        measure(results, options, size, "get_device_history", [&](long i)
+                { db.get_device_history("NEW" + std::to_string(i % added)); });
+        measure(results, options, size, "get_device_as_of", [&](long i)
+                {
+                    DeviceVersion version;
+                    db.get_device_as_of("NEW" + std::to_string(i % added), INT64_MAX, version); });
+
+        Options delete_options = options;
+        delete_options.max_iterations = added;
+        measure(results, delete_options, size, "delete_device", [&](long i)
+                { db.delete_device("NEW" + std::to_string(i)); });
+
+        std::string hit = bench_serial(size / 3);
+        std::string miss = "MISSING" + std::to_string(size);
+        measure(results, options, size, "serial_num_exists[hit]", [&](long)
+                { db.serial_num_exists(hit); });
+        measure(results, options, size, "serial_num_exists[miss]", [&](long)
+                { db.serial_num_exists(miss); });
+        measure(results, options, size, "location_exists", [&](long i)
+                { db.location_exists(1 + i % options.locations); });
+
+        // Each deleted location carries size / locations devices; stop before the registry runs out of them.
+        Options location_options = options;
+        location_options.max_iterations = options.locations / 2;
+        measure(results, location_options, size, "delete_location", [&](long i)
+                { db.delete_location(options.locations - i); });
+
+        db.close_connection();
+    }
+
+    std::vector<long> parse_sizes(const std::string &spec)
+    {
+        std::vector<long> sizes;
+        std::stringstream ss(spec);
+        std::string item;
+        while (std::getline(ss, item, ','))
+        {
+            sizes.push_back(std::stol(item));
+        }
+        return sizes;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    Options options;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        auto eq = arg.find('=');
+        std::string key = arg.substr(0, eq);
+        std::string value = eq == std::string::npos ? "" : arg.substr(eq + 1);
+        if (key == "--sizes")
+            options.sizes = parse_sizes(value);
+        else if (key == "--locations")
+            options.locations = std::stoi(value);
+        else if (key == "--min-time")
+            options.min_time_s = std::stod(value);
+        else if (key == "--db")
+            options.db_path = value;
+        else
+        {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    json report;
+    report["results"] = json::array();
+    run_text_kernels(report["results"], options);
+    run_routing(report["results"], options);
+    for (long size : options.sizes)
+    {
+        run_size(report["results"], options, size);
+    }
+    std::remove(options.db_path.c_str());
+
+    std::cout << report.dump(2) << std::endl;
+    return 0;
+}
@@ -0,0 +1,377 @@
+// End-to-end HTTP load benchmark: starts the server binary against a generated registry and drives a
+// mixed workload through httplib::Client. Results are printed as JSON.
+//
+//   ./http_bench --server=../app/my_program --devices=100000 --locations=50 --threads=32 --duration=30
+//                --mix=list:1,filter:40,add:20,patch:20,delete:19
+//
+// --idle-connections=N holds N open connections that never send a request, as idle agents do, and reopens those
+// the server closes. --event-loop drives the workload (and the idle connections) through the epoll front end.
+#include "../app/httplib.h"
+#include "../app/json.hpp"
+#include "BenchUtils.h"
+#include <atomic>
+#include <csignal>
+#include <map>
+#include <netinet/in.h>
+#include <random>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+using json = nlohmann::json;
+
+namespace
+{
+    enum Op
+    {
+        OP_LIST,
+        OP_FILTER,
+        OP_ADD,
+        OP_PATCH,
+        OP_DELETE,
+        OP_COUNT
+    };
+    const char *OP_NAMES[OP_COUNT] = {"list", "filter", "add", "patch", "delete"};
+
+    struct Options
+    {
+        std::string server = "../app/my_program";
+        std::string db_path = "bench_registry.db";
+        bool reuse_db = false;
+        long devices = 10000;
+        int locations = 20;
+        int threads = 16;
+        double duration_s = 10;
+        int port = 18080;
+        int mix[OP_COUNT] = {1, 40, 20, 20, 19};
+        int idle_connections = 0;
+        bool event_loop = false; // served on port + 1
+
+        int target_port() const { return event_loop ? port + 1 : port; }
+    };
+
+    struct ThreadResult
+    {
+        std::vector<uint64_t> latencies_ns[OP_COUNT];
+        std::map<int, uint64_t> statuses[OP_COUNT];
+    };
+
+    bool parse_mix(const std::string &spec, int mix[OP_COUNT])
+    {
+        std::fill(mix, mix + OP_COUNT, 0);
+        std::stringstream ss(spec);
+        std::string item;
+        while (std::getline(ss, item, ','))
+        {
+            auto colon = item.find(':');
+            if (colon == std::string::npos)
+            {
+                return false;
+            }
+            std::string name = item.substr(0, colon);
+            int op = std::find(OP_NAMES, OP_NAMES + OP_COUNT, name) - OP_NAMES;
+            if (op == OP_COUNT)
+            {
+                return false;
+            }
+            mix[op] = std::stoi(item.substr(colon + 1));
+        }
+        return true;
+    }
+
+    bool parse_options(int argc, char **argv, Options &options)
+    {
+        for (int i = 1; i < argc; i++)
+        {
+            std::string arg = argv[i];
+            auto eq = arg.find('=');
+            std::string key = arg.substr(0, eq);
+            std::string value = eq == std::string::npos ? "" : arg.substr(eq + 1);
+            if (key == "--server")
+                options.server = value;
+            else if (key == "--db")
+                options.db_path = value;
+            else if (key == "--reuse-db")
+                options.reuse_db = true;
+            else if (key == "--devices")
+                options.devices = std::stol(value);
+            else if (key == "--locations")
+                options.locations = std::stoi(value);
+            else if (key == "--threads")
+                options.threads = std::stoi(value);
+            else if (key == "--duration")
+                options.duration_s = std::stod(value);
+            else if (key == "--port")
+                options.port = std::stoi(value);
+            else if (key == "--idle-connections")
+                options.idle_connections = std::stoi(value);
+            else if (key == "--event-loop")
+                options.event_loop = true;
+            else if (key == "--mix")
+            {
+                if (!parse_mix(value, options.mix))
+                {
+                    std::cerr << "Invalid --mix, expected e.g. list:1,filter:40,add:20,patch:20,delete:19" << std::endl;
+                    return false;
+                }
+            }
+            else
+            {
+                std::cerr << "Unknown option: " << arg << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    pid_t start_server(const Options &options)
+    {
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            setenv("REGISTRY_DB_PATH", options.db_path.c_str(), 1);
+            setenv("REGISTRY_PORT", std::to_string(options.port).c_str(), 1);
+            if (options.event_loop)
+            {
+                setenv("REGISTRY_EVENT_LOOP_PORT", std::to_string(options.target_port()).c_str(), 1);
+            }
+            // The report goes to stdout, so the server logs to stderr alongside the bench's own messages.
+            dup2(STDERR_FILENO, STDOUT_FILENO);
+            execl(options.server.c_str(), options.server.c_str(), (char *)NULL);
+            std::cerr << "Cannot start server " << options.server << std::endl;
+            _exit(127);
+        }
+        return pid;
+    }
+
+    bool wait_for_server(const Options &options)
+    {
+        httplib::Client cli("127.0.0.1", options.target_port());
+        for (int attempt = 0; attempt < 100; attempt++)
+        {
+            auto res = cli.Get("/locations");
+            if (res)
+            {
+                return true;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+        return false;
+    }
+
+    int open_idle_connection(int port)
+    {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = htons(port);
+        if (fd >= 0 && connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0)
+        {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    // Keeps `idle_connections` connections open until the deadline, reopening any the server closed.
+    void hold_idle_connections(const Options &options, std::chrono::steady_clock::time_point deadline, uint64_t &reopened)
+    {
+        std::vector<int> fds(options.idle_connections, -1);
+        while (std::chrono::steady_clock::now() < deadline)
+        {
+            for (int &fd : fds)
+            {
+                char byte;
+                if (fd >= 0 && recv(fd, &byte, 1, MSG_PEEK | MSG_DONTWAIT) == 0)
+                {
+                    close(fd);
+                    fd = -1;
+                    reopened++;
+                }
+                if (fd < 0)
+                {
+                    fd = open_idle_connection(options.target_port());
+                }
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        }
+        for (int fd : fds)
+        {
+            if (fd >= 0)
+            {
+                close(fd);
+            }
+        }
+    }
+
+    void run_worker(const Options &options, int thread_id, std::chrono::steady_clock::time_point deadline, ThreadResult &result)
+    {
+        httplib::Client cli("127.0.0.1", options.target_port());
+        cli.set_keep_alive(true);
+        std::mt19937_64 rng(thread_id * 7919 + 1);
+        std::discrete_distribution<int> pick_op(options.mix, options.mix + OP_COUNT);
+        std::uniform_int_distribution<long> pick_device(0, std::max(0L, options.devices - 1));
+        std::uniform_int_distribution<int> pick_location(1, options.locations);
+        std::vector<std::string> added;
+        long next_serial = 0;
+
+        while (std::chrono::steady_clock::now() < deadline)
+        {
+            int op = pick_op(rng);
+            if (op == OP_DELETE && added.empty())
+            {
+                op = OP_ADD;
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            httplib::Result res{nullptr, httplib::Error::Unknown};
+            switch (op)
+            {
+            case OP_LIST:
+                res = cli.Get("/devices");
+                break;
+            case OP_FILTER:
+                if (rng() % 2)
+                {
+                    res = cli.Get("/devices/filter?serial_number=" + bench_serial(pick_device(rng)));
+                }
+                else
+                {
+                    res = cli.Get("/devices/filter?location_id=" + std::to_string(pick_location(rng)) + "&start_date=2020-01-01");
+                }
+                break;
+            case OP_ADD:
+            {
+                std::string serial = "T" + std::to_string(thread_id) + "X" + std::to_string(next_serial++);
+                res = cli.Post("/devices?serial_number=" + serial + "&name=BenchDevice&type=BenchType&location_id=" +
+                                   std::to_string(pick_location(rng)),
+                               "", "application/x-www-form-urlencoded");
+                if (res && res->status == 200)
+                {
+                    added.push_back(serial);
+                }
+                break;
+            }
+            case OP_PATCH:
+                res = cli.Patch("/devices/" + bench_serial(pick_device(rng)) + "?location_id=" + std::to_string(pick_location(rng)),
+                                "", "application/x-www-form-urlencoded");
+                break;
+            case OP_DELETE:
+                res = cli.Delete("/devices/" + added.back());
+                added.pop_back();
+                break;
+            }
+            auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+
+            result.latencies_ns[op].push_back(elapsed.count());
+            result.statuses[op][res ? res->status : -1]++;
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    Options options;
+    if (!parse_options(argc, argv, options))
+    {
+        return 1;
+    }
+
+    if (!options.reuse_db)
+    {
+        std::cerr << "Generating registry with " << options.devices << " devices and " << options.locations << " locations..." << std::endl;
+        if (!create_registry(options.db_path, options.devices, options.locations))
+        {
+            return 1;
+        }
+    }
+
+    pid_t server = start_server(options);
+    if (server < 0 || !wait_for_server(options))
+    {
+        std::cerr << "Server did not come up on port " << options.port << std::endl;
+        if (server > 0)
+        {
+            kill(server, SIGTERM);
+        }
+        return 1;
+    }
+
+    std::cerr << "Running " << options.threads << " threads for " << options.duration_s << " s..." << std::endl;
+    std::vector<ThreadResult> results(options.threads);
+    std::vector<std::thread> workers;
+    auto start = std::chrono::steady_clock::now();
+    auto deadline = start + std::chrono::microseconds(static_cast<long>(options.duration_s * 1e6));
+    uint64_t idle_reopened = 0;
+    std::thread idle;
+    if (options.idle_connections > 0)
+    {
+        idle = std::thread(hold_idle_connections, std::cref(options), deadline, std::ref(idle_reopened));
+    }
+    for (int t = 0; t < options.threads; t++)
+    {
+        workers.emplace_back(run_worker, std::cref(options), t, deadline, std::ref(results[t]));
+    }
+    for (auto &worker : workers)
+    {
+        worker.join();
+    }
+    if (idle.joinable())
+    {
+        idle.join();
+    }
+    double elapsed_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    kill(server, SIGTERM);
+    waitpid(server, NULL, 0);
+
+    json report;
+    report["server"] = options.server;
+    report["devices"] = options.devices;
+    report["locations"] = options.locations;
+    report["threads"] = options.threads;
+    report["front_end"] = options.event_loop ? "event_loop" : "httplib";
+    report["idle_connections"] = options.idle_connections;
+    report["idle_connections_reopened"] = idle_reopened;
+    report["duration_s"] = elapsed_s;
+    uint64_t total = 0;
+    for (int op = 0; op < OP_COUNT; op++)
+    {
+        std::vector<uint64_t> latencies;
+        std::map<int, uint64_t> statuses;
+        for (const auto &result : results)
+        {
+            latencies.insert(latencies.end(), result.latencies_ns[op].begin(), result.latencies_ns[op].end());
+            for (const auto &status : result.statuses[op])
+            {
+                statuses[status.first] += status.second;
+            }
+        }
+        if (latencies.empty())
+        {
+            continue;
+        }
+        std::sort(latencies.begin(), latencies.end());
+        total += latencies.size();
+
+        json status_counts;
+        for (const auto &status : statuses)
+        {
+            status_counts[std::to_string(status.first)] = status.second;
+        }
+        report["routes"][OP_NAMES[op]] = {
+            {"requests", latencies.size()},
+            {"throughput_rps", latencies.size() / elapsed_s},
+            {"p50_ms", percentile(latencies, 0.50) / 1e6},
+            {"p99_ms", percentile(latencies, 0.99) / 1e6},
+            {"p999_ms", percentile(latencies, 0.999) / 1e6},
+            {"max_ms", latencies.back() / 1e6},
+            {"statuses", status_counts}};
+    }
+    report["requests"] = total;
+    report["throughput_rps"] = total / elapsed_s;
+
+    std::cout << report.dump(2) << std::endl;
+    return 0;
+}
@@ -0,0 +1,309 @@
+#include "RegistryGenerator.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <ctime>
+#include <iostream>
+
+namespace
+{
+    const char *const SCHEMA =
+        "CREATE TABLE IF NOT EXISTS \"locations\" ("
+        "id INTEGER PRIMARY KEY,"
+        "name TEXT collate nocase not null,"
+        "type TEXT collate nocase not null);"
+        "CREATE TABLE IF NOT EXISTS \"devices\" ("
+        "serial_number TEXT COLLATE nocase PRIMARY KEY,"
+        "name TEXT COLLATE nocase not null,"
+        "type TEXT COLLATE nocase not null,"
+        "creation_date DATE not null,"
+        "location_id INTEGER not null,"
+        "location_name TEXT COLLATE nocase not null DEFAULT '',"
+        "location_type TEXT COLLATE nocase not null DEFAULT '',"
+        "FOREIGN KEY(location_id) REFERENCES \"locations\"(id)"
+        ") WITHOUT ROWID;";
+
+    // Built after the rows are in, which is cheaper than maintaining it during the insert.
+    const char *const INDEXES = "CREATE INDEX IF NOT EXISTS devices_location_id ON devices (location_id);"
+                                "CREATE INDEX IF NOT EXISTS devices_name ON devices (name);"
+                                "CREATE INDEX IF NOT EXISTS devices_creation_date ON devices (creation_date);"
+                                "CREATE INDEX IF NOT EXISTS devices_location_id_creation_date ON devices (location_id, creation_date);";
+
+    std::string location_name(int id)
+    {
+        return "Location" + std::to_string(id);
+    }
+
+    std::string location_type(int id, int location_types)
+    {
+        return "LocationType" + std::to_string(id % std::max(1, location_types));
+    }
+
+    // Writes `value` as decimal digits right-aligned in buf[0, width), zero padded. Returns the first digit written.
+    char *format_number(char *buf, int width, long value, bool pad)
+    {
+        char *p = buf + width;
+        do
+        {
+            *--p = '0' + value % 10;
+            value /= 10;
+        } while (value > 0 && p > buf);
+        while (pad && p > buf)
+        {
+            *--p = '0';
+        }
+        return p;
+    }
+
+    bool parse_date(const std::string &date, time_t &result)
+    {
+        std::tm tm = {};
+        if (strptime(date.c_str(), "%Y-%m-%d", &tm) == nullptr)
+        {
+            return false;
+        }
+        result = timegm(&tm);
+        return true;
+    }
+
+    std::string name_prefix(int id, int name_prefixes)
+    {
+        return name_prefixes == 1 ? "Device" : "Model" + std::to_string(id) + "-";
+    }
+
+    // Per-row name buffer: the number is right-aligned in the last 20 bytes, the prefix goes in front of it.
+    const int NAME_BYTES = 40;
+
+    bool exec(sqlite3 *db, const char *sql)
+    {
+        char *error = nullptr;
+        if (sqlite3_exec(db, sql, NULL, NULL, &error) != SQLITE_OK)
+        {
+            std::cerr << "Error executing \"" << sql << "\": " << (error ? error : "") << std::endl;
+            sqlite3_free(error);
+            return false;
+        }
+        return true;
+    }
+}
+
+bool Distribution::parse(const std::string &spec, Distribution &dist)
+{
+    if (spec == "uniform")
+    {
+        dist.kind = "uniform";
+        return true;
+    }
+    if (spec.compare(0, 4, "zipf") == 0)
+    {
+        dist.kind = "zipf";
+        dist.skew = 1.0;
+        if (spec.size() > 5 && spec[4] == ':')
+        {
+            try
+            {
+                dist.skew = std::stod(spec.substr(5));
+            }
+            catch (...)
+            {
+                return false;
+            }
+        }
+        return spec.size() == 4 || spec[4] == ':';
+    }
+    return false;
+}
+
+RegistryGenerator::RegistryGenerator(const GeneratorOptions &options) : options(options), rng(options.seed) {}
+
+std::string RegistryGenerator::serial_number(long i)
+{
+    char buf[12] = {'S', 'N'};
+    format_number(buf + 2, 10, i, true);
+    return std::string(buf, 12);
+}
+
+bool RegistryGenerator::generate(const std::string &db_path)
+{
+    std::remove(db_path.c_str());
+    sqlite3 *db;
+    if (sqlite3_open(db_path.c_str(), &db) != SQLITE_OK)
+    {
+        std::cerr << "Cannot create " << db_path << ": " << sqlite3_errmsg(db) << std::endl;
+        sqlite3_close(db);
+        return false;
+    }
+
+    // The file is written from scratch, so durability is traded for speed until the final commit.
+    bool ok = exec(db, "PRAGMA journal_mode=OFF; PRAGMA synchronous=OFF; PRAGMA locking_mode=EXCLUSIVE;"
+                       "PRAGMA temp_store=MEMORY; PRAGMA cache_size=-262144; PRAGMA page_size=65536;") &&
+              exec(db, SCHEMA) && exec(db, "BEGIN") && insert_locations(db) && insert_devices(db) && exec(db, INDEXES) &&
+              exec(db, "COMMIT");
+
+    sqlite3_close(db);
+    return ok;
+}
+
+bool RegistryGenerator::insert_locations(sqlite3 *db)
+{
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(db, "INSERT INTO locations (id, name, type) VALUES (?, ?, ?)", -1, &stmt, NULL) != SQLITE_OK)
+    {
+        std::cerr << "Error preparing SQL statement: " << sqlite3_errmsg(db) << std::endl;
+        return false;
+    }
+    int rc = SQLITE_DONE;
+    for (int id = 1; id <= options.locations && rc == SQLITE_DONE; id++)
+    {
+        std::string name = location_name(id);
+        std::string type = location_type(id, options.location_types);
+        sqlite3_bind_int(stmt, 1, id);
+        sqlite3_bind_text(stmt, 2, name.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt, 3, type.c_str(), -1, SQLITE_STATIC);
+        rc = sqlite3_step(stmt);
+        sqlite3_reset(stmt);
+    }
+    sqlite3_finalize(stmt);
+    return rc == SQLITE_DONE;
+}
+
+bool RegistryGenerator::insert_devices(sqlite3 *db)
+{
+    time_t start, end;
+    if (!parse_date(options.start_date, start) || !parse_date(options.end_date, end) || end < start)
+    {
+        std::cerr << "Invalid date range " << options.start_date << " .. " << options.end_date << std::endl;
+        return false;
+    }
+
+    // Every value drawn per row is precomputed, so the insert loop does no string formatting besides the counters.
+    int day_count = static_cast<int>((end - start) / 86400) + 1;
+    std::vector<std::string> dates(day_count);
+    for (int d = 0; d < day_count; d++)
+    {
+        time_t day = end - static_cast<time_t>(d) * 86400;
+        char buf[16];
+        strftime(buf, sizeof(buf), "%Y-%m-%d", gmtime(&day));
+        dates[d] = buf;
+    }
+    std::vector<std::string> types(options.device_types);
+    for (int t = 0; t < options.device_types; t++)
+    {
+        types[t] = "Type" + std::to_string(t);
+    }
+    // Devices carry their location's name and type.
+    std::vector<std::string> location_names(options.locations);
+    std::vector<std::string> location_types(options.locations);
+    for (int l = 0; l < options.locations; l++)
+    {
+        location_names[l] = location_name(l + 1);
+        location_types[l] = location_type(l + 1, options.location_types);
+    }
+    std::vector<std::string> name_prefixes(options.name_prefixes);
+    for (int p = 0; p < options.name_prefixes; p++)
+    {
+        name_prefixes[p] = name_prefix(p, options.name_prefixes);
+    }
+    std::vector<double> type_cdf = cumulative_weights(options.type_dist, options.device_types);
+    std::vector<double> location_cdf = cumulative_weights(options.location_dist, options.locations);
+    std::vector<double> date_cdf = cumulative_weights(options.date_dist, day_count);
+    std::vector<double> name_cdf = cumulative_weights(options.name_dist, options.name_prefixes);
+
+    // Rows go in batches through a multi-row INSERT so per-statement VDBE overhead is paid once per batch.
+    sqlite3_stmt *batch_stmt = prepare_device_insert(db, BATCH_ROWS);
+    sqlite3_stmt *row_stmt = prepare_device_insert(db, 1);
+    if (batch_stmt == nullptr || row_stmt == nullptr)
+    {
+        sqlite3_finalize(batch_stmt);
+        sqlite3_finalize(row_stmt);
+        return false;
+    }
+
+    // Text is bound with SQLITE_STATIC, so every row of a batch needs its own serial and name buffers.
+    std::vector<char> serials(BATCH_ROWS * 12);
+    std::vector<char> names(BATCH_ROWS * NAME_BYTES);
+    bool ok = true;
+    for (long first = 0; first < options.devices && ok; first += BATCH_ROWS)
+    {
+        int rows = static_cast<int>(std::min<long>(BATCH_ROWS, options.devices - first));
+        sqlite3_stmt *stmt = rows == BATCH_ROWS ? batch_stmt : row_stmt;
+        for (int r = 0; r < rows; r++)
+        {
+            long i = first + r;
+            char *serial = &serials[r * 12];
+            serial[0] = 'S';
+            serial[1] = 'N';
+            format_number(serial + 2, 10, i, true);
+            // A single prefix draws nothing, so the default registry comes out as before the option existed.
+            const std::string &prefix = name_prefixes.size() == 1 ? name_prefixes[0] : name_prefixes[sample(name_cdf)];
+            char *name = &names[r * NAME_BYTES];
+            char *digits = format_number(name + NAME_BYTES - 20, 20, i, false);
+            char *name_start = std::copy_backward(prefix.begin(), prefix.end(), digits);
+            int name_length = static_cast<int>(name + NAME_BYTES - name_start);
+
+            const std::string &type = types[sample(type_cdf)];
+            const std::string &date = dates[sample(date_cdf)];
+            int location = sample(location_cdf);
+            int column = rows == BATCH_ROWS ? r * 7 : 0;
+            sqlite3_bind_text(stmt, column + 1, serial, 12, SQLITE_STATIC);
+            sqlite3_bind_text(stmt, column + 2, name_start, name_length, SQLITE_STATIC);
+            sqlite3_bind_text(stmt, column + 3, type.c_str(), type.size(), SQLITE_STATIC);
+            sqlite3_bind_text(stmt, column + 4, date.c_str(), date.size(), SQLITE_STATIC);
+            sqlite3_bind_int(stmt, column + 5, 1 + location);
+            sqlite3_bind_text(stmt, column + 6, location_names[location].c_str(), location_names[location].size(), SQLITE_STATIC);
+            sqlite3_bind_text(stmt, column + 7, location_types[location].c_str(), location_types[location].size(), SQLITE_STATIC);
+            if (stmt == row_stmt || r == rows - 1)
+            {
+                if (sqlite3_step(stmt) != SQLITE_DONE)
+                {
+                    std::cerr << "Error inserting device " << i << ": " << sqlite3_errmsg(db) << std::endl;
+                    ok = false;
+                    break;
+                }
+                sqlite3_reset(stmt);
+            }
+        }
+    }
+    sqlite3_finalize(batch_stmt);
+    sqlite3_finalize(row_stmt);
+    return ok;
+}
+
+sqlite3_stmt *RegistryGenerator::prepare_device_insert(sqlite3 *db, int rows)
+{
+    std::string sql = "INSERT INTO devices (serial_number, name, type, creation_date, location_id, location_name, location_type) VALUES ";
+    for (int r = 0; r < rows; r++)
+    {
+        sql += r == 0 ? "(?, ?, ?, ?, ?, ?, ?)" : ", (?, ?, ?, ?, ?, ?, ?)";
+    }
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, NULL) != SQLITE_OK)
+    {
+        std::cerr << "Error preparing SQL statement: " << sqlite3_errmsg(db) << std::endl;
+        return nullptr;
+    }
+    return stmt;
+}
+
+std::vector<double> RegistryGenerator::cumulative_weights(const Distribution &dist, int count)
+{
+    std::vector<double> cdf(std::max(count, 1));
+    double total = 0;
+    for (size_t i = 0; i < cdf.size(); i++)
+    {
+        total += dist.kind == "zipf" ? 1.0 / std::pow(i + 1.0, dist.skew) : 1.0;
+        cdf[i] = total;
+    }
+    for (auto &value : cdf)
+    {
+        value /= total;
+    }
+    return cdf;
+}
+
+int RegistryGenerator::sample(const std::vector<double> &cdf)
+{
+    double u = std::uniform_real_distribution<double>(0.0, 1.0)(rng);
+    int index = std::lower_bound(cdf.begin(), cdf.end(), u) - cdf.begin();
+    return std::min(index, static_cast<int>(cdf.size()) - 1);
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <sqlite3.h>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+// Distribution over k ordered items: uniform, or Zipfian where item i has weight 1 / (i + 1)^skew.
+struct Distribution
+{
+    std::string kind = "uniform";
+    double skew = 1.0;
+
+    static bool parse(const std::string &spec, Distribution &dist); // "uniform" or "zipf:<skew>"
+};
+
+struct GeneratorOptions
+{
+    long devices = 100000;
+    int locations = 20;
+    int device_types = 16;
+    int location_types = 8;
+    int name_prefixes = 1; // device names are a prefix and the device's number; with one prefix they read Device<i>
+    Distribution type_dist;
+    Distribution location_dist;
+    Distribution name_dist; // over the name prefixes
+    Distribution date_dist; // over days, newest first
+    std::string start_date = "2015-01-01";
+    std::string end_date = "2024-12-31";
+    uint64_t seed = 42;
+};
+
+// Writes registry.db files with the devices/locations schema at a given scale.
+// Devices are inserted in serial_number order through bound multi-row statements inside a single transaction.
+class RegistryGenerator
+{
+public:
+    explicit RegistryGenerator(const GeneratorOptions &options);
+
+    bool generate(const std::string &db_path);
+
+    // Serial number of the i-th generated device.
+    static std::string serial_number(long i);
+
+private:
+    static const int BATCH_ROWS = 100;
+
+    GeneratorOptions options;
+    std::mt19937_64 rng;
+
+    bool insert_locations(sqlite3 *db);
+    bool insert_devices(sqlite3 *db);
+    sqlite3_stmt *prepare_device_insert(sqlite3 *db, int rows);
+    std::vector<double> cumulative_weights(const Distribution &dist, int count);
+    int sample(const std::vector<double> &cdf);
+};
@@ -0,0 +1,87 @@
+// Generates a registry.db with the devices/locations schema at a given scale.
+//
+//   ./generate_registry --output=registry.db --devices=10000000 --locations=500
+//                       --types=40 --type-dist=zipf:1.1 --location-dist=zipf:0.8 --date-dist=uniform
+#include "RegistryGenerator.h"
+#include <chrono>
+#include <iostream>
+
+namespace
+{
+    void print_usage()
+    {
+        std::cerr << "Usage: generate_registry [--output=registry.db] [--devices=N] [--locations=N] [--types=N]\n"
+                     "                         [--location-types=N] [--name-prefixes=N] [--type-dist=uniform|zipf:S]\n"
+                     "                         [--location-dist=uniform|zipf:S] [--name-dist=uniform|zipf:S] [--date-dist=uniform|zipf:S]\n"
+                     "                         [--start-date=YYYY-MM-DD] [--end-date=YYYY-MM-DD] [--seed=N]"
+                  << std::endl;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    GeneratorOptions options;
+    std::string output = "registry.db";
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        auto eq = arg.find('=');
+        std::string key = arg.substr(0, eq);
+        std::string value = eq == std::string::npos ? "" : arg.substr(eq + 1);
+        bool valid = true;
+        try
+        {
+            if (key == "--output")
+                output = value;
+            else if (key == "--devices")
+                options.devices = std::stol(value);
+            else if (key == "--locations")
+                options.locations = std::stoi(value);
+            else if (key == "--types")
+                options.device_types = std::stoi(value);
+            else if (key == "--location-types")
+                options.location_types = std::stoi(value);
+            else if (key == "--name-prefixes")
+                options.name_prefixes = std::stoi(value);
+            else if (key == "--type-dist")
+                valid = Distribution::parse(value, options.type_dist);
+            else if (key == "--location-dist")
+                valid = Distribution::parse(value, options.location_dist);
+            else if (key == "--name-dist")
+                valid = Distribution::parse(value, options.name_dist);
+            else if (key == "--date-dist")
+                valid = Distribution::parse(value, options.date_dist);
+            else if (key == "--start-date")
+                options.start_date = value;
+            else if (key == "--end-date")
+                options.end_date = value;
+            else if (key == "--seed")
+                options.seed = std::stoull(value);
+            else
+                valid = false;
+        }
+        catch (...)
+        {
+            valid = false;
+        }
+        // Every device is drawn a location, a type and a name prefix, so each needs at least one to draw from.
+        valid = valid && options.locations >= 1 && options.device_types >= 1 && options.location_types >= 1 && options.name_prefixes >= 1;
+        if (!valid)
+        {
+            std::cerr << "Invalid option: " << arg << std::endl;
+            print_usage();
+            return 1;
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    RegistryGenerator generator(options);
+    if (!generator.generate(output))
+    {
+        return 1;
+    }
+    double elapsed_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Generated " << output << ": " << options.devices << " devices, " << options.locations << " locations in "
+              << elapsed_s << " s" << std::endl;
+    return 0;
+}